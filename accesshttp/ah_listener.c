@@ -5,10 +5,12 @@
 
 #include "ah_listener.h"
 #include "ah_config.h"
+#include "ut_worker.h"
 
 static nw_svr *listener_svr;
 static nw_svr *monitor_svr;
 static rpc_svr *worker_svr;
+static worker_pool *workers; // 按负载排列的worker
 
 /* 1.listener服务 */
 
@@ -36,39 +38,13 @@ static int listener_on_accept(nw_ses *ses, int sockfd, nw_addr_t *peer_addr) {
   log_info(" heartbeat_check : %d", worker_svr->heartbeat_check);
   log_info(" listener客户端地址: %s", nw_sock_human_addr(peer_addr));
 
-  // 如果worker的rpc服务的底层网络会话数量是0，则worker没有连接到其他后台服务
-  if (worker_svr->raw_svr->ses_count == 0) {
+  // 选择负载最小的worker，没有worker时返回NULL
+  nw_ses *curr = worker_pool_pick(workers);
+  if (curr == NULL) {
     log_error("no available worker");
     return -1;
   }
 
-  //随机选择一个worker服务的网络会话id（这里的会话指worker用来连接其他后端服务的客户端）
-  int worker = rand() % worker_svr->raw_svr->ses_count;
-
-  log_info(" worker_svr的客户端会话数量: %d", worker_svr->raw_svr->ses_count);
-  log_info(" 随机选择的worker: %d", worker);
-
-  nw_ses *curr_test = worker_svr->raw_svr->ses_list_all;
-  for (int i = 0; i < worker_svr->raw_svr->ses_count && curr_test; i++) {
-
-    log_info("curr_test %s,%s", nw_sock_human_addr(curr_test->host_addr),
-             nw_sock_human_addr(&curr_test->peer_addr));
-
-    curr_test = curr_test->next;
-  }
-
-  // 指向第一个会话，并移动到最后一个会话（至少往后移一次）
-  nw_ses *curr = worker_svr->raw_svr->ses_list_head;
-  for (int i = 0; i < worker && curr; ++i) {
-    curr = curr->next;
-  }
-
-  // 如果没有worker，抛出错误
-  if (!curr) {
-    log_error("choice worker fail");
-    return -1;
-  }
-
   log_info("worker当前会话 curr->id: %d, curr->sock_type: %d", curr->id,
            curr->sock_type);
 
@@ -116,19 +92,28 @@ static int init_listener_svr(void) {
 
 /* 2.worker服务 */
 
-// 接收到数据包，啥也不做
+// 接收到数据包，处理worker的负载上报
 static void worker_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
-  log_info("worker recv pkg");
-  return;
+  if (pkg->command == CMD_WORKER_LOAD) {
+    int ret = worker_pool_report(workers, ses, pkg);
+    if (ret < 0) {
+      log_error("worker: %s load report invalid: %d",
+                nw_sock_human_addr(&ses->peer_addr), ret);
+    }
+  }
 }
-// 接收到新连接，啥也不做
+// 接收到新连接，加入worker堆
 static void worker_on_new_connection(nw_ses *ses) {
+  if (worker_pool_add(workers, ses) == NULL) {
+    log_error("add worker: %s fail", nw_sock_human_addr(&ses->peer_addr));
+  }
   log_info("worker_new_cnnection, current worker number: %u,地址:%s -> %s",
            worker_svr->raw_svr->ses_count, nw_sock_human_addr(ses->host_addr),
            nw_sock_human_addr(&ses->peer_addr));
 }
-// 关闭新连接，啥也不做
+// 关闭连接，移出worker堆
 static void worker_on_connection_close(nw_ses *ses) {
+  worker_pool_del(workers, ses);
   log_info("worker close, current worker number: %u",
            worker_svr->raw_svr->ses_count - 1);
 }
@@ -154,8 +139,13 @@ static int init_worker_svr(void) {
   cfg.max_pkg_size = 1024;
   cfg.heartbeat_check = true;
 
+  workers = worker_pool_create();
+  if (workers == NULL)
+    return -__LINE__;
+
   // worker的rpc服务事物，即核心业务逻辑
   rpc_svr_type type;
+  memset(&type, 0, sizeof(type));
   type.on_recv_pkg = worker_on_recv_pkg;
   type.on_new_connection = worker_on_new_connection;
   type.on_connection_close = worker_on_connection_close;
@@ -184,8 +174,11 @@ static int init_worker_svr(void) {
 static int monitor_decode_pkg(nw_ses *ses, void *data, size_t max) {
   return max;
 }
+// 返回各worker的负载
 static void monitor_on_recv_pkg(nw_ses *ses, void *data, size_t size) {
-  return;
+  sds reply = worker_pool_status(workers, sdsempty());
+  nw_ses_send(ses, reply, sdslen(reply));
+  sdsfree(reply);
 }
 
 static int init_monitor_svr(void) {
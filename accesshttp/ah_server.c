@@ -5,6 +5,7 @@
 
 #include "ah_server.h"
 #include "ah_config.h"
+#include "ut_worker.h"
 
 static http_svr *svr;
 static nw_state *state;
@@ -298,6 +299,10 @@ static int init_woker_clt(void) {
   }
   log_info("name: %s rpc_clt 启动成功", worker->name);
 
+  // 定期向listener上报连接数和事件循环延迟
+  if (worker_report_start(worker, svr->raw_svr) < 0)
+    return -__LINE__;
+
   return 0;
 }
 //添加handler
@@ -329,6 +334,11 @@ static int init_methods_handler(void) {
       add_handler("order.put_market", matchengine, CMD_ORDER_PUT_MARKET));
 
   ERR_RET_LN(add_handler("order.cancel", matchengine, CMD_ORDER_CANCEL));
+  ERR_RET_LN(
+      add_handler("order.cancel_all", matchengine, CMD_ORDER_CANCEL_ALL));
+  ERR_RET_LN(
+      add_handler("order.cancel_market", matchengine, CMD_ORDER_CANCEL_MARKET));
+  ERR_RET_LN(add_handler("order.batch", matchengine, CMD_ORDER_BATCH));
   ERR_RET_LN(add_handler("order.book", matchengine, CMD_ORDER_BOOK));
   ERR_RET_LN(add_handler("order.depth", matchengine, CMD_ORDER_BOOK_DEPTH));
   ERR_RET_LN(add_handler("order.pending", matchengine, CMD_ORDER_QUERY));
@@ -78,16 +78,21 @@ static int on_balance_query_reply(struct state_data *state, json_t *result)
     json_t *params = json_array();
     json_array_append(params, result);
 
+    ws_frame *frame = NULL;
     list_t *list = entry->val;
     list_iter *iter = list_get_iterator(list, LIST_START_HEAD);
     list_node *node;
     while ((node = list_next(iter)) != NULL) {
         struct sub_unit *unit = node->value;
         if (strcmp(unit->asset, state->asset) == 0) {
-            send_notify(unit->ses, "asset.update", params);
+            if (frame == NULL && (frame = notify_frame("asset.update", params)) == NULL)
+                break;
+            ws_send_frame(unit->ses, frame);
         }
     }
     list_release_iterator(iter);
+    if (frame)
+        ws_frame_release(frame);
     json_decref(params);
 
     return 0;
@@ -95,7 +100,7 @@ static int on_balance_query_reply(struct state_data *state, json_t *result)
 
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -105,7 +110,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_load(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -270,12 +275,16 @@ int asset_on_update(uint32_t user_id, const char *asset)
     pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
     pkg.command   = CMD_BALANCE_QUERY;
     pkg.sequence  = state_entry->id;
-    pkg.body      = json_dumps(trade_params, 0);
-    pkg.body_size = strlen(pkg.body);
+    if (rpc_body_dump(&pkg, trade_params, matchengine->body_type) < 0) {
+        log_error("encode request body fail, cmd: %u", pkg.command);
+        nw_state_del(state_context, state_entry->id);
+        json_decref(trade_params);
+        return -__LINE__;
+    }
 
     rpc_clt_send(matchengine, &pkg);
-    log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, (char *)pkg.body);
+    log_trace("send request to %s, cmd: %u, sequence: %u, body size: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, pkg.body_size);
     free(pkg.body);
     json_decref(trade_params);
 
@@ -35,6 +35,7 @@
 #include "ut_rpc_svr.h"
 #include "ut_sds.h"
 #include "ut_signal.h"
+#include "ut_skiplist.h"
 #include "ut_ws_svr.h"
 
 #define ASSET_NAME_MAX_LEN 16
@@ -65,6 +66,7 @@ struct settings {
   rpc_clt_cfg readhistory;
   kafka_consumer_cfg orders;
   kafka_consumer_cfg balances;
+  kafka_consumer_cfg depth;
 
   int worker_num;
   char *auth_url;
@@ -117,11 +117,7 @@ static int on_order_deals_reply(struct state_data *state, json_t *result)
     json_array_append_new(params, json_string(state->market));
     json_array_append(params, result);
 
-    dict_iterator *iter = dict_get_iterator(obj->sessions);
-    while ((entry = dict_next(iter)) != NULL) {
-        send_notify(entry->key, "deals.update", params);
-    }
-    dict_release_iterator(iter);
+    send_notify_dict(obj->sessions, "deals.update", params);
     json_decref(params);
 
     return 0;
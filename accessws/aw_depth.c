@@ -9,25 +9,79 @@
 
 static nw_timer timer;
 static dict_t *dict_depth;
+static dict_t *dict_book;
 static rpc_clt *matchengine;
 static nw_state *state_context;
 
 # define CLEAN_INTERVAL 60
+# define PENDING_MAX    10000
 
 struct depth_key {
     char market[MARKET_NAME_MAX_LEN];
     char interval[INTERVAL_MAX_LEN];
-    uint32_t limit;
 };
 
+/* depth of one side as scaled integers, see depth_book for the prec */
+struct depth_unit {
+    fixed_t price;
+    fixed_t amount;
+};
+
+struct depth_list {
+    struct depth_unit *units;
+    uint32_t count;
+};
+
+# define DEPTH_ASKS 0
+# define DEPTH_BIDS 1
+
+/* subscribers of one limit, what they have is the first limit units
+ * of the depth they share */
+struct depth_view {
+    dict_t  *sessions;
+    time_t   last_clean;
+};
+
+/* depth of a market merged by interval, built once up to the largest
+ * subscribed limit, one view for each limit in settings.depth_limit.
+ * last is what subscribers have, next is the buffer the new depth is
+ * built in, they are swapped after each update */
 struct depth_val {
-    dict_t *sessions;
-    json_t *last;
-    time_t  last_clean;
+    struct depth_view *views;
+    struct depth_list last[2];
+    struct depth_list next[2];
+    uint32_t limit;
+    bool     has_last;
+    int      price_prec;
+    int      amount_prec;
+    uint64_t seq;
+    mpd_t   *interval;
+    int      interval_prec;
+};
+
+/* local order book of a market, loaded from a matchengine snapshot and
+ * kept up to date by the depth messages, seq is the last applied one.
+ * prices and amounts are value * 10^prec, the prec grows to the largest
+ * scale seen and never shrinks */
+struct depth_level {
+    fixed_t price;
+    fixed_t amount;
+};
+
+struct depth_book {
+    skiplist_t *asks;
+    skiplist_t *bids;
+    int         price_prec;
+    int         amount_prec;
+    uint64_t    seq;
+    bool        synced;
+    bool        syncing;
+    bool        active;
+    list_t     *pending;
 };
 
 struct state_data {
-    struct depth_key key;
+    char market[MARKET_NAME_MAX_LEN];
 };
 
 static uint32_t dict_ses_hash_func(const void *key)
@@ -69,15 +123,96 @@ static void *dict_depth_val_dup(const void *val)
     return obj;
 }
 
+static void depth_val_clear(struct depth_val *obj)
+{
+    if (obj->views) {
+        for (int i = 0; i < settings.depth_limit.count; ++i) {
+            if (obj->views[i].sessions)
+                dict_release(obj->views[i].sessions);
+        }
+        free(obj->views);
+    }
+    for (int i = 0; i < 2; ++i) {
+        free(obj->last[i].units);
+        free(obj->next[i].units);
+    }
+    if (obj->interval)
+        mpd_del(obj->interval);
+}
+
 static void dict_depth_val_free(void *val)
 {
-    struct depth_val *obj = val;
-    dict_release(obj->sessions);
-    if (obj->last)
-        json_decref(obj->last);
+    depth_val_clear(val);
+    free(val);
+}
+
+static uint32_t dict_book_hash_func(const void *key)
+{
+    return dict_generic_hash_function(key, strlen(key));
+}
+
+static int dict_book_key_compare(const void *key1, const void *key2)
+{
+    return strcmp(key1, key2);
+}
+
+static void *dict_book_key_dup(const void *key)
+{
+    return strdup(key);
+}
+
+static void dict_book_key_free(void *key)
+{
+    free(key);
+}
+
+static void *dict_book_val_dup(const void *val)
+{
+    struct depth_book *obj = malloc(sizeof(struct depth_book));
+    memcpy(obj, val, sizeof(struct depth_book));
+    return obj;
+}
+
+static void dict_book_val_free(void *val)
+{
+    struct depth_book *obj = val;
+    if (obj->asks)
+        skiplist_release(obj->asks);
+    if (obj->bids)
+        skiplist_release(obj->bids);
+    list_release(obj->pending);
     free(obj);
 }
 
+static int fixed_cmp(fixed_t a, fixed_t b)
+{
+    return (a > b) - (a < b);
+}
+
+static int depth_level_ask_compare(const void *value1, const void *value2)
+{
+    const struct depth_level *level1 = value1;
+    const struct depth_level *level2 = value2;
+    return fixed_cmp(level1->price, level2->price);
+}
+
+static int depth_level_bid_compare(const void *value1, const void *value2)
+{
+    const struct depth_level *level1 = value1;
+    const struct depth_level *level2 = value2;
+    return fixed_cmp(level2->price, level1->price);
+}
+
+static void depth_level_free(void *value)
+{
+    free(value);
+}
+
+static void pending_free(void *value)
+{
+    json_decref(value);
+}
+
 static void on_backend_connect(nw_ses *ses, bool result)
 {
     rpc_clt *clt = ses->privdata;
@@ -88,113 +223,347 @@ static void on_backend_connect(nw_ses *ses, bool result)
     }
 }
 
-static json_t *get_list_diff(json_t *list1, json_t *list2, uint32_t limit, int side)
+
+static int book_reset(struct depth_book *book)
+{
+    if (book->asks)
+        skiplist_release(book->asks);
+    if (book->bids)
+        skiplist_release(book->bids);
+
+    skiplist_type st;
+    memset(&st, 0, sizeof(st));
+    st.free = depth_level_free;
+    st.compare = depth_level_ask_compare;
+    book->asks = skiplist_create(&st);
+    st.compare = depth_level_bid_compare;
+    book->bids = skiplist_create(&st);
+    if (book->asks == NULL || book->bids == NULL)
+        return -__LINE__;
+
+    return 0;
+}
+
+static struct depth_book *get_book(const char *market)
 {
-    if (list1 == NULL || list2 == NULL)
+    dict_entry *entry = dict_find(dict_book, market);
+    if (entry)
+        return entry->val;
+
+    struct depth_book book;
+    memset(&book, 0, sizeof(book));
+    list_type lt;
+    memset(&lt, 0, sizeof(lt));
+    lt.free = pending_free;
+    book.pending = list_create(&lt);
+    if (book.pending == NULL)
+        return NULL;
+
+    entry = dict_add(dict_book, (void *)market, &book);
+    if (entry == NULL) {
+        list_release(book.pending);
         return NULL;
+    }
+
+    return entry->val;
+}
+
+static void book_resync(struct depth_book *book)
+{
+    book->synced = false;
+    list_clear(book->pending);
+}
+
+static int get_scale(const mpd_t *value)
+{
+    return value->exp < 0 ? -value->exp : 0;
+}
+
+static int list_rescale(skiplist_t *list, fixed_t price_mul, fixed_t amount_mul)
+{
+    fixed_t max = fixed_pow10(FIXED_MAX_DIGITS);
+    skiplist_iter *iter = skiplist_get_iterator(list);
+    skiplist_node *node;
+    while ((node = skiplist_next(iter)) != NULL) {
+        struct depth_level *level = node->value;
+        if (level->price >= max / price_mul || level->amount >= max / amount_mul) {
+            skiplist_release_iterator(iter);
+            return -__LINE__;
+        }
+        level->price *= price_mul;
+        level->amount *= amount_mul;
+    }
+    skiplist_release_iterator(iter);
+
+    return 0;
+}
+
+/* raise the prec of the book, multiplying keeps the order of the levels */
+static int book_rescale(struct depth_book *book, int price_prec, int amount_prec)
+{
+    if (price_prec <= book->price_prec && amount_prec <= book->amount_prec)
+        return 0;
+    if (price_prec < book->price_prec)
+        price_prec = book->price_prec;
+    if (amount_prec < book->amount_prec)
+        amount_prec = book->amount_prec;
+    if (price_prec > FIXED_MAX_DIGITS || amount_prec > FIXED_MAX_DIGITS)
+        return -__LINE__;
+
+    fixed_t price_mul = fixed_pow10(price_prec - book->price_prec);
+    fixed_t amount_mul = fixed_pow10(amount_prec - book->amount_prec);
+    ERR_RET(list_rescale(book->asks, price_mul, amount_mul));
+    ERR_RET(list_rescale(book->bids, price_mul, amount_mul));
+    book->price_prec = price_prec;
+    book->amount_prec = amount_prec;
+
+    return 0;
+}
+
+static int get_unit(struct depth_book *book, json_t *unit, fixed_t *price, fixed_t *amount)
+{
+    const char *price_str  = json_string_value(json_array_get(unit, 0));
+    const char *amount_str = json_string_value(json_array_get(unit, 1));
+    if (price_str == NULL || amount_str == NULL)
+        return -__LINE__;
+    mpd_t *price_mpd = decimal(price_str, 0);
+    if (price_mpd == NULL)
+        return -__LINE__;
+    mpd_t *amount_mpd = decimal(amount_str, 0);
+    if (amount_mpd == NULL) {
+        mpd_del(price_mpd);
+        return -__LINE__;
+    }
+
+    int ret = book_rescale(book, get_scale(price_mpd), get_scale(amount_mpd));
+    if (ret == 0 && (mpd_get_fixed(price_mpd, book->price_prec, price) < 0 ||
+                mpd_get_fixed(amount_mpd, book->amount_prec, amount) < 0))
+        ret = -__LINE__;
+    mpd_del(price_mpd);
+    mpd_del(amount_mpd);
+
+    return ret;
+}
+
+static int book_update(struct depth_book *book, skiplist_t *list, json_t *unit)
+{
+    fixed_t price, amount;
+    ERR_RET(get_unit(book, unit, &price, &amount));
+
+    struct depth_level key = { .price = price };
+    skiplist_node *node = skiplist_find(list, &key);
+    if (amount == 0) {
+        if (node)
+            skiplist_delete(list, node);
+    } else if (node) {
+        struct depth_level *level = node->value;
+        level->amount = amount;
+    } else {
+        struct depth_level *level = malloc(sizeof(struct depth_level));
+        if (level == NULL)
+            return -__LINE__;
+        level->price = price;
+        level->amount = amount;
+        if (skiplist_insert(list, level) == NULL) {
+            depth_level_free(level);
+            return -__LINE__;
+        }
+    }
+
+    return 0;
+}
+
+static int book_update_list(struct depth_book *book, skiplist_t *list, json_t *units)
+{
+    if (!json_is_array(units))
+        return -__LINE__;
+    for (size_t i = 0; i < json_array_size(units); ++i) {
+        int ret = book_update(book, list, json_array_get(units, i));
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int book_apply(struct depth_book *book, json_t *msg)
+{
+    // the snapshot comes by rpc and is usually ahead of the messages,
+    // which are buffered by the kafka producer, those are already in it
+    uint64_t seq = json_integer_value(json_object_get(msg, "seq"));
+    if (seq <= book->seq)
+        return 0;
+    if (seq > book->seq + 1) {
+        log_error("depth seq: %"PRIu64" not follow: %"PRIu64", resync", seq, book->seq);
+        book_resync(book);
+        return -__LINE__;
+    }
+
+    int ret = book_update_list(book, book->asks, json_object_get(msg, "asks"));
+    if (ret == 0)
+        ret = book_update_list(book, book->bids, json_object_get(msg, "bids"));
+    if (ret < 0) {
+        book_resync(book);
+        return ret;
+    }
+    book->seq = seq;
 
-    json_t *diff = json_array();
-    mpd_t *price1  = NULL;
-    mpd_t *amount1 = NULL;
-    mpd_t *price2  = NULL;
-    mpd_t *amount2 = NULL;
-
-    size_t list1_size = json_array_size(list1);
-    size_t list2_size = json_array_size(list2);
-    size_t list1_pos = 0;
-    size_t list2_pos = 0;
-
-    while (list1_pos < list1_size && list2_pos < list2_size) {
-        json_t *unit1 = json_array_get(list1, list1_pos);
-        const char *unit1_price  = json_string_value(json_array_get(unit1, 0));
-        const char *unit1_amount = json_string_value(json_array_get(unit1, 1));
-        if (unit1_price == NULL || unit1_amount == NULL)
-            goto error;
-        price1 = decimal(unit1_price, 0);
-        amount1 = decimal(unit1_amount, 0);
-        if (price1 == NULL || amount1 == NULL)
-            goto error;
-
-        json_t *unit2 = json_array_get(list2, list2_pos);
-        const char *unit2_price  = json_string_value(json_array_get(unit2, 0));
-        const char *unit2_amount = json_string_value(json_array_get(unit2, 1));
-        if (unit2_price == NULL || unit2_amount == NULL)
-            goto error;
-        price2 = decimal(unit2_price, 0);
-        amount2 = decimal(unit2_amount, 0);
-        if (price2 == NULL || amount2 == NULL)
-            goto error;
-
-        int cmp = mpd_cmp(price1, price2, &mpd_ctx) * side;
+    return 0;
+}
+
+/* top limit levels of the book, merged by interval when it is not 0,
+ * asks round the price up and bids round it down */
+static void get_depth_list(skiplist_t *list, uint32_t limit, fixed_t interval, int side, struct depth_list *result)
+{
+    skiplist_iter *iter = skiplist_get_iterator(list);
+    skiplist_node *node = skiplist_next(iter);
+
+    result->count = 0;
+    if (interval == 0) {
+        for (; node && result->count < limit; node = skiplist_next(iter)) {
+            struct depth_level *level = node->value;
+            struct depth_unit *unit = &result->units[result->count++];
+            unit->price = level->price;
+            unit->amount = level->amount;
+        }
+        skiplist_release_iterator(iter);
+        return;
+    }
+
+    while (node && result->count < limit) {
+        struct depth_level *level = node->value;
+        fixed_t price = level->price / interval * interval;
+        if (side > 0 && level->price % interval != 0)
+            price += interval;
+        fixed_t amount = level->amount;
+        while ((node = skiplist_next(iter)) != NULL) {
+            level = node->value;
+            if (fixed_cmp(price, level->price) * side < 0)
+                break;
+            amount += level->amount;
+        }
+
+        struct depth_unit *unit = &result->units[result->count++];
+        unit->price = price;
+        unit->amount = amount;
+    }
+    skiplist_release_iterator(iter);
+}
+
+/* same text as json_array_append_new_mpd gives for the decimal */
+static json_t *fixed_json(fixed_t value, int prec)
+{
+    while (prec > 0 && value % 10 == 0) {
+        value /= 10;
+        prec -= 1;
+    }
+
+    mpd_uint_t data[MPD_MINALLOC_MAX];
+    mpd_t tmp = { MPD_STATIC | MPD_STATIC_DATA, 0, 0, 0, MPD_MINALLOC_MAX, data };
+    mpd_set_fixed(&tmp, value, prec);
+    char buf[MPD_FORMAT_MAX];
+    mpd_format(buf, &tmp, false);
+    mpd_del(&tmp);
+
+    return json_string(buf);
+}
+
+static json_t *get_unit_json(struct depth_val *val, fixed_t price, fixed_t amount)
+{
+    json_t *unit = json_array();
+    json_array_append_new(unit, fixed_json(price, val->price_prec));
+    if (amount == 0) {
+        json_array_append_new(unit, json_string("0"));
+    } else {
+        json_array_append_new(unit, fixed_json(amount, val->amount_prec));
+    }
+    return unit;
+}
+
+static json_t *get_list_json(struct depth_val *val, struct depth_list *list, uint32_t limit)
+{
+    json_t *result = json_array();
+    for (uint32_t i = 0; i < list->count && i < limit; ++i) {
+        json_array_append_new(result, get_unit_json(val, list->units[i].price, list->units[i].amount));
+    }
+    return result;
+}
+
+static json_t *get_depth_json(struct depth_val *val, struct depth_list *depth, uint32_t limit)
+{
+    json_t *result = json_object();
+    json_object_set_new(result, "asks", get_list_json(val, &depth[DEPTH_ASKS], limit));
+    json_object_set_new(result, "bids", get_list_json(val, &depth[DEPTH_BIDS], limit));
+    return result;
+}
+
+/* linear merge of two sorted lists, levels that are gone are sent with
+ * amount 0, unless the new list is full and they just fell out of it */
+static json_t *get_list_diff(struct depth_val *val, struct depth_list *list1, struct depth_list *list2, uint32_t limit, int side)
+{
+    json_t *diff = NULL;
+    uint32_t pos1 = 0;
+    uint32_t pos2 = 0;
+
+    while (pos1 < list1->count && pos2 < list2->count) {
+        struct depth_unit *unit1 = &list1->units[pos1];
+        struct depth_unit *unit2 = &list2->units[pos2];
+        int cmp = fixed_cmp(unit1->price, unit2->price) * side;
         if (cmp == 0) {
-            list1_pos += 1;
-            list2_pos += 1;
-            if (mpd_cmp(amount1, amount2, &mpd_ctx) != 0) {
-                json_array_append(diff, unit2);
-            }
+            pos1 += 1;
+            pos2 += 1;
+            if (unit1->amount == unit2->amount)
+                continue;
         } else if (cmp > 0) {
-            list2_pos += 1;
-            json_array_append(diff, unit2);
+            pos2 += 1;
         } else {
-            list1_pos += 1;
-            json_t *unit = json_array();
-            json_array_append_new_mpd(unit, price1);
-            json_array_append_new(unit, json_string("0"));
-            json_array_append_new(diff, unit);
+            pos1 += 1;
+            unit2 = NULL;
         }
 
-        mpd_del(price1);
-        price1  = NULL;
-        mpd_del(amount1);
-        amount1 = NULL;
-        mpd_del(price2);
-        price2  = NULL;
-        mpd_del(amount2);
-        amount2 = NULL;
-    }
-
-    while (list2_size < limit && list1_pos < list1_size) {
-        json_t *unit = json_array_get(list1, list1_pos);
-        const char *price = json_string_value(json_array_get(unit, 0));
-        const char *amount = json_string_value(json_array_get(unit, 1));
-        if (price == NULL || amount == NULL)
-            goto error;
-        json_t *new = json_array();
-        json_array_append_new(new, json_string(price));
-        json_array_append_new(new, json_string("0"));
-        json_array_append_new(diff, new);
-        list1_pos += 1;
+        if (diff == NULL)
+            diff = json_array();
+        if (unit2) {
+            json_array_append_new(diff, get_unit_json(val, unit2->price, unit2->amount));
+        } else {
+            json_array_append_new(diff, get_unit_json(val, unit1->price, 0));
+        }
     }
 
-    for (;list2_pos < list2_size; ++list2_pos) {
-        json_array_append(diff, json_array_get(list2, list2_pos));
+    if (list2->count < limit) {
+        for (; pos1 < list1->count; ++pos1) {
+            if (diff == NULL)
+                diff = json_array();
+            json_array_append_new(diff, get_unit_json(val, list1->units[pos1].price, 0));
+        }
     }
 
-    if (json_array_size(diff) == 0) {
-        json_decref(diff);
-        return NULL;
+    for (; pos2 < list2->count; ++pos2) {
+        if (diff == NULL)
+            diff = json_array();
+        json_array_append_new(diff, get_unit_json(val, list2->units[pos2].price, list2->units[pos2].amount));
     }
 
     return diff;
+}
 
-error:
-    json_decref(diff);
-    if (price1)
-        mpd_del(price1);
-    if (amount1)
-        mpd_del(amount1);
-    if (price2)
-        mpd_del(price2);
-    if (amount2)
-        mpd_del(amount2);
+static struct depth_list truncate_list(struct depth_list *list, uint32_t limit)
+{
+    struct depth_list result = { list->units, list->count < limit ? list->count : limit };
+    return result;
+}
 
-    return NULL;
+static json_t *get_side_diff(struct depth_val *val, int index, uint32_t limit, int side)
+{
+    struct depth_list list1 = truncate_list(&val->last[index], limit);
+    struct depth_list list2 = truncate_list(&val->next[index], limit);
+    return get_list_diff(val, &list1, &list2, limit, side);
 }
 
-static json_t *get_depth_diff(json_t *first, json_t *second, uint32_t limit)
+static json_t *get_depth_diff(struct depth_val *val, uint32_t limit)
 {
-    json_t *asks = get_list_diff(json_object_get(first, "asks"), json_object_get(second, "asks"), limit,  1);
-    json_t *bids = get_list_diff(json_object_get(first, "bids"), json_object_get(second, "bids"), limit, -1);
+    json_t *asks = get_side_diff(val, DEPTH_ASKS, limit,  1);
+    json_t *bids = get_side_diff(val, DEPTH_BIDS, limit, -1);
     if (asks == NULL && bids == NULL)
         return NULL;
     json_t *diff = json_object();
@@ -212,55 +581,137 @@ static int broadcast_update(const char *market, dict_t *sessions, bool clean, js
     json_array_append(params, result);
     json_array_append_new(params, json_string(market));
 
-    dict_iterator *iter = dict_get_iterator(sessions);
-    dict_entry *entry;
-    while ((entry = dict_next(iter)) != NULL) {
-        send_notify(entry->key, "depth.update", params);
-    }
-    dict_release_iterator(iter);
+    int ret = send_notify_dict(sessions, "depth.update", params);
     json_decref(params);
 
-    return 0;
+    return ret;
 }
 
-static int on_market_depth_reply(struct state_data *state, json_t *result)
+static void swap_depth(struct depth_val *val)
 {
-    dict_entry *entry = dict_find(dict_depth, &state->key);
-    if (entry == NULL)
-        return -__LINE__;
-    struct depth_key *key = entry->key;
-    struct depth_val *val = entry->val;
-    if (val->last == NULL) {
-        val->last = result;
-        val->last_clean = time(NULL);
-        json_incref(result);
-        return broadcast_update(state->key.market, val->sessions, true, result);
+    for (int i = 0; i < 2; ++i) {
+        struct depth_list tmp = val->last[i];
+        val->last[i] = val->next[i];
+        val->next[i] = tmp;
     }
+}
 
-    json_t *diff = get_depth_diff(val->last, result, key->limit);
-    if (diff == NULL) {
-        return 0;
+static uint32_t get_max_limit(struct depth_val *val)
+{
+    uint32_t limit = 0;
+    for (int i = 0; i < settings.depth_limit.count; ++i) {
+        struct depth_view *view = &val->views[i];
+        if (view->sessions && dict_size(view->sessions) > 0 && (uint32_t)settings.depth_limit.limit[i] > limit)
+            limit = settings.depth_limit.limit[i];
     }
+    return limit;
+}
+
+static void send_view_clean(struct depth_key *key, struct depth_val *val, struct depth_view *view, uint32_t limit, time_t now)
+{
+    view->last_clean = now;
+    json_t *result = get_depth_json(val, val->next, limit);
+    broadcast_update(key->market, view->sessions, true, result);
+    json_decref(result);
+}
 
-    json_decref(val->last);
-    val->last = result;
-    json_incref(result);
+static int on_depth_update(struct depth_key *key, struct depth_val *val, struct depth_book *book, uint32_t limit)
+{
+    ERR_RET(book_rescale(book, val->interval_prec, 0));
+    fixed_t interval;
+    if (mpd_get_fixed(val->interval, book->price_prec, &interval) < 0)
+        return -__LINE__;
+
+    val->seq = book->seq;
+    val->limit = limit;
+    get_depth_list(book->asks, limit, interval,  1, &val->next[DEPTH_ASKS]);
+    get_depth_list(book->bids, limit, interval, -1, &val->next[DEPTH_BIDS]);
+
+    // the prec of the book grew, old and new depth are not comparable
+    bool clean = false;
+    if (!val->has_last || val->price_prec != book->price_prec || val->amount_prec != book->amount_prec) {
+        clean = true;
+        val->has_last = true;
+        val->price_prec = book->price_prec;
+        val->amount_prec = book->amount_prec;
+    }
 
     time_t now = time(NULL);
-    if (now - val->last_clean >= CLEAN_INTERVAL) {
-        val->last_clean = now;
-        broadcast_update(state->key.market, val->sessions, true, result);
-    } else {
-        broadcast_update(state->key.market, val->sessions, false, diff);
+    for (int i = 0; i < settings.depth_limit.count; ++i) {
+        struct depth_view *view = &val->views[i];
+        if (view->sessions == NULL || dict_size(view->sessions) == 0)
+            continue;
+        uint32_t view_limit = settings.depth_limit.limit[i];
+        if (clean) {
+            send_view_clean(key, val, view, view_limit, now);
+            continue;
+        }
+
+        json_t *diff = get_depth_diff(val, view_limit);
+        if (diff == NULL)
+            continue;
+        if (now - view->last_clean >= CLEAN_INTERVAL) {
+            send_view_clean(key, val, view, view_limit, now);
+        } else {
+            broadcast_update(key->market, view->sessions, false, diff);
+        }
+        json_decref(diff);
     }
-    json_decref(diff);
+    swap_depth(val);
 
     return 0;
 }
 
+static int on_snapshot_reply(const char *market, json_t *result)
+{
+    dict_entry *entry = dict_find(dict_book, market);
+    if (entry == NULL)
+        return 0;
+    struct depth_book *book = entry->val;
+    book->syncing = false;
+    book->synced = false;
+
+    json_t *seq = json_object_get(result, "seq");
+    if (!json_is_integer(seq))
+        return -__LINE__;
+    ERR_RET(book_reset(book));
+    ERR_RET(book_update_list(book, book->asks, json_object_get(result, "asks")));
+    ERR_RET(book_update_list(book, book->bids, json_object_get(result, "bids")));
+    book->seq = json_integer_value(seq);
+    book->synced = true;
+
+    // messages older than the snapshot are skipped by book_apply
+    int ret = 0;
+    list_node *node;
+    list_iter *iter = list_get_iterator(book->pending, LIST_START_HEAD);
+    while ((node = list_next(iter)) != NULL && book->synced) {
+        ret = book_apply(book, node->value);
+        if (ret < 0)
+            break;
+        list_del(book->pending, node);
+    }
+    list_release_iterator(iter);
+
+    return ret;
+}
+
+static void drop_market(const char *market)
+{
+    dict_iterator *iter = dict_get_iterator(dict_depth);
+    dict_entry *entry;
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_key *key = entry->key;
+        if (strcmp(key->market, market) == 0) {
+            dict_delete(dict_depth, entry->key);
+        }
+    }
+    dict_release_iterator(iter);
+    dict_delete(dict_book, market);
+}
+
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -270,7 +721,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_load(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -282,7 +733,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
     json_t *error = json_object_get(reply, "error");
     if (error && !json_is_null(error)) {
-        dict_delete(dict_depth, &state->key);
+        drop_market(state->market);
     }
     json_t *result = json_object_get(reply, "result");
     if (error == NULL || !json_is_null(error) || result == NULL) {
@@ -295,10 +746,10 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
     int ret;
     switch (pkg->command) {
-    case CMD_ORDER_BOOK_DEPTH:
-        ret = on_market_depth_reply(state, result);
+    case CMD_ORDER_BOOK_SNAPSHOT:
+        ret = on_snapshot_reply(state->market, result);
         if (ret < 0) {
-            log_error("on_market_depth_reply: %d, reply: %s", ret, reply_str);
+            log_error("on_snapshot_reply: %d, reply: %s", ret, reply_str);
         }
         break;
     default:
@@ -313,47 +764,116 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
 static void on_timeout(nw_state_entry *entry)
 {
-    log_fatal("query depth timeout, state id: %u", entry->id);
+    struct state_data *state = entry->data;
+    log_fatal("query depth snapshot timeout, state id: %u, market: %s", entry->id, state->market);
+    dict_entry *book_entry = dict_find(dict_book, state->market);
+    if (book_entry) {
+        struct depth_book *book = book_entry->val;
+        book->syncing = false;
+    }
+}
+
+static void send_snapshot_request(const char *market, struct depth_book *book)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_string(market));
+
+    nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
+    struct state_data *state = state_entry->data;
+    snprintf(state->market, sizeof(state->market), "%s", market);
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = CMD_ORDER_BOOK_SNAPSHOT;
+    pkg.sequence  = state_entry->id;
+    if (rpc_body_dump(&pkg, params, matchengine->body_type) < 0) {
+        log_error("encode request body fail, cmd: %u", pkg.command);
+        nw_state_del(state_context, state_entry->id);
+        json_decref(params);
+        return;
+    }
+
+    rpc_clt_send(matchengine, &pkg);
+    log_trace("send request to %s, cmd: %u, sequence: %u, body size: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, pkg.body_size);
+    free(pkg.body);
+    json_decref(params);
+    book->syncing = true;
 }
 
 static void on_timer(nw_timer *timer, void *privdata)
 {
-    dict_iterator *iter = dict_get_iterator(dict_depth);
+    dict_iterator *iter = dict_get_iterator(dict_book);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        const struct depth_val *obj = entry->val;
-        if (dict_size(obj->sessions) == 0) {
+        struct depth_book *book = entry->val;
+        book->active = false;
+    }
+    dict_release_iterator(iter);
+
+    iter = dict_get_iterator(dict_depth);
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_val *val = entry->val;
+        uint32_t limit = get_max_limit(val);
+        if (limit == 0) {
             dict_delete(dict_depth, entry->key);
             continue;
         }
 
         struct depth_key *key = entry->key;
-        json_t *params = json_array();
-        json_array_append_new(params, json_string(key->market));
-        json_array_append_new(params, json_integer(key->limit));
-        json_array_append_new(params, json_string(key->interval));
-
-        nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
-        struct state_data *state = state_entry->data;
-        memcpy(&state->key, key, sizeof(struct depth_key));
-
-        rpc_pkg pkg;
-        memset(&pkg, 0, sizeof(pkg));
-        pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
-        pkg.command   = CMD_ORDER_BOOK_DEPTH;
-        pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
-
-        rpc_clt_send(matchengine, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, (char *)pkg.body);
-        free(pkg.body);
-        json_decref(params);
+        struct depth_book *book = get_book(key->market);
+        if (book == NULL)
+            continue;
+        book->active = true;
+        // a view with a larger limit needs levels beyond the last depth
+        if (!book->synced || (val->has_last && val->seq == book->seq && val->limit >= limit))
+            continue;
+        int ret = on_depth_update(key, val, book, limit);
+        if (ret < 0) {
+            log_error("on_depth_update: %d, market: %s", ret, key->market);
+        }
+    }
+    dict_release_iterator(iter);
+
+    iter = dict_get_iterator(dict_book);
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_book *book = entry->val;
+        if (!book->active) {
+            dict_delete(dict_book, entry->key);
+            continue;
+        }
+        if (!book->synced && !book->syncing) {
+            send_snapshot_request(entry->key, book);
+        }
     }
     dict_release_iterator(iter);
 }
 
+int depth_on_message(json_t *msg)
+{
+    const char *market = json_string_value(json_object_get(msg, "market"));
+    if (market == NULL || !json_is_integer(json_object_get(msg, "seq")))
+        return -__LINE__;
+
+    dict_entry *entry = dict_find(dict_book, market);
+    if (entry == NULL)
+        return 0;
+    struct depth_book *book = entry->val;
+    if (book->synced)
+        return book_apply(book, msg);
+
+    // keep the messages until the snapshot arrives, a gap caused by
+    // dropping them is detected by seq and triggers another snapshot
+    if (list_len(book->pending) >= PENDING_MAX) {
+        list_clear(book->pending);
+    }
+    json_incref(msg);
+    list_add_node_tail(book->pending, msg);
+
+    return 0;
+}
+
 int init_depth(void)
 {
     dict_types dt;
@@ -369,6 +889,18 @@ int init_depth(void)
     if (dict_depth == NULL)
         return -__LINE__;
 
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = dict_book_hash_func;
+    dt.key_compare = dict_book_key_compare;
+    dt.key_dup = dict_book_key_dup;
+    dt.key_destructor = dict_book_key_free;
+    dt.val_dup = dict_book_val_dup;
+    dt.val_destructor = dict_book_val_free;
+
+    dict_book = dict_create(&dt, 64);
+    if (dict_book == NULL)
+        return -__LINE__;
+
     rpc_clt_type ct;
     memset(&ct, 0, sizeof(ct));
     ct.on_connect = on_backend_connect;
@@ -394,15 +926,27 @@ int init_depth(void)
     return 0;
 }
 
-static bool is_good_limit(int limit)
+static int get_limit_index(uint32_t limit)
 {
     for (int i = 0; i < settings.depth_limit.count; ++i) {
-        if (settings.depth_limit.limit[i] == limit) {
-            return true;
+        if ((uint32_t)settings.depth_limit.limit[i] == limit) {
+            return i;
         }
     }
 
-    return false;
+    return -1;
+}
+
+static uint32_t get_limit_max(void)
+{
+    uint32_t max = 0;
+    for (int i = 0; i < settings.depth_limit.count; ++i) {
+        if ((uint32_t)settings.depth_limit.limit[i] > max) {
+            max = settings.depth_limit.limit[i];
+        }
+    }
+
+    return max;
 }
 
 static bool is_good_interval(const char *interval)
@@ -424,7 +968,8 @@ static bool is_good_interval(const char *interval)
 
 int depth_subscribe(nw_ses *ses, const char *market, uint32_t limit, const char *interval)
 {
-    if (!is_good_limit(limit))
+    int index = get_limit_index(limit);
+    if (index < 0)
         return -1;
     if (!is_good_interval(interval))
         return -1;
@@ -433,28 +978,47 @@ int depth_subscribe(nw_ses *ses, const char *market, uint32_t limit, const char
     memset(&key, 0, sizeof(key));
     strncpy(key.market, market, MARKET_NAME_MAX_LEN - 1);
     strncpy(key.interval, interval, INTERVAL_MAX_LEN - 1);
-    key.limit = limit;
 
     dict_entry *entry = dict_find(dict_depth, &key);
     if (entry == NULL) {
         struct depth_val val;
         memset(&val, 0, sizeof(val));
 
-        dict_types dt;
-        memset(&dt, 0, sizeof(dt));
-        dt.hash_function = dict_ses_hash_func;
-        dt.key_compare = dict_ses_key_compare;
-        val.sessions = dict_create(&dt, 1024);
-        if (val.sessions == NULL)
+        val.views = calloc(settings.depth_limit.count, sizeof(struct depth_view));
+        if (val.views == NULL)
             return -__LINE__;
+        val.interval = decimal(interval, 0);
+        val.interval_prec = get_scale(val.interval);
+        uint32_t limit_max = get_limit_max();
+        for (int i = 0; i < 2; ++i) {
+            val.last[i].units = malloc(sizeof(struct depth_unit) * limit_max);
+            val.next[i].units = malloc(sizeof(struct depth_unit) * limit_max);
+            if (val.last[i].units == NULL || val.next[i].units == NULL) {
+                depth_val_clear(&val);
+                return -__LINE__;
+            }
+        }
 
         entry = dict_add(dict_depth, &key, &val);
-        if (entry == NULL)
+        if (entry == NULL) {
+            depth_val_clear(&val);
             return -__LINE__;
+        }
     }
 
     struct depth_val *obj = entry->val;
-    dict_add(obj->sessions, ses, NULL);
+    struct depth_view *view = &obj->views[index];
+    if (view->sessions == NULL) {
+        dict_types dt;
+        memset(&dt, 0, sizeof(dt));
+        dt.hash_function = dict_ses_hash_func;
+        dt.key_compare = dict_ses_key_compare;
+        view->sessions = dict_create(&dt, 1024);
+        if (view->sessions == NULL)
+            return -__LINE__;
+        view->last_clean = time(NULL);
+    }
+    dict_add(view->sessions, ses, NULL);
 
     return 0;
 }
@@ -465,7 +1029,10 @@ int depth_unsubscribe(nw_ses *ses)
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
         struct depth_val *obj = entry->val;
-        dict_delete(obj->sessions, ses);
+        for (int i = 0; i < settings.depth_limit.count; ++i) {
+            if (obj->views[i].sessions)
+                dict_delete(obj->views[i].sessions, ses);
+        }
     }
     dict_release_iterator(iter);
 
@@ -478,22 +1045,20 @@ int depth_send_clean(nw_ses *ses, const char *market, uint32_t limit, const char
     memset(&key, 0, sizeof(key));
     strncpy(key.market, market, MARKET_NAME_MAX_LEN - 1);
     strncpy(key.interval, interval, INTERVAL_MAX_LEN - 1);
-    key.limit = limit;
 
     dict_entry *entry = dict_find(dict_depth, &key);
     if (entry == NULL)
         return 0;
 
     struct depth_val *obj = entry->val;
-    if (obj->last) {
+    if (obj->has_last) {
         json_t *params = json_array();
         json_array_append_new(params, json_boolean(true));
-        json_array_append(params, obj->last);
-        json_array_append(params, json_string(market));
+        json_array_append_new(params, get_depth_json(obj, obj->last, limit));
+        json_array_append_new(params, json_string(market));
         send_notify(ses, "depth.update", params);
         json_decref(params);
     }
 
     return 0;
 }
-
@@ -12,5 +12,8 @@ int depth_subscribe(nw_ses *ses, const char *market, uint32_t limit, const char
 int depth_send_clean(nw_ses *ses, const char *market, uint32_t limit, const char *interval);
 int depth_unsubscribe(nw_ses *ses);
 
+/* apply a depth message pushed by matchengine to the local book */
+int depth_on_message(json_t *msg);
+
 # endif
 
@@ -5,10 +5,12 @@
 
 #include "aw_listener.h"
 #include "aw_config.h"
+#include "ut_worker.h"
 
 static nw_svr *listener_svr;
 static nw_svr *monitor_svr;
 static rpc_svr *worker_svr;
+static worker_pool *workers;
 
 static int listener_decode_pkg(nw_ses *ses, void *data, size_t max) {
   return max;
@@ -21,19 +23,11 @@ static void listener_on_error_msg(nw_ses *ses, const char *msg) {
             nw_sock_human_addr(&ses->peer_addr), msg);
 }
 static int listener_on_accept(nw_ses *ses, int sockfd, nw_addr_t *peer_addr) {
-  if (worker_svr->raw_svr->ses_count == 0) {
+  nw_ses *curr = worker_pool_pick(workers);
+  if (curr == NULL) {
     log_error("no available worker");
     return -1;
   }
-  int worker = rand() % worker_svr->raw_svr->ses_count;
-  nw_ses *curr = worker_svr->raw_svr->ses_list_head;
-  for (int i = 0; i < worker && curr; ++i) {
-    curr = curr->next;
-  }
-  if (!curr) {
-    log_error("choice worker fail");
-    return -1;
-  }
   if (nw_ses_send_fd(curr, sockfd) < 0) {
     log_error("send sockfd fail: %s", strerror(errno));
     return -1;
@@ -61,12 +55,24 @@ static int init_listener_svr(void) {
   return 0;
 }
 
-static void worker_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) { return; }
+static void worker_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
+  if (pkg->command == CMD_WORKER_LOAD) {
+    int ret = worker_pool_report(workers, ses, pkg);
+    if (ret < 0) {
+      log_error("worker: %s load report invalid: %d",
+                nw_sock_human_addr(&ses->peer_addr), ret);
+    }
+  }
+}
 static void worker_on_new_connection(nw_ses *ses) {
+  if (worker_pool_add(workers, ses) == NULL) {
+    log_error("add worker: %s fail", nw_sock_human_addr(&ses->peer_addr));
+  }
   log_info("new worker connected, current worker number: %u",
            worker_svr->raw_svr->ses_count);
 }
 static void worker_on_connection_close(nw_ses *ses) {
+  worker_pool_del(workers, ses);
   log_info("worker close, current worker number: %u",
            worker_svr->raw_svr->ses_count - 1);
 }
@@ -84,7 +90,12 @@ static int init_worker_svr(void) {
   cfg.max_pkg_size = 1024;
   cfg.heartbeat_check = true;
 
+  workers = worker_pool_create();
+  if (workers == NULL)
+    return -__LINE__;
+
   rpc_svr_type type;
+  memset(&type, 0, sizeof(type));
   type.on_recv_pkg = worker_on_recv_pkg;
   type.on_new_connection = worker_on_new_connection;
   type.on_connection_close = worker_on_connection_close;
@@ -101,8 +112,11 @@ static int init_worker_svr(void) {
 static int monitor_decode_pkg(nw_ses *ses, void *data, size_t max) {
   return max;
 }
+// 返回各worker的负载
 static void monitor_on_recv_pkg(nw_ses *ses, void *data, size_t size) {
-  return;
+  sds reply = worker_pool_status(workers, sdsempty());
+  nw_ses_send(ses, reply, sdslen(reply));
+  sdsfree(reply);
 }
 
 static int init_monitor_svr(void) {
@@ -7,9 +7,11 @@
 # include "aw_message.h"
 # include "aw_asset.h"
 # include "aw_order.h"
+# include "aw_depth.h"
 
 static kafka_consumer_t *kafka_orders;
 static kafka_consumer_t *kafka_balances;
+static kafka_consumer_t *kafka_depth;
 
 static int process_orders_message(json_t *msg)
 {
@@ -79,6 +81,23 @@ static void on_balances_message(sds message, int64_t offset)
     json_decref(msg);
 }
 
+static void on_depth_message(sds message, int64_t offset)
+{
+    log_trace("depth message: %s", message);
+    json_t *msg = json_loads(message, 0, NULL);
+    if (!msg) {
+        log_error("invalid depth message: %s", message);
+        return;
+    }
+
+    int ret = depth_on_message(msg);
+    if (ret < 0) {
+        log_error("depth_on_message: %s fail: %d", message, ret);
+    }
+
+    json_decref(msg);
+}
+
 int init_message(void)
 {
     settings.orders.offset = RD_KAFKA_OFFSET_END;
@@ -93,6 +112,12 @@ int init_message(void)
         return -__LINE__;
     }
 
+    settings.depth.offset = RD_KAFKA_OFFSET_END;
+    kafka_depth = kafka_consumer_create(&settings.depth, on_depth_message);
+    if (kafka_depth == NULL) {
+        return -__LINE__;
+    }
+
     return 0;
 }
 
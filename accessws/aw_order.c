@@ -133,16 +133,21 @@ int order_on_update(uint32_t user_id, int event, json_t *order)
     json_array_append_new(params, json_integer(event));
     json_array_append(params, order);
 
+    ws_frame *frame = NULL;
     list_t *list = entry->val;
     list_iter *iter = list_get_iterator(list, LIST_START_HEAD);
     list_node *node;
     while ((node = list_next(iter)) != NULL) {
         struct sub_unit *unit = node->value;
         if (strcmp(unit->market, market) == 0) {
-            send_notify(unit->ses, "order.update", params);
+            if (frame == NULL && (frame = notify_frame("order.update", params)) == NULL)
+                break;
+            ws_send_frame(unit->ses, frame);
         }
     }
     list_release_iterator(iter);
+    if (frame)
+        ws_frame_release(frame);
     json_decref(params);
 
     return 0;
@@ -15,6 +15,7 @@
 #include "aw_sign.h"
 #include "aw_state.h"
 #include "aw_today.h"
+#include "ut_worker.h"
 
 static ws_svr *svr;
 static dict_t *method_map;
@@ -128,6 +129,36 @@ int send_notify(nw_ses *ses, const char *method, json_t *params) {
   return ret;
 }
 
+ws_frame *notify_frame(const char *method, json_t *params) {
+  json_t *notify = json_object();
+  json_object_set_new(notify, "method", json_string(method));
+  json_object_set(notify, "params", params);
+  json_object_set_new(notify, "id", json_null());
+
+  char *message_data = json_dumps(notify, 0);
+  json_decref(notify);
+  if (message_data == NULL)
+    return NULL;
+  log_trace("notify frame, size: %zu, message: %s", strlen(message_data),
+            message_data);
+  ws_frame *frame = ws_frame_text(message_data);
+  free(message_data);
+
+  return frame;
+}
+
+int send_notify_dict(dict_t *sessions, const char *method, json_t *params) {
+  if (dict_size(sessions) == 0)
+    return 0;
+  ws_frame *frame = notify_frame(method, params);
+  if (frame == NULL)
+    return -__LINE__;
+  ws_send_frame_dict(sessions, frame);
+  ws_frame_release(frame);
+
+  return 0;
+}
+
 static int on_method_server_ping(nw_ses *ses, uint64_t id,
                                  struct clt_info *info, json_t *params) {
   json_t *result = json_string("pong");
@@ -1157,6 +1188,9 @@ static int init_listener_clt(void) {
     return -__LINE__;
   if (rpc_clt_start(listener) < 0)
     return -__LINE__;
+  // 定期向listener上报负载，listener据此选择负载最小的worker
+  if (worker_report_start(listener, svr->raw_svr) < 0)
+    return -__LINE__;
 
   return 0;
 }
@@ -25,6 +25,9 @@ int send_error_service_timeout(nw_ses *ses, uint64_t id);
 int send_result(nw_ses *ses, uint64_t id, json_t *result);
 int send_success(nw_ses *ses, uint64_t id);
 int send_notify(nw_ses *ses, const char *method, json_t *params);
+// serialize and frame a notify once, for sending to many sessions
+ws_frame *notify_frame(const char *method, json_t *params);
+int send_notify_dict(dict_t *sessions, const char *method, json_t *params);
 
 # endif
 
@@ -13,6 +13,7 @@ static rpc_clt *marketprice;
 static nw_state *state_context;
 
 struct state_data {
+    uint32_t command;
     char market[MARKET_NAME_MAX_LEN];
 };
 
@@ -67,6 +68,34 @@ static void dict_market_val_free(void *val)
     free(obj);
 }
 
+/* subscribe or unsubscribe status today push of marketprice */
+static void send_request(uint32_t command, const char *market)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_integer(CMD_MARKET_STATUS_TODAY));
+    json_array_append_new(params, json_string(market));
+    json_array_append_new(params, json_integer(0));
+
+    nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
+    struct state_data *state = state_entry->data;
+    state->command = command;
+    strncpy(state->market, market, MARKET_NAME_MAX_LEN - 1);
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = command;
+    pkg.sequence  = state_entry->id;
+    pkg.body      = json_dumps(params, 0);
+    pkg.body_size = strlen(pkg.body);
+
+    rpc_clt_send(marketprice, &pkg);
+    log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
+            nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, (char *)pkg.body);
+    free(pkg.body);
+    json_decref(params);
+}
+
 static void on_backend_connect(nw_ses *ses, bool result)
 {
     rpc_clt *clt = ses->privdata;
@@ -74,7 +103,16 @@ static void on_backend_connect(nw_ses *ses, bool result)
         log_info("connect %s:%s success", clt->name, nw_sock_human_addr(&ses->peer_addr));
     } else {
         log_info("connect %s:%s fail", clt->name, nw_sock_human_addr(&ses->peer_addr));
+        return;
     }
+
+    // subscriptions are per connection in marketprice
+    dict_iterator *iter = dict_get_iterator(dict_market);
+    dict_entry *entry;
+    while ((entry = dict_next(iter)) != NULL) {
+        send_request(CMD_MARKET_SUBSCRIBE, entry->key);
+    }
+    dict_release_iterator(iter);
 }
 
 static int on_market_status_today_reply(struct state_data *state, json_t *result)
@@ -100,12 +138,7 @@ static int on_market_status_today_reply(struct state_data *state, json_t *result
         json_array_append_new(params, json_string(state->market));
         json_array_append(params, result);
 
-        dict_iterator *iter = dict_get_iterator(obj->sessions);
-        dict_entry *entry;
-        while ((entry = dict_next(iter)) != NULL) {
-            send_notify(entry->key, "today.update", params);
-        }
-        dict_release_iterator(iter);
+        send_notify_dict(obj->sessions, "today.update", params);
         json_decref(params);
     }
 
@@ -115,8 +148,37 @@ static int on_market_status_today_reply(struct state_data *state, json_t *result
     return 0;
 }
 
+/* push body: [market, interval, result] */
+static void on_backend_push(nw_ses *ses, rpc_pkg *pkg)
+{
+    json_t *body = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    const char *market = json_string_value(json_array_get(body, 0));
+    if (pkg->command != CMD_MARKET_STATUS_TODAY || market == NULL) {
+        log_error("invalid push from: %s, cmd: %u", nw_sock_human_addr(&ses->peer_addr), pkg->command);
+        if (body)
+            json_decref(body);
+        return;
+    }
+
+    struct state_data state;
+    memset(&state, 0, sizeof(state));
+    strncpy(state.market, market, MARKET_NAME_MAX_LEN - 1);
+    if (dict_find(dict_market, state.market)) {
+        int ret = on_market_status_today_reply(&state, json_array_get(body, 2));
+        if (ret < 0) {
+            log_error("on_market_status_today_reply: %d, market: %s", ret, market);
+        }
+    }
+    json_decref(body);
+}
+
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
+    if (pkg->pkg_type == RPC_PKG_TYPE_PUSH) {
+        on_backend_push(ses, pkg);
+        return;
+    }
+
     sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
@@ -138,7 +200,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
 
     json_t *error = json_object_get(reply, "error");
-    if (error && !json_is_null(error)) {
+    if (error && !json_is_null(error) && state->command == CMD_MARKET_SUBSCRIBE) {
         dict_delete(dict_market, state->market);
     }
     json_t *result = json_object_get(reply, "result");
@@ -150,13 +212,9 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
         return;
     }
 
-    int ret;
     switch (pkg->command) {
-    case CMD_MARKET_STATUS_TODAY:
-        ret = on_market_status_today_reply(state, result);
-        if (ret < 0) {
-            log_error("on_market_status_today_reply: %d, reply: %s", ret, reply_str);
-        }
+    case CMD_MARKET_SUBSCRIBE:
+    case CMD_MARKET_UNSUBSCRIBE:
         break;
     default:
         log_error("recv unknown command: %u from: %s", pkg->command, nw_sock_human_addr(&ses->peer_addr));
@@ -170,9 +228,14 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
 static void on_timeout(nw_state_entry *entry)
 {
-    log_fatal("query status today timeout, state id: %u", entry->id);
+    struct state_data *state = entry->data;
+    log_fatal("request status today timeout, state id: %u, cmd: %u", entry->id, state->command);
+    if (state->command == CMD_MARKET_SUBSCRIBE && dict_find(dict_market, state->market)) {
+        send_request(CMD_MARKET_SUBSCRIBE, state->market);
+    }
 }
 
+/* updates are pushed by marketprice, only drop the unused subscriptions */
 static void on_timer(nw_timer *timer, void *privdata)
 {
     dict_iterator *iter = dict_get_iterator(dict_market);
@@ -180,31 +243,10 @@ static void on_timer(nw_timer *timer, void *privdata)
     while ((entry = dict_next(iter)) != NULL) {
         const struct market_val *obj = entry->val;
         if (dict_size(obj->sessions) == 0) {
+            if (rpc_clt_connected(marketprice))
+                send_request(CMD_MARKET_UNSUBSCRIBE, entry->key);
             dict_delete(dict_market, entry->key);
-            continue;
         }
-
-        const char *market = entry->key;
-        json_t *params = json_array();
-        json_array_append_new(params, json_string(market));
-
-        nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
-        struct state_data *state = state_entry->data;
-        strncpy(state->market, market, MARKET_NAME_MAX_LEN - 1);
-
-        rpc_pkg pkg;
-        memset(&pkg, 0, sizeof(pkg));
-        pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
-        pkg.command   = CMD_MARKET_STATUS_TODAY;
-        pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
-
-        rpc_clt_send(marketprice, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, (char *)pkg.body);
-        free(pkg.body);
-        json_decref(params);
     }
     dict_release_iterator(iter);
 }
@@ -267,6 +309,9 @@ int today_subscribe(nw_ses *ses, const char *market)
         entry = dict_add(dict_market, (char *)market, &val);
         if (entry == NULL)
             return -__LINE__;
+        // on connect all subscriptions are sent
+        if (rpc_clt_connected(marketprice))
+            send_request(CMD_MARKET_SUBSCRIBE, market);
     }
 
     struct market_val *obj = entry->val;
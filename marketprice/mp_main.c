@@ -9,6 +9,7 @@
 
 #include "mp_config.h"
 #include "mp_message.h"
+#include "mp_push.h"
 #include "mp_server.h"
 
 const char *__process__ = "marketprice";
@@ -102,6 +103,11 @@ int main(int argc, char *argv[]) {
     error("init message fail: %d", ret);
   }
 
+  ret = init_push();
+  if (ret < 0) {
+    error("init push fail: %d", ret);
+  }
+
   ret = init_server();
   if (ret < 0) {
     error("init server fail: %d", ret);
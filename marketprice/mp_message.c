@@ -1327,6 +1327,45 @@ json_t *get_market_kline_month(const char *market, time_t start, time_t end,
   return result;
 }
 
+int check_kline_interval(int interval) {
+  if (interval <= 0)
+    return -__LINE__;
+  if (interval < 60) {
+    if (60 % interval != 0)
+      return -__LINE__;
+  } else if (interval < 3600) {
+    if (interval % 60 != 0 || 3600 % interval != 0)
+      return -__LINE__;
+  } else if (interval < 86400) {
+    if (interval % 3600 != 0 || 86400 % interval != 0)
+      return -__LINE__;
+  } else if (interval < 86400 * 7) {
+    if (interval % 86400 != 0)
+      return -__LINE__;
+  } else if (interval != 86400 * 7 && interval != 86400 * 30) {
+    return -__LINE__;
+  }
+
+  return 0;
+}
+
+json_t *get_market_kline(const char *market, time_t start, time_t end,
+                         int interval) {
+  if (interval < 60) {
+    return get_market_kline_sec(market, start, end, interval);
+  } else if (interval < 3600) {
+    return get_market_kline_min(market, start, end, interval);
+  } else if (interval < 86400) {
+    return get_market_kline_hour(market, start, end, interval);
+  } else if (interval < 86400 * 7) {
+    return get_market_kline_day(market, start, end, interval);
+  } else if (interval == 86400 * 7) {
+    return get_market_kline_week(market, start, end, interval);
+  } else {
+    return get_market_kline_month(market, start, end, interval);
+  }
+}
+
 json_t *get_market_deals(const char *market, int limit, uint64_t last_id) {
   struct market_info *info = market_query(market);
   if (info == NULL)
@@ -1360,3 +1399,11 @@ mpd_t *get_market_last_price(const char *market) {
 
   return info->last;
 }
+
+double get_market_update_time(const char *market) {
+  struct market_info *info = market_query(market);
+  if (info == NULL)
+    return 0;
+
+  return info->update_time;
+}
@@ -22,8 +22,13 @@ json_t *get_market_kline_hour(const char *market, time_t start, time_t end, int
 json_t *get_market_kline_day(const char *market, time_t start, time_t end, int interval);
 json_t *get_market_kline_week(const char *market, time_t start, time_t end, int interval);
 json_t *get_market_kline_month(const char *market, time_t start, time_t end, int interval);
+// 按interval选择上面的函数，interval需先经check_kline_interval检查
+int check_kline_interval(int interval);
+json_t *get_market_kline(const char *market, time_t start, time_t end, int interval);
 json_t *get_market_deals(const char *market, int limit, uint64_t last_id);
 mpd_t  *get_market_last_price(const char *market);
+// 最后一次成交的处理时间，市场不存在时返回0
+double  get_market_update_time(const char *market);
 
 # endif
 
@@ -0,0 +1,273 @@
+/*
+ * Description: 维护kline、最新价和市场状态的订阅表，数据变化时推送给订阅方
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+#include "mp_push.h"
+#include "mp_message.h"
+
+// 没有成交时也定期重新计算，使新周期的kline和滑动窗口的状态得到推送
+#define PUSH_REFRESH_INTERVAL 60
+
+static dict_t *dict_push;
+static nw_timer push_timer;
+
+struct push_key {
+  uint32_t command;
+  char market[MARKET_NAME_MAX + 1];
+  int interval;
+};
+
+struct push_val {
+  dict_t *sessions;
+  json_t *last;       // 最后一次推送的结果
+  double update_time; // 计算last时市场的成交处理时间
+  time_t period;      // 计算last时的刷新周期
+  time_t checked;     // 上次检查的时间
+};
+
+static uint32_t dict_ses_hash_func(const void *key) {
+  return dict_generic_hash_function(key, sizeof(void *));
+}
+
+static int dict_ses_key_compare(const void *key1, const void *key2) {
+  return key1 == key2 ? 0 : 1;
+}
+
+static uint32_t dict_push_hash_func(const void *key) {
+  return dict_generic_hash_function(key, sizeof(struct push_key));
+}
+
+static int dict_push_key_compare(const void *key1, const void *key2) {
+  return memcmp(key1, key2, sizeof(struct push_key));
+}
+
+static void *dict_push_key_dup(const void *key) {
+  struct push_key *obj = malloc(sizeof(struct push_key));
+  memcpy(obj, key, sizeof(struct push_key));
+  return obj;
+}
+
+static void dict_push_key_free(void *key) { free(key); }
+
+static void *dict_push_val_dup(const void *val) {
+  struct push_val *obj = malloc(sizeof(struct push_val));
+  memcpy(obj, val, sizeof(struct push_val));
+  return obj;
+}
+
+static void dict_push_val_free(void *val) {
+  struct push_val *obj = val;
+  dict_release(obj->sessions);
+  if (obj->last)
+    json_decref(obj->last);
+  free(obj);
+}
+
+static int get_key(struct push_key *key, uint32_t command, const char *market,
+                   int interval) {
+  if (strlen(market) > MARKET_NAME_MAX)
+    return -__LINE__;
+  memset(key, 0, sizeof(struct push_key));
+  key->command = command;
+  strcpy(key->market, market);
+  key->interval = interval;
+  return 0;
+}
+
+static time_t get_period(const struct push_key *key, time_t now) {
+  switch (key->command) {
+  case CMD_MARKET_LAST:
+    return 0;
+  case CMD_MARKET_KLINE:
+    if (key->interval < PUSH_REFRESH_INTERVAL)
+      return now / key->interval;
+    return now / PUSH_REFRESH_INTERVAL;
+  default:
+    return now / PUSH_REFRESH_INTERVAL;
+  }
+}
+
+// 与对应RPC命令的结果相同，kline从start所在周期开始，
+// 跨周期时包含上一周期的最终结果
+static json_t *get_result(const struct push_key *key, time_t start,
+                          time_t now) {
+  switch (key->command) {
+  case CMD_MARKET_KLINE:
+    return get_market_kline(key->market, start, now, key->interval);
+  case CMD_MARKET_LAST: {
+    mpd_t *last = get_market_last_price(key->market);
+    if (last == NULL)
+      return NULL;
+    char *last_str = mpd_to_sci(last, 0);
+    json_t *result = json_string(last_str);
+    free(last_str);
+    return result;
+  }
+  case CMD_MARKET_STATUS:
+    return get_market_status(key->market, key->interval);
+  case CMD_MARKET_STATUS_TODAY:
+    return get_market_status_today(key->market);
+  default:
+    return NULL;
+  }
+}
+
+// 推送包体: [market, interval, result]
+static char *get_push_body(const struct push_key *key, json_t *result) {
+  json_t *body = json_array();
+  json_array_append_new(body, json_string(key->market));
+  json_array_append_new(body, json_integer(key->interval));
+  json_array_append(body, result);
+  char *body_str = json_dumps(body, 0);
+  json_decref(body);
+  return body_str;
+}
+
+static void send_push(nw_ses *ses, const struct push_key *key, char *body) {
+  rpc_pkg pkg;
+  memset(&pkg, 0, sizeof(pkg));
+  pkg.pkg_type = RPC_PKG_TYPE_PUSH;
+  pkg.command = key->command;
+  pkg.body = body;
+  pkg.body_size = strlen(body);
+  rpc_send(ses, &pkg);
+}
+
+static void push_update(const struct push_key *key, struct push_val *val) {
+  char *body = get_push_body(key, val->last);
+  if (body == NULL)
+    return;
+  log_trace("push cmd: %u, sessions: %u, body: %s", key->command,
+            dict_size(val->sessions), body);
+
+  dict_iterator *iter = dict_get_iterator(val->sessions);
+  dict_entry *entry;
+  while ((entry = dict_next(iter)) != NULL) {
+    send_push(entry->key, key, body);
+  }
+  dict_release_iterator(iter);
+  free(body);
+}
+
+// 市场有新成交或到了新的刷新周期时重新计算，结果变化才推送
+static void on_push_timer(nw_timer *timer, void *privdata) {
+  time_t now = time(NULL);
+  dict_iterator *iter = dict_get_iterator(dict_push);
+  dict_entry *entry;
+  while ((entry = dict_next(iter)) != NULL) {
+    const struct push_key *key = entry->key;
+    struct push_val *val = entry->val;
+    double update_time = get_market_update_time(key->market);
+    time_t period = get_period(key, now);
+    time_t start = val->last ? val->checked : now;
+    val->checked = now;
+    if (val->last && update_time == val->update_time && period == val->period)
+      continue;
+
+    json_t *result = get_result(key, start, now);
+    if (result == NULL)
+      continue;
+    val->update_time = update_time;
+    val->period = period;
+    if (val->last && json_equal(val->last, result)) {
+      json_decref(result);
+      continue;
+    }
+
+    if (val->last)
+      json_decref(val->last);
+    val->last = result;
+    push_update(key, val);
+  }
+  dict_release_iterator(iter);
+}
+
+int init_push(void) {
+  dict_types dt;
+  memset(&dt, 0, sizeof(dt));
+  dt.hash_function = dict_push_hash_func;
+  dt.key_compare = dict_push_key_compare;
+  dt.key_dup = dict_push_key_dup;
+  dt.key_destructor = dict_push_key_free;
+  dt.val_dup = dict_push_val_dup;
+  dt.val_destructor = dict_push_val_free;
+
+  dict_push = dict_create(&dt, 64);
+  if (dict_push == NULL)
+    return -__LINE__;
+
+  nw_timer_set(&push_timer, settings.push_interval, true, on_push_timer, NULL);
+  nw_timer_start(&push_timer);
+
+  return 0;
+}
+
+int push_subscribe(nw_ses *ses, uint32_t command, const char *market,
+                   int interval) {
+  struct push_key key;
+  ERR_RET(get_key(&key, command, market, interval));
+
+  dict_entry *entry = dict_find(dict_push, &key);
+  if (entry == NULL) {
+    struct push_val val;
+    memset(&val, 0, sizeof(val));
+
+    dict_types dt;
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = dict_ses_hash_func;
+    dt.key_compare = dict_ses_key_compare;
+    val.sessions = dict_create(&dt, 16);
+    if (val.sessions == NULL)
+      return -__LINE__;
+
+    entry = dict_add(dict_push, &key, &val);
+    if (entry == NULL) {
+      dict_release(val.sessions);
+      return -__LINE__;
+    }
+  }
+
+  // 订阅方先收到当前结果，新建的订阅在下次定时器中计算
+  struct push_val *val = entry->val;
+  dict_add(val->sessions, ses, NULL);
+  if (val->last) {
+    char *body = get_push_body(&key, val->last);
+    if (body) {
+      send_push(ses, &key, body);
+      free(body);
+    }
+  }
+
+  return 0;
+}
+
+int push_unsubscribe(nw_ses *ses, uint32_t command, const char *market,
+                     int interval) {
+  struct push_key key;
+  ERR_RET(get_key(&key, command, market, interval));
+
+  dict_entry *entry = dict_find(dict_push, &key);
+  if (entry == NULL)
+    return 0;
+  struct push_val *val = entry->val;
+  dict_delete(val->sessions, ses);
+  if (dict_size(val->sessions) == 0)
+    dict_delete(dict_push, &key);
+
+  return 0;
+}
+
+int push_unsubscribe_all(nw_ses *ses) {
+  dict_iterator *iter = dict_get_iterator(dict_push);
+  dict_entry *entry;
+  while ((entry = dict_next(iter)) != NULL) {
+    struct push_val *val = entry->val;
+    dict_delete(val->sessions, ses);
+    if (dict_size(val->sessions) == 0)
+      dict_delete(dict_push, entry->key);
+  }
+  dict_release_iterator(iter);
+
+  return 0;
+}
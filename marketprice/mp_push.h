@@ -0,0 +1,22 @@
+/*
+ * Description: 订阅推送，成交或周期变化时把变化的kline、最新价和市场状态推送给订阅方
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+#ifndef _MP_PUSH_H_
+#define _MP_PUSH_H_
+
+#include "mp_config.h"
+
+int init_push(void);
+
+// command为CMD_MARKET_KLINE、CMD_MARKET_LAST、CMD_MARKET_STATUS或
+// CMD_MARKET_STATUS_TODAY，interval为kline的周期或status的period，其他为0
+int push_subscribe(nw_ses *ses, uint32_t command, const char *market,
+                   int interval);
+int push_unsubscribe(nw_ses *ses, uint32_t command, const char *market,
+                     int interval);
+// 连接关闭时取消该连接的全部订阅
+int push_unsubscribe_all(nw_ses *ses);
+
+#endif
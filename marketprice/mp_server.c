@@ -6,6 +6,7 @@
 #include "mp_server.h"
 #include "mp_config.h"
 #include "mp_message.h"
+#include "mp_push.h"
 
 static rpc_svr *svr;
 static dict_t *dict_cache;
@@ -163,47 +164,14 @@ static int on_cmd_market_kline(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
     return reply_error_invalid_argument(ses, pkg);
 
   int interval = json_integer_value(json_array_get(params, 3));
-  if (interval <= 0)
+  if (check_kline_interval(interval) < 0)
     return reply_error_invalid_argument(ses, pkg);
 
   sds cache_key = NULL;
   if (process_cache(ses, pkg, &cache_key))
     return 0;
 
-  json_t *result = NULL;
-  if (interval < 60) {
-    if (60 % interval != 0) {
-      sdsfree(cache_key);
-      return reply_error_invalid_argument(ses, pkg);
-    }
-    result = get_market_kline_sec(market, start, end, interval);
-  } else if (interval < 3600) {
-    if (interval % 60 != 0 || 3600 % interval != 0) {
-      sdsfree(cache_key);
-      return reply_error_invalid_argument(ses, pkg);
-    }
-    result = get_market_kline_min(market, start, end, interval);
-  } else if (interval < 86400) {
-    if (interval % 3600 != 0 || 86400 % interval != 0) {
-      sdsfree(cache_key);
-      return reply_error_invalid_argument(ses, pkg);
-    }
-    result = get_market_kline_hour(market, start, end, interval);
-  } else if (interval < 86400 * 7) {
-    if (interval % 86400 != 0) {
-      sdsfree(cache_key);
-      return reply_error_invalid_argument(ses, pkg);
-    }
-    result = get_market_kline_day(market, start, end, interval);
-  } else if (interval == 86400 * 7) {
-    result = get_market_kline_week(market, start, end, interval);
-  } else if (interval == 86400 * 30) {
-    result = get_market_kline_month(market, start, end, interval);
-  } else {
-    sdsfree(cache_key);
-    return reply_error_invalid_argument(ses, pkg);
-  }
-
+  json_t *result = get_market_kline(market, start, end, interval);
   if (result == NULL) {
     sdsfree(cache_key);
     return reply_error_internal_error(ses, pkg);
@@ -296,6 +264,85 @@ static int on_cmd_market_status_today(nw_ses *ses, rpc_pkg *pkg,
   return ret;
 }
 
+// 订阅参数: [command, market, interval]
+static int get_subscribe_params(json_t *params, uint32_t *command,
+                                const char **market, int *interval) {
+  if (json_array_size(params) != 3)
+    return -__LINE__;
+  if (!json_is_integer(json_array_get(params, 0)))
+    return -__LINE__;
+  *command = json_integer_value(json_array_get(params, 0));
+  *market = json_string_value(json_array_get(params, 1));
+  if (!*market)
+    return -__LINE__;
+  *interval = json_integer_value(json_array_get(params, 2));
+
+  switch (*command) {
+  case CMD_MARKET_KLINE:
+    if (check_kline_interval(*interval) < 0)
+      return -__LINE__;
+    break;
+  case CMD_MARKET_STATUS:
+    if (*interval <= 0 || *interval > settings.sec_max)
+      return -__LINE__;
+    break;
+  case CMD_MARKET_LAST:
+  case CMD_MARKET_STATUS_TODAY:
+    *interval = 0;
+    break;
+  default:
+    return -__LINE__;
+  }
+
+  return 0;
+}
+
+static int on_cmd_market_subscribe(nw_ses *ses, rpc_pkg *pkg,
+                                   json_t *params) {
+  // 推送需要连接，udp请求不能订阅
+  if (ses->sock_type == SOCK_DGRAM)
+    return reply_error_invalid_argument(ses, pkg);
+
+  uint32_t command;
+  const char *market;
+  int interval;
+  if (get_subscribe_params(params, &command, &market, &interval) < 0)
+    return reply_error_invalid_argument(ses, pkg);
+  if (!market_exist(market))
+    return reply_error_invalid_argument(ses, pkg);
+
+  int ret = push_subscribe(ses, command, market, interval);
+  if (ret < 0) {
+    log_error("push_subscribe fail: %d", ret);
+    return reply_error_internal_error(ses, pkg);
+  }
+
+  json_t *result = json_string("success");
+  ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
+static int on_cmd_market_unsubscribe(nw_ses *ses, rpc_pkg *pkg,
+                                     json_t *params) {
+  uint32_t command;
+  const char *market;
+  int interval;
+  if (get_subscribe_params(params, &command, &market, &interval) < 0)
+    return reply_error_invalid_argument(ses, pkg);
+
+  int ret = push_unsubscribe(ses, command, market, interval);
+  if (ret < 0) {
+    log_error("push_unsubscribe fail: %d", ret);
+    return reply_error_internal_error(ses, pkg);
+  }
+
+  json_t *result = json_string("success");
+  ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
 static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
   json_t *params = json_loadb(pkg->body, pkg->body_size, 0, NULL);
   if (params == NULL || !json_is_array(params)) {
@@ -345,6 +392,22 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
       log_error("on_cmd_market_status_today %s fail: %d", params_str, ret);
     }
     break;
+  case CMD_MARKET_SUBSCRIBE:
+    log_debug("from: %s cmd market subscribe, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_market_subscribe(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_market_subscribe %s fail: %d", params_str, ret);
+    }
+    break;
+  case CMD_MARKET_UNSUBSCRIBE:
+    log_debug("from: %s cmd market unsubscribe, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_market_unsubscribe(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_market_unsubscribe %s fail: %d", params_str, ret);
+    }
+    break;
   default:
     log_error("from: %s unknown command: %u",
               nw_sock_human_addr(&ses->peer_addr), pkg->command);
@@ -374,6 +437,7 @@ static void svr_on_new_connection(nw_ses *ses) {
 
 static void svr_on_connection_close(nw_ses *ses) {
   log_trace("connection: %s close", nw_sock_human_addr(&ses->peer_addr));
+  push_unsubscribe_all(ses);
 }
 
 static uint32_t cache_dict_hash_function(const void *key) {
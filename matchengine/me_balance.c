@@ -7,14 +7,20 @@
 #include "me_balance.h"
 
 //账户字典
-dict_t *dict_balance;
+hashmap_t *dict_balance;
 //资产字典
 static dict_t *dict_asset;
+//空闲时推进账户字典的渐进式扩容
+static nw_timer rehash_timer;
 //资产类型
 struct asset_type
 {
+    int id;        //资产id，即配置中的下标
     int prec_save; //存储精度
     int prec_show; //显示精度
+    //全部账户的余额合计及非零余额的账户数，按type-1存放可用和冻结，随余额变动增量维护
+    mpd_t *total[2];
+    size_t count[2];
 };
 //资产字典转hash
 static uint32_t asset_dict_hash_function(const void *key)
@@ -51,39 +57,46 @@ static void asset_dict_val_free(void *val)
     free(val);
 }
 
-//将账户字典转hash
+//账户字典以用户id为key
 static uint32_t balance_dict_hash_function(const void *key)
 {
-    return dict_generic_hash_function(key, sizeof(struct balance_key));
+    return *(const uint32_t *)key;
 }
-//获取账户字典的key
-static void *balance_dict_key_dup(const void *key)
+//每个账户记录的大小，按配置的资产数确定
+static size_t account_size;
+//创建账户记录，所有余额初始为0
+static balance_account *account_create(uint32_t user_id)
 {
-    struct balance_key *obj = malloc(sizeof(struct balance_key));
-    if (obj == NULL)
+    balance_account *account = malloc(account_size);
+    if (account == NULL)
         return NULL;
-    memcpy(obj, key, sizeof(struct balance_key));
-    return obj;
-}
-//获取账户字典的value
-static void *balance_dict_val_dup(const void *val)
-{
-    return mpd_qncopy(val);
-}
-//比较账户字典的key
-static int balance_dict_key_compare(const void *key1, const void *key2)
-{
-    return memcmp(key1, key2, sizeof(struct balance_key));
+    account->user_id = user_id;
+    for (size_t i = 0; i < settings.asset_num * 2; ++i)
+    {
+        balance_value *bv = &account->balances[i];
+        bv->data[0] = 0;
+        bv->value.flags = MPD_STATIC | MPD_STATIC_DATA;
+        bv->value.exp = 0;
+        bv->value.digits = 1;
+        bv->value.len = 1;
+        bv->value.alloc = BALANCE_DATA_WORDS;
+        bv->value.data = bv->data;
+    }
+    return account;
 }
-//释放资产字典的key
-static void balance_dict_key_free(void *key)
+//释放账户记录，余额超出内嵌空间时数据在堆上，由mpd_del释放
+static void account_free(balance_account *account)
 {
-    free(key);
+    for (size_t i = 0; i < settings.asset_num * 2; ++i)
+    {
+        mpd_del(&account->balances[i].value);
+    }
+    free(account);
 }
-//释放资产字典的val
+//释放账户字典的val，表中存放的是账户记录指针
 static void balance_dict_val_free(void *val)
 {
-    mpd_del(val);
+    account_free(*(balance_account **)val);
 }
 //字典初始化
 static int init_dict(void)
@@ -101,31 +114,46 @@ static int init_dict(void)
     if (dict_asset == NULL)
         return -__LINE__;
 
-    memset(&type, 0, sizeof(type));
-    type.hash_function = balance_dict_hash_function;
-    type.key_compare = balance_dict_key_compare;
-    type.key_dup = balance_dict_key_dup;
-    type.key_destructor = balance_dict_key_free;
-    type.val_dup = balance_dict_val_dup;
-    type.val_destructor = balance_dict_val_free;
-
-    dict_balance = dict_create(&type, 64); //账户字典,全局变量
+    hashmap_types ht;
+    memset(&ht, 0, sizeof(ht));
+    ht.hash_function = balance_dict_hash_function;
+    ht.val_destructor = balance_dict_val_free;
+
+    dict_balance = hashmap_create(&ht, sizeof(uint32_t), sizeof(balance_account *), 64); //账户字典,全局变量
     if (dict_balance == NULL)
         return -__LINE__;
 
     return 0;
 }
 
+//每次迁移的桶数，限制单次定时器的耗时
+#define BALANCE_REHASH_STEP 10000
+
+static void on_rehash_timer(nw_timer *t, void *privdata)
+{
+    hashmap_rehash(dict_balance, BALANCE_REHASH_STEP);
+}
+
 //账户初始化
 int init_balance()
 {
     ERR_RET(init_dict()); //资产字典和账户字典初始化
+    account_size = sizeof(balance_account) + sizeof(balance_value) * settings.asset_num * 2;
+
+    nw_timer_set(&rehash_timer, 0.01, true, on_rehash_timer, NULL);
+    nw_timer_start(&rehash_timer);
 
     for (size_t i = 0; i < settings.asset_num; ++i)
     {
         struct asset_type type;
+        type.id = i;
         type.prec_save = settings.assets[i].prec_save;
         type.prec_show = settings.assets[i].prec_show;
+        for (int j = 0; j < 2; ++j)
+        {
+            type.total[j] = mpd_qncopy(mpd_zero);
+            type.count[j] = 0;
+        }
         if (dict_add(dict_asset, settings.assets[i].name, &type) == NULL)
             return -__LINE__;
     } //向资产字典中添加配置的资产类型
@@ -160,30 +188,85 @@ int asset_prec_show(const char *asset)
     struct asset_type *at = get_asset_type(asset);
     return at ? at->prec_show : -1;
 }
-//获取账户字典中的余额（输入用户id,账户类型type,资产名称asset）
-mpd_t *balance_get(uint32_t user_id, uint32_t type, const char *asset)
+//查找用户的账户记录，create为true时不存在则创建
+static balance_account *get_account(uint32_t user_id, bool create)
 {
-    struct balance_key key; //账户字典的key是包括三个user_id,tyoe,asset的一个结构体
-    key.user_id = user_id;
-    key.type = type;
-    strncpy(key.asset, asset, sizeof(key.asset));
+    balance_account **val = hashmap_find(dict_balance, &user_id);
+    if (val)
+        return *val;
+    if (!create)
+        return NULL;
 
-    dict_entry *entry = dict_find(dict_balance, &key); //查找该用户的该账户下该资产的余额
-    if (entry)
+    balance_account *account = account_create(user_id);
+    if (account == NULL)
+        return NULL;
+    if (hashmap_add(dict_balance, &user_id, &account) == NULL)
     {
-        return entry->val; //返回余额
+        account_free(account);
+        return NULL;
     }
+    return account;
+}
+//账户记录中某资产某类型的余额
+static mpd_t *account_value(balance_account *account, struct asset_type *at, uint32_t type)
+{
+    if (type != BALANCE_TYPE_AVAILABLE && type != BALANCE_TYPE_FREEZE)
+        return NULL;
+    return &account->balances[at->id * 2 + type - 1].value;
+}
+//余额修改前将旧值移出资产总计
+static void summary_remove(struct asset_type *at, uint32_t type, mpd_t *value)
+{
+    if (mpd_iszero(value))
+        return;
+    at->count[type - 1] -= 1;
+    mpd_sub(at->total[type - 1], at->total[type - 1], value, &mpd_ctx);
+}
+//余额修改后将新值计入资产总计
+static void summary_add(struct asset_type *at, uint32_t type, mpd_t *value)
+{
+    if (mpd_iszero(value))
+        return;
+    at->count[type - 1] += 1;
+    mpd_add(at->total[type - 1], at->total[type - 1], value, &mpd_ctx);
+}
+//账户记录中的余额，为0时返回NULL
+mpd_t *balance_account_get(balance_account *account, size_t asset_id, uint32_t type)
+{
+    if (type != BALANCE_TYPE_AVAILABLE && type != BALANCE_TYPE_FREEZE)
+        return NULL;
+    mpd_t *result = &account->balances[asset_id * 2 + type - 1].value;
+    if (mpd_iszero(result))
+        return NULL;
+    return result;
+}
+//获取账户字典中的余额（输入用户id,账户类型type,资产名称asset），余额为0时返回NULL
+mpd_t *balance_get(uint32_t user_id, uint32_t type, const char *asset)
+{
+    struct asset_type *at = get_asset_type(asset);
+    if (at == NULL)
+        return NULL;
+    balance_account *account = get_account(user_id, false);
+    if (account == NULL)
+        return NULL;
 
-    return NULL;
+    return balance_account_get(account, at->id, type);
 }
-//删除账户字典中的记录
+//清零账户字典中的余额，账户记录本身保留
 void balance_del(uint32_t user_id, uint32_t type, const char *asset)
 {
-    struct balance_key key; //声明要删除的账户字典key
-    key.user_id = user_id;
-    key.type = type;
-    strncpy(key.asset, asset, sizeof(key.asset));
-    dict_delete(dict_balance, &key);
+    struct asset_type *at = get_asset_type(asset);
+    if (at == NULL)
+        return;
+    balance_account *account = get_account(user_id, false);
+    if (account == NULL)
+        return;
+    mpd_t *result = account_value(account, at, type);
+    if (result)
+    {
+        summary_remove(at, type, result);
+        mpd_copy(result, mpd_zero, &mpd_ctx);
+    }
 }
 //设置账户字典中的余额
 mpd_t *balance_set(uint32_t user_id, uint32_t type, const char *asset, mpd_t *amount)
@@ -200,29 +283,18 @@ mpd_t *balance_set(uint32_t user_id, uint32_t type, const char *asset, mpd_t *am
     else if (ret == 0)
     {
         balance_del(user_id, type, asset);
-        return mpd_zero; //如果为0，删除账户字典中的该记录
+        return mpd_zero; //如果为0，清零该余额
     }
 
-    struct balance_key key; //声明要设置的账户字典key
-    key.user_id = user_id;
-    key.type = type;
-    strncpy(key.asset, asset, sizeof(key.asset));
-
-    mpd_t *result; //mpd是高精度的计算数学库，mpd_t高精度数值类型
-    dict_entry *entry;
-    entry = dict_find(dict_balance, &key); //查找账户字典中的该记录
-    if (entry)                             //如果有记录
-    {
-        result = entry->val;
-        mpd_rescale(result, amount, -at->prec_save, &mpd_ctx); //将result设置为amount,精度是该资产的存储精度
-        return result;                                         //设置完成返回
-    }
-
-    entry = dict_add(dict_balance, &key, amount); //如果没有记录，就添加记录
-    if (entry == NULL)
+    balance_account *account = get_account(user_id, true); //没有账户记录则创建
+    if (account == NULL)
+        return NULL;
+    mpd_t *result = account_value(account, at, type); //mpd是高精度的计算数学库，mpd_t高精度数值类型
+    if (result == NULL)
         return NULL;
-    result = entry->val;
+    summary_remove(at, type, result);
     mpd_rescale(result, amount, -at->prec_save, &mpd_ctx); //将result设置为amount,精度是该资产的存储精度
+    summary_add(at, type, result);
 
     return result;
 }
@@ -237,22 +309,20 @@ mpd_t *balance_add(uint32_t user_id, uint32_t type, const char *asset, mpd_t *am
     if (mpd_cmp(amount, mpd_zero, &mpd_ctx) < 0)
         return NULL;
 
-    struct balance_key key;
-    key.user_id = user_id;
-    key.type = type;
-    strncpy(key.asset, asset, sizeof(key.asset));
-
-    mpd_t *result;
-    dict_entry *entry = dict_find(dict_balance, &key); //查找账户字典中的该记录
-    if (entry)                                         //如果有记录，则更新余额
-    {
-        result = entry->val;
-        mpd_add(result, result, amount, &mpd_ctx); //精确加法
-        mpd_rescale(result, result, -at->prec_save, &mpd_ctx);
-        return result;
-    }
+    balance_account *account = get_account(user_id, true);
+    if (account == NULL)
+        return NULL;
+    mpd_t *result = account_value(account, at, type);
+    if (result == NULL)
+        return NULL;
+    summary_remove(at, type, result);
+    mpd_add(result, result, amount, &mpd_ctx); //精确加法
+    mpd_rescale(result, result, -at->prec_save, &mpd_ctx);
+    summary_add(at, type, result);
+    if (mpd_iszero(result))
+        return mpd_zero;
 
-    return balance_set(user_id, type, asset, amount); //如果没有记录，则直接设置余额
+    return result;
 }
 
 //从账户字典中的减少余额
@@ -271,17 +341,18 @@ mpd_t *balance_sub(uint32_t user_id, uint32_t type, const char *asset, mpd_t *am
     if (mpd_cmp(result, amount, &mpd_ctx) < 0)
         return NULL;
 
+    summary_remove(at, type, result);
     mpd_sub(result, result, amount, &mpd_ctx);
-    if (mpd_cmp(result, mpd_zero, &mpd_ctx) == 0)
+    mpd_rescale(result, result, -at->prec_save, &mpd_ctx);
+    summary_add(at, type, result);
+    if (mpd_iszero(result))
     {
-        balance_del(user_id, type, asset);
         return mpd_zero;
     }
-    mpd_rescale(result, result, -at->prec_save, &mpd_ctx);
 
     return result;
 }
-//冻结账户字典中的一定数量的余额
+//冻结账户字典中的一定数量的余额，可用和冻结余额在同一账户记录中，只需查找一次
 mpd_t *balance_freeze(uint32_t user_id, const char *asset, mpd_t *amount)
 {
     struct asset_type *at = get_asset_type(asset);
@@ -290,21 +361,28 @@ mpd_t *balance_freeze(uint32_t user_id, const char *asset, mpd_t *amount)
 
     if (mpd_cmp(amount, mpd_zero, &mpd_ctx) < 0)
         return NULL; //如果余额为0，直接返回
-    mpd_t *available = balance_get(user_id, BALANCE_TYPE_AVAILABLE, asset);
-    if (available == NULL)
+    balance_account *account = get_account(user_id, false);
+    if (account == NULL)
+        return NULL;
+    mpd_t *available = account_value(account, at, BALANCE_TYPE_AVAILABLE);
+    mpd_t *freeze = account_value(account, at, BALANCE_TYPE_FREEZE);
+    if (mpd_iszero(available))
         return NULL; //如果可用余额为空，直接返回
     if (mpd_cmp(available, amount, &mpd_ctx) < 0)
         return NULL; //如果可用余额小于要冻结的数量，直接返回
 
-    if (balance_add(user_id, BALANCE_TYPE_FREEZE, asset, amount) == 0)
-        return NULL;                                 //如果非冻结的余额加上要冻结的数量等于0
+    summary_remove(at, BALANCE_TYPE_AVAILABLE, available);
+    summary_remove(at, BALANCE_TYPE_FREEZE, freeze);
+    mpd_add(freeze, freeze, amount, &mpd_ctx); //冻结余额加上要冻结的数量
+    mpd_rescale(freeze, freeze, -at->prec_save, &mpd_ctx);
     mpd_sub(available, available, amount, &mpd_ctx); //可用余额减去要冻结的数量
-    if (mpd_cmp(available, mpd_zero, &mpd_ctx) == 0) //如果可用余额为0，则删除该可用账户
+    mpd_rescale(available, available, -at->prec_save, &mpd_ctx);
+    summary_add(at, BALANCE_TYPE_AVAILABLE, available);
+    summary_add(at, BALANCE_TYPE_FREEZE, freeze);
+    if (mpd_iszero(available))
     {
-        balance_del(user_id, BALANCE_TYPE_AVAILABLE, asset);
         return mpd_zero;
     }
-    mpd_rescale(available, available, -at->prec_save, &mpd_ctx);
 
     return available;
 }
@@ -317,21 +395,28 @@ mpd_t *balance_unfreeze(uint32_t user_id, const char *asset, mpd_t *amount)
 
     if (mpd_cmp(amount, mpd_zero, &mpd_ctx) < 0)
         return NULL;
-    mpd_t *freeze = balance_get(user_id, BALANCE_TYPE_FREEZE, asset);
-    if (freeze == NULL)
+    balance_account *account = get_account(user_id, false);
+    if (account == NULL)
+        return NULL;
+    mpd_t *available = account_value(account, at, BALANCE_TYPE_AVAILABLE);
+    mpd_t *freeze = account_value(account, at, BALANCE_TYPE_FREEZE);
+    if (mpd_iszero(freeze))
         return NULL;
     if (mpd_cmp(freeze, amount, &mpd_ctx) < 0)
         return NULL;
 
-    if (balance_add(user_id, BALANCE_TYPE_AVAILABLE, asset, amount) == 0)
-        return NULL;
+    summary_remove(at, BALANCE_TYPE_AVAILABLE, available);
+    summary_remove(at, BALANCE_TYPE_FREEZE, freeze);
+    mpd_add(available, available, amount, &mpd_ctx);
+    mpd_rescale(available, available, -at->prec_save, &mpd_ctx);
     mpd_sub(freeze, freeze, amount, &mpd_ctx);
-    if (mpd_cmp(freeze, mpd_zero, &mpd_ctx) == 0)
+    mpd_rescale(freeze, freeze, -at->prec_save, &mpd_ctx);
+    summary_add(at, BALANCE_TYPE_AVAILABLE, available);
+    summary_add(at, BALANCE_TYPE_FREEZE, freeze);
+    if (mpd_iszero(freeze))
     {
-        balance_del(user_id, BALANCE_TYPE_FREEZE, asset);
         return mpd_zero;
     }
-    mpd_rescale(freeze, freeze, -at->prec_save, &mpd_ctx);
 
     return freeze;
 }
@@ -340,48 +425,36 @@ mpd_t *balance_total(uint32_t user_id, const char *asset)
 {
     mpd_t *balance = mpd_new(&mpd_ctx);
     mpd_copy(balance, mpd_zero, &mpd_ctx);
-    mpd_t *available = balance_get(user_id, BALANCE_TYPE_AVAILABLE, asset);
-    if (available)
-    {
-        mpd_add(balance, balance, available, &mpd_ctx);
-    }
-    mpd_t *freeze = balance_get(user_id, BALANCE_TYPE_FREEZE, asset);
-    if (freeze)
+    struct asset_type *at = get_asset_type(asset);
+    if (at == NULL)
+        return balance;
+    balance_account *account = get_account(user_id, false);
+    if (account)
     {
-        mpd_add(balance, balance, freeze, &mpd_ctx);
+        mpd_add(balance, account_value(account, at, BALANCE_TYPE_AVAILABLE), account_value(account, at, BALANCE_TYPE_FREEZE), &mpd_ctx);
     }
 
     return balance;
 }
-//获取账户字典中所有账户的状态
+//获取资产在所有账户中的总计，直接读取增量维护的计数
 int balance_status(const char *asset, mpd_t *total, size_t *available_count, mpd_t *available, size_t *freeze_count, mpd_t *freeze)
 {
-    *freeze_count = 0;
-    *available_count = 0;
-    mpd_copy(total, mpd_zero, &mpd_ctx);
-    mpd_copy(freeze, mpd_zero, &mpd_ctx);
-    mpd_copy(available, mpd_zero, &mpd_ctx);
-
-    dict_entry *entry;
-    dict_iterator *iter = dict_get_iterator(dict_balance);
-    while ((entry = dict_next(iter)) != NULL)
+    struct asset_type *at = get_asset_type(asset);
+    if (at == NULL)
     {
-        struct balance_key *key = entry->key;
-        if (strcmp(key->asset, asset) != 0)
-            continue;
-        mpd_add(total, total, entry->val, &mpd_ctx);
-        if (key->type == BALANCE_TYPE_AVAILABLE)
-        {
-            *available_count += 1;
-            mpd_add(available, available, entry->val, &mpd_ctx);
-        }
-        else
-        {
-            *freeze_count += 1;
-            mpd_add(freeze, freeze, entry->val, &mpd_ctx);
-        }
+        *freeze_count = 0;
+        *available_count = 0;
+        mpd_copy(total, mpd_zero, &mpd_ctx);
+        mpd_copy(freeze, mpd_zero, &mpd_ctx);
+        mpd_copy(available, mpd_zero, &mpd_ctx);
+        return 0;
     }
-    dict_release_iterator(iter);
+
+    *available_count = at->count[BALANCE_TYPE_AVAILABLE - 1];
+    *freeze_count = at->count[BALANCE_TYPE_FREEZE - 1];
+    mpd_copy(available, at->total[BALANCE_TYPE_AVAILABLE - 1], &mpd_ctx);
+    mpd_copy(freeze, at->total[BALANCE_TYPE_FREEZE - 1], &mpd_ctx);
+    mpd_add(total, available, freeze, &mpd_ctx);
 
     return 0;
 }
@@ -11,13 +11,23 @@
 # define BALANCE_TYPE_AVAILABLE 1
 # define BALANCE_TYPE_FREEZE    2
 
-extern dict_t *dict_balance;
+/* 余额内嵌的系数字数，超出时libmpdec自动改用堆内存 */
+# define BALANCE_DATA_WORDS     2
 
-struct balance_key {
-    uint32_t    user_id;
-    uint32_t    type;
-    char        asset[ASSET_NAME_MAX_LEN + 1];
-};
+typedef struct balance_value {
+    mpd_t       value;
+    mpd_uint_t  data[BALANCE_DATA_WORDS];
+} balance_value;
+
+/* 每个用户一条记录，按资产id（配置中的下标）存放可用和冻结余额，
+ * balances[asset_id * 2 + type - 1] */
+typedef struct balance_account {
+    uint32_t        user_id;
+    balance_value   balances[];
+} balance_account;
+
+/* key为user_id，value为balance_account指针 */
+extern hashmap_t *dict_balance;
 
 int init_balance(void);
 
@@ -25,6 +35,7 @@ bool asset_exist(const char *asset);
 int asset_prec(const char *asset);
 int asset_prec_show(const char *asset);
 
+mpd_t *balance_account_get(balance_account *account, size_t asset_id, uint32_t type);
 mpd_t *balance_get(uint32_t user_id, uint32_t type, const char *asset);
 void   balance_del(uint32_t user_id, uint32_t type, const char *asset);
 mpd_t *balance_set(uint32_t user_id, uint32_t type, const char *asset, mpd_t *amount);
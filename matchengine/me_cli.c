@@ -36,24 +36,30 @@ static sds on_cmd_balance_list(const char *cmd, int argc, sds *argv) {
   reply = sdscatprintf(reply, "%-10s %-16s %-10s %s\n", "user", "asset", "type",
                        "amount");
 
-  dict_iterator *iter = dict_get_iterator(dict_balance);
-  dict_entry *entry;
-  while ((entry = dict_next(iter)) != NULL) {
-    struct balance_key *key = entry->key;
-    if (asset && strcmp(key->asset, asset) != 0)
-      continue;
-    mpd_t *val = entry->val;
-    char *str = mpd_to_sci(val, 0);
-    if (key->type == BALANCE_TYPE_AVAILABLE) {
-      reply = sdscatprintf(reply, "%-10u %-16s %-10s %s\n", key->user_id,
-                           key->asset, "available", str);
-    } else {
-      reply = sdscatprintf(reply, "%-10u %-16s %-10s %s\n", key->user_id,
-                           key->asset, "freeze", str);
+  hashmap_iterator *iter = hashmap_get_iterator(dict_balance);
+  void *val;
+  while (hashmap_next(iter, &val) != NULL) {
+    balance_account *account = *(balance_account **)val;
+    for (size_t i = 0; i < settings.asset_num * 2; ++i) {
+      const char *name = settings.assets[i / 2].name;
+      uint32_t type = i % 2 + 1;
+      if (asset && strcmp(name, asset) != 0)
+        continue;
+      mpd_t *balance = balance_account_get(account, i / 2, type);
+      if (balance == NULL)
+        continue;
+      char *str = mpd_to_sci(balance, 0);
+      if (type == BALANCE_TYPE_AVAILABLE) {
+        reply = sdscatprintf(reply, "%-10u %-16s %-10s %s\n", account->user_id,
+                             name, "available", str);
+      } else {
+        reply = sdscatprintf(reply, "%-10u %-16s %-10s %s\n", account->user_id,
+                             name, "freeze", str);
+      }
+      free(str);
     }
-    free(str);
   }
-  dict_release_iterator(iter);
+  hashmap_release_iterator(iter);
 
   return reply;
 }
@@ -52,6 +52,7 @@ static int load_markets(json_t *root, const char *key)
         ERR_RET_LN(read_cfg_str(row, "name", &settings.markets[i].name, NULL));
         ERR_RET_LN(read_cfg_int(row, "fee_prec", &settings.markets[i].fee_prec, false, 4));
         ERR_RET_LN(read_cfg_mpd(row, "min_amount", &settings.markets[i].min_amount, "0.01"));
+        ERR_RET_LN(read_cfg_bool(row, "fixed_point", &settings.markets[i].fixed_point, false, false));
 
         json_t *stock = json_object_get(row, "stock");
         if (!stock || !json_is_object(stock))
@@ -151,6 +152,8 @@ static int read_config_from_json(json_t *root)
         printf("load slice_keeptime fail: %d", ret);
         return -__LINE__;
     }
+    ERR_RET_LN(read_cfg_str(root, "slice_path", &settings.slice_path, "")); //二进制切片文件目录，为空则只保存到数据库
+    ERR_RET_LN(read_cfg_bool(root, "slice_to_db", &settings.slice_to_db, false, true)); //是否同时导出切片到数据库
     ret = read_cfg_int(root, "history_thread", &settings.history_thread, false, 10); //历史记录的进程数量
     if (ret < 0)
     {
@@ -160,6 +163,10 @@ static int read_config_from_json(json_t *root)
 
     ERR_RET_LN(read_cfg_real(root, "cache_timeout", &settings.cache_timeout, false, 0.45)); //缓存时间
 
+    ERR_RET_LN(read_cfg_str(root, "operlog_path", &settings.operlog_path, "")); //本地操作日志目录，为空则不写本地文件
+    ERR_RET_LN(read_cfg_real(root, "operlog_flush_interval", &settings.operlog_flush_interval, false, 0.01)); //本地操作日志的组提交周期
+    ERR_RET_LN(read_cfg_bool(root, "operlog_fsync", &settings.operlog_fsync, false, true)); //每次组提交是否落盘
+
     return 0;
 }
 
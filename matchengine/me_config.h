@@ -27,6 +27,7 @@
 #include "ut_config.h"
 #include "ut_decimal.h"
 #include "ut_define.h"
+#include "ut_hashmap.h"
 #include "ut_list.h"
 #include "ut_misc.h"
 #include "ut_mysql.h"
@@ -43,6 +44,7 @@
 
 #define ORDER_BOOK_MAX_LEN 101
 #define ORDER_LIST_MAX_LEN 101
+#define ORDER_BATCH_MAX_LEN 1000
 
 #define MAX_PENDING_OPERLOG 100
 #define MAX_PENDING_HISTORY 1000
@@ -62,6 +64,7 @@ struct market {
   int stock_prec;
   int money_prec;
   mpd_t *min_amount;
+  bool fixed_point;
 };
 
 struct settings {
@@ -83,8 +86,14 @@ struct settings {
   char *brokers;
   int slice_interval;
   int slice_keeptime;
+  char *slice_path;
+  bool slice_to_db;
   int history_thread;
   double cache_timeout;
+
+  char *operlog_path;
+  double operlog_flush_interval;
+  bool operlog_fsync;
 };
 
 extern struct settings settings;
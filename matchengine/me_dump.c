@@ -12,6 +12,9 @@
 #include "me_trade.h"
 #include "me_market.h"
 #include "me_balance.h"
+#include "me_dump.h"
+#include "me_operlog.h"
+#include "ut_crc32.h"
 
 static sds sql_append_mpd(sds sql, mpd_t *val, bool comma)
 {
@@ -36,45 +39,48 @@ static int dump_orders_list(MYSQL *conn, const char *table, skiplist_t *list)
     skiplist_node *node;
     while ((node = skiplist_next(iter)) != NULL)
     {
-        order_t *order = node->value;
-        if (index == 0)
+        price_level_t *level = node->value;
+        for (order_t *order = level->head; order; order = order->next)
         {
-            sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `t`, `side`, `create_time`, `update_time`, `user_id`, `market`, "
-                                    "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee`) VALUES ",
-                               table);
-        }
-        else
-        {
-            sql = sdscatprintf(sql, ", ");
-        }
+            if (index == 0)
+            {
+                sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `t`, `side`, `create_time`, `update_time`, `user_id`, `market`, "
+                                        "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee`) VALUES ",
+                                   table);
+            }
+            else
+            {
+                sql = sdscatprintf(sql, ", ");
+            }
 
-        sql = sdscatprintf(sql, "(%" PRIu64 ", %u, %u, %f, %f, %u, '%s' , ",
-                           order->id, order->type, order->side, order->create_time, order->update_time, order->user_id, order->market);
-        sql = sql_append_mpd(sql, order->price, true);
-        sql = sql_append_mpd(sql, order->amount, true);
-        sql = sql_append_mpd(sql, order->taker_fee, true);
-        sql = sql_append_mpd(sql, order->maker_fee, true);
-        sql = sql_append_mpd(sql, order->left, true);
-        sql = sql_append_mpd(sql, order->freeze, true);
-        sql = sql_append_mpd(sql, order->deal_stock, true);
-        sql = sql_append_mpd(sql, order->deal_money, true);
-        sql = sql_append_mpd(sql, order->deal_fee, false);
-        sql = sdscatprintf(sql, ")");
-
-        index += 1;
-        if (index == insert_limit)
-        {
-            log_trace("exec sql: %s", sql);
-            int ret = mysql_real_query(conn, sql, sdslen(sql));
-            if (ret < 0)
+            sql = sdscatprintf(sql, "(%" PRIu64 ", %u, %u, %f, %f, %u, '%s' , ",
+                               order->id, order->type, order->side, order->create_time, order->update_time, order->user_id, order->market);
+            sql = sql_append_mpd(sql, order->price, true);
+            sql = sql_append_mpd(sql, order->amount, true);
+            sql = sql_append_mpd(sql, order->taker_fee, true);
+            sql = sql_append_mpd(sql, order->maker_fee, true);
+            sql = sql_append_mpd(sql, order->left, true);
+            sql = sql_append_mpd(sql, order->freeze, true);
+            sql = sql_append_mpd(sql, order->deal_stock, true);
+            sql = sql_append_mpd(sql, order->deal_money, true);
+            sql = sql_append_mpd(sql, order->deal_fee, false);
+            sql = sdscatprintf(sql, ")");
+
+            index += 1;
+            if (index == insert_limit)
             {
-                log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
-                skiplist_release_iterator(iter);
-                sdsfree(sql);
-                return -__LINE__;
+                log_trace("exec sql: %s", sql);
+                int ret = mysql_real_query(conn, sql, sdslen(sql));
+                if (ret < 0)
+                {
+                    log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+                    skiplist_release_iterator(iter);
+                    sdsfree(sql);
+                    return -__LINE__;
+                }
+                sdsclear(sql);
+                index = 0;
             }
-            sdsclear(sql);
-            index = 0;
         }
     }
     skiplist_release_iterator(iter);
@@ -146,48 +152,54 @@ int dump_orders(MYSQL *conn, const char *table)
     return 0;
 }
 
-static int dump_balance_dict(MYSQL *conn, const char *table, dict_t *dict)
+static int dump_balance_dict(MYSQL *conn, const char *table, hashmap_t *dict)
 {
     sds sql = sdsempty();
 
     size_t insert_limit = 1000;
     size_t index = 0;
-    dict_iterator *iter = dict_get_iterator(dict);
-    dict_entry *entry;
-    while ((entry = dict_next(iter)) != NULL)
+    hashmap_iterator *iter = hashmap_get_iterator(dict);
+    void *val;
+    while (hashmap_next(iter, &val) != NULL)
     {
-        struct balance_key *key = entry->key;
-        mpd_t *balance = entry->val;
-        if (index == 0)
+        balance_account *account = *(balance_account **)val;
+        for (size_t i = 0; i < settings.asset_num * 2; ++i)
         {
-            sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `user_id`, `asset`, `t`, `balance`) VALUES ", table);
-        }
-        else
-        {
-            sql = sdscatprintf(sql, ", ");
-        }
+            uint32_t type = i % 2 + 1;
+            mpd_t *balance = balance_account_get(account, i / 2, type);
+            if (balance == NULL)
+                continue;
+            if (index == 0)
+            {
+                sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `user_id`, `asset`, `t`, `balance`) VALUES ", table);
+            }
+            else
+            {
+                sql = sdscatprintf(sql, ", ");
+            }
 
-        sql = sdscatprintf(sql, "(NULL, %u, '%s', %u, ", key->user_id, key->asset, key->type);
-        sql = sql_append_mpd(sql, balance, false);
-        sql = sdscatprintf(sql, ")");
+            sql = sdscatprintf(sql, "(NULL, %u, '%s', %u, ", account->user_id, settings.assets[i / 2].name, type);
+            sql = sql_append_mpd(sql, balance, false);
+            sql = sdscatprintf(sql, ")");
 
-        index += 1;
-        if (index == insert_limit)
-        {
-            log_trace("exec sql: %s", sql);
-            int ret = mysql_real_query(conn, sql, sdslen(sql));
-            if (ret < 0)
+            index += 1;
+            if (index == insert_limit)
             {
-                log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
-                dict_release_iterator(iter);
-                sdsfree(sql);
-                return -__LINE__;
+                log_trace("exec sql: %s", sql);
+                int ret = mysql_real_query(conn, sql, sdslen(sql));
+                if (ret < 0)
+                {
+                    log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+                    hashmap_release_iterator(iter);
+                    sdsfree(sql);
+                    return -__LINE__;
+                }
+                sdsclear(sql);
+                index = 0;
             }
-            sdsclear(sql);
-            index = 0;
         }
     }
-    dict_release_iterator(iter);
+    hashmap_release_iterator(iter);
 
     if (index > 0)
     {
@@ -239,3 +251,172 @@ int dump_balance(MYSQL *conn, const char *table)
 
     return 0;
 }
+
+//已写入内容的crc，写完头部后清零，只覆盖头部之后的内容
+static uint32_t slice_crc;
+
+static int slice_write(FILE *fp, const void *data, size_t len)
+{
+    if (fwrite(data, 1, len, fp) != len)
+        return -__LINE__;
+    slice_crc = update_crc32c(slice_crc, data, len);
+    return 0;
+}
+
+static int slice_write_mpd(FILE *fp, mpd_t *val)
+{
+    if (mpd_isspecial(val) || val->len > UINT8_MAX || val->exp < INT32_MIN || val->exp > INT32_MAX)
+        return -__LINE__;
+
+    struct slice_decimal head;
+    memset(&head, 0, sizeof(head));
+    head.sign = mpd_isnegative(val) ? 1 : 0;
+    head.len = val->len;
+    head.exp = val->exp;
+    if (slice_write(fp, &head, sizeof(head)) < 0)
+        return -__LINE__;
+    if (slice_write(fp, val->data, sizeof(mpd_uint_t) * val->len) < 0)
+        return -__LINE__;
+    return 0;
+}
+
+static int slice_write_orders(FILE *fp, skiplist_t *list)
+{
+    skiplist_iter *iter = skiplist_get_iterator(list);
+    skiplist_node *node;
+    while ((node = skiplist_next(iter)) != NULL)
+    {
+        price_level_t *level = node->value;
+        for (order_t *order = level->head; order; order = order->next)
+        {
+            struct slice_order record;
+            memset(&record, 0, sizeof(record));
+            record.id = order->id;
+            record.create_time = order->create_time;
+            record.update_time = order->update_time;
+            record.type = order->type;
+            record.side = order->side;
+            record.user_id = order->user_id;
+            if (slice_write(fp, &record, sizeof(record)) < 0 ||
+                    slice_write_mpd(fp, order->price) < 0 ||
+                    slice_write_mpd(fp, order->amount) < 0 ||
+                    slice_write_mpd(fp, order->taker_fee) < 0 ||
+                    slice_write_mpd(fp, order->maker_fee) < 0 ||
+                    slice_write_mpd(fp, order->left) < 0 ||
+                    slice_write_mpd(fp, order->freeze) < 0 ||
+                    slice_write_mpd(fp, order->deal_stock) < 0 ||
+                    slice_write_mpd(fp, order->deal_money) < 0 ||
+                    slice_write_mpd(fp, order->deal_fee) < 0)
+            {
+                skiplist_release_iterator(iter);
+                return -__LINE__;
+            }
+        }
+    }
+    skiplist_release_iterator(iter);
+
+    return 0;
+}
+
+static int slice_write_body(FILE *fp, struct slice_file_head *head)
+{
+    for (int i = 0; i < settings.market_num; ++i)
+    {
+        market_t *market = get_market(settings.markets[i].name);
+        if (market == NULL)
+            return -__LINE__;
+
+        struct slice_market_head market_head;
+        memset(&market_head, 0, sizeof(market_head));
+        market_head.name_len = strlen(market->name);
+        market_head.order_count = market->ask_count + market->bid_count;
+        if (slice_write(fp, &market_head, sizeof(market_head)) < 0)
+            return -__LINE__;
+        if (slice_write(fp, market->name, market_head.name_len) < 0)
+            return -__LINE__;
+        if (slice_write_orders(fp, market->asks) < 0)
+            return -__LINE__;
+        if (slice_write_orders(fp, market->bids) < 0)
+            return -__LINE__;
+        head->market_count += 1;
+    }
+
+    hashmap_iterator *iter = hashmap_get_iterator(dict_balance);
+    void *val;
+    while (hashmap_next(iter, &val) != NULL)
+    {
+        balance_account *account = *(balance_account **)val;
+        for (size_t i = 0; i < settings.asset_num * 2; ++i)
+        {
+            mpd_t *balance = balance_account_get(account, i / 2, i % 2 + 1);
+            if (balance == NULL)
+                continue;
+            struct slice_balance record;
+            memset(&record, 0, sizeof(record));
+            record.user_id = account->user_id;
+            record.type = i % 2 + 1;
+            strncpy(record.asset, settings.assets[i / 2].name, sizeof(record.asset) - 1);
+            if (slice_write(fp, &record, sizeof(record)) < 0 || slice_write_mpd(fp, balance) < 0)
+            {
+                hashmap_release_iterator(iter);
+                return -__LINE__;
+            }
+            head->balance_count += 1;
+        }
+    }
+    hashmap_release_iterator(iter);
+
+    return 0;
+}
+
+//载出二进制切片文件，先写临时文件，落盘后再改名
+int dump_slice_file(const char *path, time_t timestamp)
+{
+    sds tmp = sdsempty();
+    tmp = sdscatprintf(tmp, "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (fp == NULL)
+    {
+        log_error("open file: %s fail: %d %s", tmp, errno, strerror(errno));
+        sdsfree(tmp);
+        return -__LINE__;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1024 * 1024);
+
+    struct slice_file_head head;
+    memset(&head, 0, sizeof(head));
+    head.magic = SLICE_FILE_MAGIC;
+    head.version = SLICE_FILE_VERSION;
+    head.time = timestamp;
+    head.oper_id = operlog_id_start;
+    head.order_id = order_id_start;
+    head.deals_id = deals_id_start;
+
+    int ret = slice_write(fp, &head, sizeof(head));
+    slice_crc = 0;
+    if (ret == 0)
+        ret = slice_write_body(fp, &head);
+    if (ret == 0)
+    {
+        // 回填头部的计数、文件长度和crc
+        head.size = ftell(fp);
+        head.crc = slice_crc;
+        if (fseek(fp, 0, SEEK_SET) != 0 || slice_write(fp, &head, sizeof(head)) < 0)
+            ret = -__LINE__;
+    }
+    if (ret == 0 && (fflush(fp) != 0 || fsync(fileno(fp)) != 0))
+        ret = -__LINE__;
+    if (fclose(fp) != 0 && ret == 0)
+        ret = -__LINE__;
+    if (ret == 0 && rename(tmp, path) != 0)
+        ret = -__LINE__;
+
+    if (ret < 0)
+    {
+        log_error("dump slice file: %s fail: %d %s", path, ret, strerror(errno));
+        unlink(tmp);
+    }
+    sdsfree(tmp);
+
+    return ret;
+}
@@ -7,10 +7,66 @@
 # define _ME_DUMP_H_
 
 # include "ut_mysql.h"
+# include "me_config.h"
+
+/*
+ * 二进制切片文件，按本机字节序顺序写入：
+ *   slice_file_head
+ *   market_count 个 { slice_market_head, name, order_count 个 { slice_order, 9 个 slice_decimal } }
+ *   balance_count 个 { slice_balance, slice_decimal }
+ * slice_decimal 后跟 len 个 mpd_uint_t 系数字，头部的crc覆盖头部之后的全部内容
+ */
+# define SLICE_FILE_MAGIC   0x4c53454d /* "MESL" */
+# define SLICE_FILE_VERSION 2
+
+struct slice_file_head {
+    uint32_t magic;
+    uint32_t version;
+    int64_t  time;
+    uint64_t oper_id;
+    uint64_t order_id;
+    uint64_t deals_id;
+    uint64_t market_count;
+    uint64_t balance_count;
+    uint64_t size;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+struct slice_market_head {
+    uint32_t name_len;
+    uint32_t reserved;
+    uint64_t order_count;
+};
+
+struct slice_order {
+    uint64_t id;
+    double   create_time;
+    double   update_time;
+    uint32_t type;
+    uint32_t side;
+    uint32_t user_id;
+    uint32_t reserved;
+};
+
+struct slice_balance {
+    uint32_t user_id;
+    uint32_t type;
+    char     asset[ASSET_NAME_MAX_LEN + 1];
+};
+
+struct slice_decimal {
+    uint8_t  sign;
+    uint8_t  len;
+    uint16_t reserved;
+    int32_t  exp;
+};
 
 int dump_orders(MYSQL *conn, const char *table);
 int dump_markets(MYSQL *conn, const char *table);
 int dump_balance(MYSQL *conn, const char *table);
 
+int dump_slice_file(const char *path, time_t timestamp);
+
 # endif
 
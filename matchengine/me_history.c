@@ -164,26 +164,111 @@ int fini_history(void)
     return 0;
 }
 
-//将高精度数值转成sql命令
-static sds sql_append_mpd(sds sql, mpd_t *val, bool comma)
+//每个分片sql缓冲区的初始大小
+#define HISTORY_SQL_INIT_SIZE (64 * 1024)
+//一行记录中除字符串字段外的最大长度
+#define HISTORY_ROW_MAX (1024 + 8 * MPD_FORMAT_MAX)
+
+//写入常量字符串片段
+#define put_const(p, s) put_str(p, s, sizeof(s) - 1)
+
+static char *put_str(char *p, const char *s, size_t len)
+{
+    memcpy(p, s, len);
+    return p + len;
+}
+
+//写入无符号整数
+static char *put_u64(char *p, uint64_t v)
+{
+    char tmp[24];
+    int n = 0;
+    do
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n > 0)
+        *p++ = tmp[--n];
+    return p;
+}
+
+//写入有符号整数
+static char *put_int(char *p, int64_t v)
+{
+    if (v < 0)
+    {
+        *p++ = '-';
+        return put_u64(p, -(uint64_t)v);
+    }
+    return put_u64(p, v);
+}
+
+//写入时间戳，与"%f"格式相同，保留6位小数，舍入方式与printf一致
+static char *put_time(char *p, double t)
+{
+    uint64_t sec = (uint64_t)t;
+    uint32_t frac = (uint32_t)rint((t - sec) * 1000000);
+    if (frac >= 1000000)
+    {
+        sec += 1;
+        frac -= 1000000;
+    }
+    p = put_u64(p, sec);
+    *p++ = '.';
+    for (int i = 5; i >= 0; --i)
+    {
+        p[i] = '0' + frac % 10;
+        frac /= 10;
+    }
+    return p + 6;
+}
+
+//当前行中有高精度数值无法完整写入，该行不提交
+static bool row_error;
+
+//写入高精度数值，过长时不截断，标记当前行出错
+static char *put_decimal(char *p, mpd_t *val, bool strip)
+{
+    size_t len = mpd_format(p, val, strip);
+    if (len == 0)
+        row_error = true;
+    return p + len;
+}
+
+//写入带引号的高精度数值
+static char *put_mpd(char *p, mpd_t *val, bool comma)
+{
+    *p++ = '\'';
+    p = put_decimal(p, val, false);
+    *p++ = '\'';
+    if (comma)
+    {
+        p = put_const(p, ", ");
+    }
+    return p;
+}
+
+//写入带引号的字符串
+static char *put_quote(char *p, const char *s, bool comma)
 {
-    char *str = mpd_to_sci(val, 0);
-    sql = sdscatprintf(sql, "'%s'", str);
+    *p++ = '\'';
+    p = put_str(p, s, strlen(s));
+    *p++ = '\'';
     if (comma)
     {
-        sql = sdscatprintf(sql, ", ");
+        p = put_const(p, ", ");
     }
-    free(str);
-    return sql;
+    return p;
 }
 
-//查询sql字典获取sql命令
-static sds get_sql(struct dict_sql_key *key)
+//查询sql字典获取分片的sql缓冲区，并预留len字节
+static dict_entry *get_sql(struct dict_sql_key *key, size_t len)
 {
     dict_entry *entry = dict_find(dict_sql, key);
     if (!entry)
     {
-        sds val = sdsempty();
+        sds val = sdsMakeRoomFor(sdsempty(), HISTORY_SQL_INIT_SIZE);
         entry = dict_add(dict_sql, key, val);
         if (entry == NULL)
         {
@@ -191,91 +276,94 @@ static sds get_sql(struct dict_sql_key *key)
             return NULL;
         }
     }
-    return entry->val;
-}
-
-//将sql命令存入sql字典
-static void set_sql(struct dict_sql_key *key, sds sql)
-{
-    dict_entry *entry = dict_find(dict_sql, key);
-    if (entry)
-    {
-        entry->val = sql;
-    }
+    entry->val = sdsMakeRoomFor(entry->val, len);
+    return entry;
 }
 
-//添加用户订单的命令存入sql字典
-static int append_user_order(order_t *order)
+//开始一行记录：首行写入表头，否则写入分隔符
+static char *put_row_begin(char *p, sds sql, const char *table, uint32_t hash, const char *columns)
 {
-    struct dict_sql_key key;
-    key.hash = order->user_id % HISTORY_HASH_NUM;
-    key.type = HISTORY_USER_ORDER;
-    sds sql = get_sql(&key);
-    if (sql == NULL)
-        return -__LINE__;
-
+    row_error = false;
     if (sdslen(sql) == 0)
     {
-        sql = sdscatprintf(sql, "INSERT INTO `order_history_%u` (`id`, `create_time`, `finish_time`, `user_id`, "
-                                "`market`, `source`, `t`, `side`, `price`, `amount`, `taker_fee`, `maker_fee`, `deal_stock`, `deal_money`, `deal_fee`) VALUES ",
-                           key.hash);
+        p = put_const(p, "INSERT INTO `");
+        p = put_str(p, table, strlen(table));
+        p = put_u64(p, hash);
+        p = put_const(p, "` ");
+        p = put_str(p, columns, strlen(columns));
+        p = put_const(p, " VALUES (");
     }
     else
     {
-        sql = sdscatprintf(sql, ", ");
+        p = put_const(p, ", (");
     }
+    return p;
+}
 
-    sql = sdscatprintf(sql, "(%" PRIu64 ", %f, %f, %u, '%s', '%s', %u, %u, ", order->id,
-                       order->create_time, order->update_time, order->user_id, order->market, order->source, order->type, order->side);
-    sql = sql_append_mpd(sql, order->price, true);
-    sql = sql_append_mpd(sql, order->amount, true);
-    sql = sql_append_mpd(sql, order->taker_fee, true);
-    sql = sql_append_mpd(sql, order->maker_fee, true);
-    sql = sql_append_mpd(sql, order->deal_stock, true);
-    sql = sql_append_mpd(sql, order->deal_money, true);
-    sql = sql_append_mpd(sql, order->deal_fee, false);
-    sql = sdscatprintf(sql, ")");
-
-    set_sql(&key, sql);
-
+//结束一行记录，更新sql长度，出错的行丢弃
+static int put_row_end(dict_entry *entry, char *p)
+{
+    sds sql = entry->val;
+    if (row_error)
+    {
+        log_error("drop history row with unformattable decimal: %.*s", (int)(p - (sql + sdslen(sql))), sql + sdslen(sql));
+        return -__LINE__;
+    }
+    *p++ = ')';
+    sdsIncrLen(sql, p - (sql + sdslen(sql)));
     return 0;
 }
 
-//添加订单详情的命令存入sql字典
-static int append_order_detail(order_t *order)
+static const char *order_columns = "(`id`, `create_time`, `finish_time`, `user_id`, "
+                                   "`market`, `source`, `t`, `side`, `price`, `amount`, `taker_fee`, `maker_fee`, `deal_stock`, `deal_money`, `deal_fee`)";
+
+//订单记录的一行
+static int append_order_row(uint32_t type, const char *table, uint32_t hash, order_t *order)
 {
     struct dict_sql_key key;
-    key.hash = order->id % HISTORY_HASH_NUM;
-    key.type = HISTORY_ORDER_DETAIL;
-    sds sql = get_sql(&key);
-    if (sql == NULL)
+    key.hash = hash;
+    key.type = type;
+    const char *source = order->source ? order->source : "";
+    dict_entry *entry = get_sql(&key, HISTORY_ROW_MAX + strlen(order->market) + strlen(source));
+    if (entry == NULL)
         return -__LINE__;
 
-    if (sdslen(sql) == 0)
-    {
-        sql = sdscatprintf(sql, "INSERT INTO `order_detail_%u` (`id`, `create_time`, `finish_time`, `user_id`, "
-                                "`market`, `source`, `t`, `side`, `price`, `amount`, `taker_fee`, `maker_fee`, `deal_stock`, `deal_money`, `deal_fee`) VALUES ",
-                           key.hash);
-    }
-    else
-    {
-        sql = sdscatprintf(sql, ", ");
-    }
-
-    sql = sdscatprintf(sql, "(%" PRIu64 ", %f, %f, %u, '%s', '%s', %u, %u, ", order->id,
-                       order->create_time, order->update_time, order->user_id, order->market, order->source, order->type, order->side);
-    sql = sql_append_mpd(sql, order->price, true);
-    sql = sql_append_mpd(sql, order->amount, true);
-    sql = sql_append_mpd(sql, order->taker_fee, true);
-    sql = sql_append_mpd(sql, order->maker_fee, true);
-    sql = sql_append_mpd(sql, order->deal_stock, true);
-    sql = sql_append_mpd(sql, order->deal_money, true);
-    sql = sql_append_mpd(sql, order->deal_fee, false);
-    sql = sdscatprintf(sql, ")");
+    sds sql = entry->val;
+    char *p = put_row_begin(sql + sdslen(sql), sql, table, key.hash, order_columns);
+    p = put_u64(p, order->id);
+    p = put_const(p, ", ");
+    p = put_time(p, order->create_time);
+    p = put_const(p, ", ");
+    p = put_time(p, order->update_time);
+    p = put_const(p, ", ");
+    p = put_u64(p, order->user_id);
+    p = put_const(p, ", ");
+    p = put_quote(p, order->market, true);
+    p = put_quote(p, source, true);
+    p = put_u64(p, order->type);
+    p = put_const(p, ", ");
+    p = put_u64(p, order->side);
+    p = put_const(p, ", ");
+    p = put_mpd(p, order->price, true);
+    p = put_mpd(p, order->amount, true);
+    p = put_mpd(p, order->taker_fee, true);
+    p = put_mpd(p, order->maker_fee, true);
+    p = put_mpd(p, order->deal_stock, true);
+    p = put_mpd(p, order->deal_money, true);
+    p = put_mpd(p, order->deal_fee, false);
+    return put_row_end(entry, p);
+}
 
-    set_sql(&key, sql);
+//添加用户订单的命令存入sql字典
+static int append_user_order(order_t *order)
+{
+    return append_order_row(HISTORY_USER_ORDER, "order_history_", order->user_id % HISTORY_HASH_NUM, order);
+}
 
-    return 0;
+//添加订单详情的命令存入sql字典
+static int append_order_detail(order_t *order)
+{
+    return append_order_row(HISTORY_ORDER_DETAIL, "order_detail_", order->id % HISTORY_HASH_NUM, order);
 }
 
 //添加订单的交易命令存入sql字典
@@ -284,30 +372,32 @@ static int append_order_deal(double t, uint32_t user_id, uint64_t deal_id, uint6
     struct dict_sql_key key;
     key.hash = order_id % HISTORY_HASH_NUM;
     key.type = HISTORY_ORDER_DEAL;
-    sds sql = get_sql(&key);
-    if (sql == NULL)
+    dict_entry *entry = get_sql(&key, HISTORY_ROW_MAX);
+    if (entry == NULL)
         return -__LINE__;
 
-    if (sdslen(sql) == 0)
-    {
-        sql = sdscatprintf(sql, "INSERT INTO `deal_history_%u` (`id`, `time`, `user_id`, `deal_id`, `order_id`, `deal_order_id`, `role`, `price`, `amount`, `deal`, `fee`, `deal_fee`) VALUES ", key.hash);
-    }
-    else
-    {
-        sql = sdscatprintf(sql, ", ");
-    }
-
-    sql = sdscatprintf(sql, "(NULL, %f, %u, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %d, ", t, user_id, deal_id, order_id, deal_order_id, role);
-    sql = sql_append_mpd(sql, price, true);
-    sql = sql_append_mpd(sql, amount, true);
-    sql = sql_append_mpd(sql, deal, true);
-    sql = sql_append_mpd(sql, fee, true);
-    sql = sql_append_mpd(sql, deal_fee, false);
-    sql = sdscatprintf(sql, ")");
-
-    set_sql(&key, sql);
-
-    return 0;
+    sds sql = entry->val;
+    char *p = put_row_begin(sql + sdslen(sql), sql, "deal_history_", key.hash,
+            "(`id`, `time`, `user_id`, `deal_id`, `order_id`, `deal_order_id`, `role`, `price`, `amount`, `deal`, `fee`, `deal_fee`)");
+    p = put_const(p, "NULL, ");
+    p = put_time(p, t);
+    p = put_const(p, ", ");
+    p = put_u64(p, user_id);
+    p = put_const(p, ", ");
+    p = put_u64(p, deal_id);
+    p = put_const(p, ", ");
+    p = put_u64(p, order_id);
+    p = put_const(p, ", ");
+    p = put_u64(p, deal_order_id);
+    p = put_const(p, ", ");
+    p = put_int(p, role);
+    p = put_const(p, ", ");
+    p = put_mpd(p, price, true);
+    p = put_mpd(p, amount, true);
+    p = put_mpd(p, deal, true);
+    p = put_mpd(p, fee, true);
+    p = put_mpd(p, deal_fee, false);
+    return put_row_end(entry, p);
 }
 
 //添加用户交易的命令存入sql字典
@@ -316,30 +406,63 @@ static int append_user_deal(double t, uint32_t user_id, const char *market, uint
     struct dict_sql_key key;
     key.hash = user_id % HISTORY_HASH_NUM;
     key.type = HISTORY_USER_DEAL;
-    sds sql = get_sql(&key);
-    if (sql == NULL)
+    dict_entry *entry = get_sql(&key, HISTORY_ROW_MAX + strlen(market));
+    if (entry == NULL)
         return -__LINE__;
 
-    if (sdslen(sql) == 0)
+    sds sql = entry->val;
+    char *p = put_row_begin(sql + sdslen(sql), sql, "user_deal_history_", key.hash,
+            "(`id`, `time`, `user_id`, `market`, `deal_id`, `order_id`, `deal_order_id`, `side`, `role`, `price`, `amount`, `deal`, `fee`, `deal_fee`)");
+    p = put_const(p, "NULL, ");
+    p = put_time(p, t);
+    p = put_const(p, ", ");
+    p = put_u64(p, user_id);
+    p = put_const(p, ", ");
+    p = put_quote(p, market, true);
+    p = put_u64(p, deal_id);
+    p = put_const(p, ", ");
+    p = put_u64(p, order_id);
+    p = put_const(p, ", ");
+    p = put_u64(p, deal_order_id);
+    p = put_const(p, ", ");
+    p = put_int(p, side);
+    p = put_const(p, ", ");
+    p = put_int(p, role);
+    p = put_const(p, ", ");
+    p = put_mpd(p, price, true);
+    p = put_mpd(p, amount, true);
+    p = put_mpd(p, deal, true);
+    p = put_mpd(p, fee, true);
+    p = put_mpd(p, deal_fee, false);
+    return put_row_end(entry, p);
+}
+
+static const char *balance_columns = "(`id`, `time`, `user_id`, `asset`, `business`, `change`, `balance`, `detail`)";
+
+//用户账户记录的一行，detail之前的部分
+static char *put_balance_row(dict_entry *entry, uint32_t hash, double t, uint32_t user_id, const char *asset, const char *business, bool negative, mpd_t *change, mpd_t *balance)
+{
+    sds sql = entry->val;
+    char *p = put_row_begin(sql + sdslen(sql), sql, "balance_history_", hash, balance_columns);
+    p = put_const(p, "NULL, ");
+    p = put_time(p, t);
+    p = put_const(p, ", ");
+    p = put_u64(p, user_id);
+    p = put_const(p, ", ");
+    p = put_quote(p, asset, true);
+    p = put_quote(p, business, true);
+    if (negative)
     {
-        sql = sdscatprintf(sql, "INSERT INTO `user_deal_history_%u` (`id`, `time`, `user_id`, `market`, `deal_id`, `order_id`, `deal_order_id`, `side`, `role`, `price`, `amount`, `deal`, `fee`, `deal_fee`) VALUES ", key.hash);
+        p = put_const(p, "'-");
+        p = put_decimal(p, change, false);
+        p = put_const(p, "', ");
     }
     else
     {
-        sql = sdscatprintf(sql, ", ");
+        p = put_mpd(p, change, true);
     }
-
-    sql = sdscatprintf(sql, "(NULL, %f, %u, '%s', %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %d, %d, ", t, user_id, market, deal_id, order_id, deal_order_id, side, role);
-    sql = sql_append_mpd(sql, price, true);
-    sql = sql_append_mpd(sql, amount, true);
-    sql = sql_append_mpd(sql, deal, true);
-    sql = sql_append_mpd(sql, fee, true);
-    sql = sql_append_mpd(sql, deal_fee, false);
-    sql = sdscatprintf(sql, ")");
-
-    set_sql(&key, sql);
-
-    return 0;
+    p = put_mpd(p, balance, true);
+    return p;
 }
 
 //添加用户账户的命令存入sql字典
@@ -348,29 +471,24 @@ static int append_user_balance(double t, uint32_t user_id, const char *asset, co
     struct dict_sql_key key;
     key.hash = user_id % HISTORY_HASH_NUM;
     key.type = HISTORY_USER_BALANCE;
-    sds sql = get_sql(&key);
-    if (sql == NULL)
+    size_t detail_len = strlen(detail);
+    dict_entry *entry = get_sql(&key, HISTORY_ROW_MAX + strlen(asset) + strlen(business) + detail_len * 2);
+    if (entry == NULL)
         return -__LINE__;
 
-    if (sdslen(sql) == 0)
-    {
-        sql = sdscatprintf(sql, "INSERT INTO `balance_history_%u` (`id`, `time`, `user_id`, `asset`, `business`, `change`, `balance`, `detail`) VALUES ", key.hash);
-    }
-    else
-    {
-        sql = sdscatprintf(sql, ", ");
-    }
-
-    char buf[10 * 1024];
-    sql = sdscatprintf(sql, "(NULL, %f, %u, '%s', '%s', ", t, user_id, asset, business);
-    sql = sql_append_mpd(sql, change, true);
-    sql = sql_append_mpd(sql, balance, true);
-    mysql_real_escape_string(mysql_conn, buf, detail, strlen(detail));
-    sql = sdscatprintf(sql, "'%s')", buf);
-
-    set_sql(&key, sql);
+    char *p = put_balance_row(entry, key.hash, t, user_id, asset, business, false, change, balance);
+    *p++ = '\'';
+    p += mysql_real_escape_string(mysql_conn, p, detail, detail_len);
+    *p++ = '\'';
+    return put_row_end(entry, p);
+}
 
-    return 0;
+//写入detail中的高精度数值及其结尾的引号，已按mysql转义
+static char *put_detail_mpd(char *p, mpd_t *val)
+{
+    p = put_decimal(p, val, true);
+    p = put_const(p, "\\\"");
+    return p;
 }
 
 //订单历史的命令存入sql字典
@@ -404,6 +522,40 @@ int append_user_balance_history(double t, uint32_t user_id, const char *asset, c
     return 0;
 }
 
+//成交引起的用户账户历史存入sql字典
+//detail与json_dumps(JSON_SORT_KEYS)的结果相同，直接写入转义后的文本，不构造json对象
+int append_user_balance_trade_history(double t, uint32_t user_id, const char *asset, bool negative, mpd_t *change,
+        const char *market, uint64_t order_id, mpd_t *price, mpd_t *amount, mpd_t *fee_rate)
+{
+    struct dict_sql_key key;
+    key.hash = user_id % HISTORY_HASH_NUM;
+    key.type = HISTORY_USER_BALANCE;
+    dict_entry *entry = get_sql(&key, HISTORY_ROW_MAX + strlen(asset) + strlen(market));
+    if (entry == NULL)
+        return -__LINE__;
+
+    mpd_t *balance = balance_total(user_id, asset);
+    char *p = put_balance_row(entry, key.hash, t, user_id, asset, "trade", negative, change, balance);
+    mpd_del(balance);
+
+    // 交易对名称来自配置，不含需要转义的字符
+    p = put_const(p, "'{\\\"a\\\": \\\"");
+    p = put_detail_mpd(p, amount);
+    if (fee_rate)
+    {
+        p = put_const(p, ", \\\"f\\\": \\\"");
+        p = put_detail_mpd(p, fee_rate);
+    }
+    p = put_const(p, ", \\\"i\\\": ");
+    p = put_u64(p, order_id);
+    p = put_const(p, ", \\\"m\\\": \\\"");
+    p = put_str(p, market, strlen(market));
+    p = put_const(p, "\\\", \\\"p\\\": \\\"");
+    p = put_detail_mpd(p, price);
+    p = put_const(p, "}'");
+    return put_row_end(entry, p);
+}
+
 //历史记录是否阻塞
 bool is_history_block(void)
 {
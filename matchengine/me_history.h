@@ -14,6 +14,8 @@ int fini_history(void);
 int append_order_history(order_t *order);
 int append_order_deal_history(double t, uint64_t deal_id, order_t *ask, int ask_role, order_t *bid, int bid_role, mpd_t *price, mpd_t *amount, mpd_t *deal, mpd_t *ask_fee, mpd_t *bid_fee);
 int append_user_balance_history(double t, uint32_t user_id, const char *asset, const char *business, mpd_t *change, const char *detail);
+int append_user_balance_trade_history(double t, uint32_t user_id, const char *asset, bool negative, mpd_t *change,
+        const char *market, uint64_t order_id, mpd_t *price, mpd_t *amount, mpd_t *fee_rate);
 
 bool is_history_block(void);
 sds history_status(sds reply);
@@ -12,6 +12,24 @@
 #include "me_market.h"
 #include "me_update.h"
 #include "me_balance.h"
+#include "me_operlog.h"
+#include "me_dump.h"
+#include "ut_crc32.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//解析高精度数值到已有的mpd_t
+static bool load_decimal(mpd_t *result, const char *str, int prec)
+{
+    mpd_t *value = decimal(str, prec);
+    if (value == NULL)
+        return false;
+    mpd_copy(result, value, &mpd_ctx);
+    mpd_del(value);
+    return true;
+}
 
 //载入订单
 int load_orders(MYSQL *conn, const char *table)
@@ -45,34 +63,42 @@ int load_orders(MYSQL *conn, const char *table)
             if (market == NULL)
                 continue;
 
-            order_t *order = malloc(sizeof(order_t));
-            memset(order, 0, sizeof(order_t));
+            order_t *order = market_alloc_order(market);
+            if (order == NULL)
+            {
+                mysql_free_result(result);
+                return -__LINE__;
+            }
             order->id = strtoull(row[0], NULL, 0);
             order->type = strtoul(row[1], NULL, 0);
             order->side = strtoul(row[2], NULL, 0);
             order->create_time = strtod(row[3], NULL);
             order->update_time = strtod(row[4], NULL);
             order->user_id = strtoul(row[5], NULL, 0);
-            order->market = strdup(row[6]);
-            order->price = decimal(row[7], market->money_prec);
-            order->amount = decimal(row[8], market->stock_prec);
-            order->taker_fee = decimal(row[9], market->fee_prec);
-            order->maker_fee = decimal(row[10], market->fee_prec);
-            order->left = decimal(row[11], market->stock_prec);
-            order->freeze = decimal(row[12], 0);
-            order->deal_stock = decimal(row[13], 0);
-            order->deal_money = decimal(row[14], 0);
-            order->deal_fee = decimal(row[15], 0);
-
-            if (!order->market || !order->price || !order->amount || !order->taker_fee || !order->maker_fee || !order->left ||
-                !order->freeze || !order->deal_stock || !order->deal_money || !order->deal_fee)
+
+            if (!load_decimal(order->price, row[7], market->money_prec) ||
+                !load_decimal(order->amount, row[8], market->stock_prec) ||
+                !load_decimal(order->taker_fee, row[9], market->fee_prec) ||
+                !load_decimal(order->maker_fee, row[10], market->fee_prec) ||
+                !load_decimal(order->left, row[11], market->stock_prec) ||
+                !load_decimal(order->freeze, row[12], 0) ||
+                !load_decimal(order->deal_stock, row[13], 0) ||
+                !load_decimal(order->deal_money, row[14], 0) ||
+                !load_decimal(order->deal_fee, row[15], 0))
             {
                 log_error("get order detail of order id: %" PRIu64 " fail", order->id);
+                market_free_order(market, order);
                 mysql_free_result(result);
                 return -__LINE__;
             }
 
-            market_put_order(market, order);
+            ret = market_put_order(market, order);
+            if (ret < 0)
+            {
+                log_error("put order: %" PRIu64 " fail: %d", last_id, ret);
+                mysql_free_result(result);
+                return -__LINE__;
+            }
         }
         mysql_free_result(result);
 
@@ -129,6 +155,220 @@ int load_balance(MYSQL *conn, const char *table)
     return 0;
 }
 
+//读出二进制切片文件头
+int load_slice_head(const char *path, struct slice_file_head *head)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -__LINE__;
+    size_t n = fread(head, 1, sizeof(*head), fp);
+    fclose(fp);
+    if (n != sizeof(*head))
+        return -__LINE__;
+    if (head->magic != SLICE_FILE_MAGIC || head->version != SLICE_FILE_VERSION)
+        return -__LINE__;
+
+    return 0;
+}
+
+struct slice_reader
+{
+    const char *data;
+    size_t size;
+    size_t pos;
+};
+
+static bool slice_read(struct slice_reader *reader, void *out, size_t len)
+{
+    if (reader->size - reader->pos < len)
+        return false;
+    memcpy(out, reader->data + reader->pos, len);
+    reader->pos += len;
+    return true;
+}
+
+//系数字直接拷贝，不经过字符串解析
+static bool slice_read_mpd(struct slice_reader *reader, mpd_t *result)
+{
+    struct slice_decimal head;
+    if (!slice_read(reader, &head, sizeof(head)) || head.len == 0)
+        return false;
+    size_t size = sizeof(mpd_uint_t) * head.len;
+    if (reader->size - reader->pos < size)
+        return false;
+
+    uint32_t status = 0;
+    if (!mpd_qresize(result, head.len, &status))
+        return false;
+    memcpy(result->data, reader->data + reader->pos, size);
+    reader->pos += size;
+    for (size_t i = 0; i < head.len; ++i)
+    {
+        if (result->data[i] >= MPD_RADIX)
+            return false;
+    }
+
+    mpd_clear_flags(result);
+    mpd_set_sign(result, head.sign ? MPD_NEG : MPD_POS);
+    result->exp = head.exp;
+    result->len = head.len;
+    mpd_setdigits(result);
+
+    return true;
+}
+
+//apply为false时只检查格式，不修改订单簿
+static int load_slice_orders(struct slice_reader *reader, mpd_t *scratch, bool apply)
+{
+    struct slice_market_head head;
+    if (!slice_read(reader, &head, sizeof(head)) || head.name_len > 64)
+        return -__LINE__;
+    char name[65];
+    if (!slice_read(reader, name, head.name_len))
+        return -__LINE__;
+    name[head.name_len] = '\0';
+    market_t *market = get_market(name);
+
+    for (uint64_t i = 0; i < head.order_count; ++i)
+    {
+        struct slice_order record;
+        if (!slice_read(reader, &record, sizeof(record)))
+            return -__LINE__;
+
+        // 已下线的交易对，跳过其订单
+        if (market == NULL || !apply)
+        {
+            for (int j = 0; j < ORDER_MPD_NUM; ++j)
+            {
+                if (!slice_read_mpd(reader, scratch))
+                    return -__LINE__;
+            }
+            continue;
+        }
+
+        order_t *order = market_alloc_order(market);
+        if (order == NULL)
+            return -__LINE__;
+        order->id = record.id;
+        order->type = record.type;
+        order->side = record.side;
+        order->create_time = record.create_time;
+        order->update_time = record.update_time;
+        order->user_id = record.user_id;
+        if (!slice_read_mpd(reader, order->price) ||
+                !slice_read_mpd(reader, order->amount) ||
+                !slice_read_mpd(reader, order->taker_fee) ||
+                !slice_read_mpd(reader, order->maker_fee) ||
+                !slice_read_mpd(reader, order->left) ||
+                !slice_read_mpd(reader, order->freeze) ||
+                !slice_read_mpd(reader, order->deal_stock) ||
+                !slice_read_mpd(reader, order->deal_money) ||
+                !slice_read_mpd(reader, order->deal_fee))
+        {
+            log_error("get order detail of order id: %" PRIu64 " fail", order->id);
+            market_free_order(market, order);
+            return -__LINE__;
+        }
+
+        int ret = market_put_order(market, order);
+        if (ret < 0)
+        {
+            log_error("put order: %" PRIu64 " fail: %d", record.id, ret);
+            return -__LINE__;
+        }
+    }
+
+    return 0;
+}
+
+static int load_slice_body(struct slice_reader *reader, const struct slice_file_head *head, bool apply)
+{
+    mpd_uint_t data[MPD_MINALLOC_MAX];
+    mpd_t scratch = {MPD_STATIC | MPD_STATIC_DATA, 0, 0, 0, MPD_MINALLOC_MAX, data};
+
+    int ret = 0;
+    for (uint64_t i = 0; i < head->market_count && ret == 0; ++i)
+    {
+        ret = load_slice_orders(reader, &scratch, apply);
+    }
+    for (uint64_t i = 0; i < head->balance_count && ret == 0; ++i)
+    {
+        struct slice_balance record;
+        if (!slice_read(reader, &record, sizeof(record)) || !slice_read_mpd(reader, &scratch))
+        {
+            ret = -__LINE__;
+            break;
+        }
+        record.asset[ASSET_NAME_MAX_LEN] = '\0';
+        if (!apply || !asset_exist(record.asset))
+            continue;
+        balance_set(record.user_id, record.type, record.asset, &scratch);
+    }
+    if (ret == 0 && reader->pos != reader->size)
+        ret = -__LINE__;
+
+    mpd_del(&scratch);
+    return ret;
+}
+
+//通过mmap载入二进制切片文件
+//先完整校验crc和格式再载入，校验失败时damaged为true，内存中的状态没有被修改
+int load_slice_file(const char *path, bool *damaged)
+{
+    *damaged = true;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error("open file: %s fail: %d %s", path, errno, strerror(errno));
+        return -__LINE__;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct slice_file_head))
+    {
+        log_error("slice file: %s truncated", path);
+        close(fd);
+        return -__LINE__;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        log_error("mmap file: %s fail: %d %s", path, errno, strerror(errno));
+        return -__LINE__;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    struct slice_reader reader = {data, st.st_size, 0};
+    struct slice_file_head head;
+    slice_read(&reader, &head, sizeof(head));
+    int ret = 0;
+    if (head.magic != SLICE_FILE_MAGIC || head.version != SLICE_FILE_VERSION || head.size != (uint64_t)st.st_size)
+    {
+        ret = -__LINE__;
+    }
+    else if (generate_crc32c(reader.data + reader.pos, reader.size - reader.pos) != head.crc)
+    {
+        ret = -__LINE__;
+    }
+    else
+    {
+        ret = load_slice_body(&reader, &head, false);
+    }
+    if (ret == 0)
+    {
+        *damaged = false;
+        reader.pos = sizeof(head);
+        ret = load_slice_body(&reader, &head, true);
+    }
+    if (ret < 0)
+    {
+        log_error("load slice file: %s fail at %zu: %d", path, reader.pos, ret);
+    }
+
+    munmap(data, st.st_size);
+    return ret;
+}
+
 //载入更新后的账户
 static int load_update_balance(json_t *params)
 {
@@ -390,6 +630,116 @@ static int load_cancel_order(json_t *params)
     return 0;
 }
 
+//载入撤销用户全部挂单
+static int load_cancel_user_orders(json_t *params)
+{
+    if (json_array_size(params) < 2 || json_array_size(params) > 4)
+        return -__LINE__;
+
+    // user_id
+    if (!json_is_integer(json_array_get(params, 0)))
+        return -__LINE__;
+    uint32_t user_id = json_integer_value(json_array_get(params, 0));
+
+    // market
+    if (!json_is_string(json_array_get(params, 1)))
+        return -__LINE__;
+    const char *market_name = json_string_value(json_array_get(params, 1));
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return 0;
+
+    // side，缺省为0
+    uint32_t side = 0;
+    if (json_array_size(params) >= 3)
+    {
+        if (!json_is_integer(json_array_get(params, 2)))
+            return -__LINE__;
+        side = json_integer_value(json_array_get(params, 2));
+    }
+
+    // 撤单中途失败时记录的撤单数
+    size_t limit = 0;
+    if (json_array_size(params) == 4)
+    {
+        if (!json_is_integer(json_array_get(params, 3)))
+            return -__LINE__;
+        limit = json_integer_value(json_array_get(params, 3));
+    }
+
+    size_t count;
+    int ret = market_cancel_user_orders(false, market, user_id, side, limit, &count);
+    if (ret < 0)
+    {
+        log_error("market_cancel_user_orders user id: %u, market: %s, side: %u fail: %d", user_id, market_name, side, ret);
+        return -__LINE__;
+    }
+
+    return 0;
+}
+
+//载入撤销交易对全部挂单
+static int load_cancel_all_orders(json_t *params)
+{
+    if (json_array_size(params) < 1 || json_array_size(params) > 3)
+        return -__LINE__;
+
+    // market
+    if (!json_is_string(json_array_get(params, 0)))
+        return -__LINE__;
+    const char *market_name = json_string_value(json_array_get(params, 0));
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return 0;
+
+    // side，缺省为0
+    uint32_t side = 0;
+    if (json_array_size(params) >= 2)
+    {
+        if (!json_is_integer(json_array_get(params, 1)))
+            return -__LINE__;
+        side = json_integer_value(json_array_get(params, 1));
+    }
+
+    // 撤单中途失败时记录的撤单数
+    size_t limit = 0;
+    if (json_array_size(params) == 3)
+    {
+        if (!json_is_integer(json_array_get(params, 2)))
+            return -__LINE__;
+        limit = json_integer_value(json_array_get(params, 2));
+    }
+
+    size_t count;
+    int ret = market_cancel_all_orders(false, market, side, limit, &count);
+    if (ret < 0)
+    {
+        log_error("market_cancel_all_orders market: %s, side: %u fail: %d", market_name, side, ret);
+        return -__LINE__;
+    }
+
+    return 0;
+}
+
+static int load_oper(json_t *detail);
+
+//批量命令：依次重放其中的操作
+static int load_batch(json_t *params)
+{
+    for (size_t i = 0; i < json_array_size(params); ++i)
+    {
+        json_t *detail = json_array_get(params, i);
+        const char *method = json_string_value(json_object_get(detail, "method"));
+        if (method == NULL || strcmp(method, "batch") == 0)
+            return -__LINE__;
+        int ret = load_oper(detail);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 //载入操作命令
 static int load_oper(json_t *detail)
 {
@@ -417,6 +767,18 @@ static int load_oper(json_t *detail)
     {
         ret = load_cancel_order(params);
     }
+    else if (strcmp(method, "cancel_user_orders") == 0)
+    {
+        ret = load_cancel_user_orders(params);
+    }
+    else if (strcmp(method, "cancel_all_orders") == 0)
+    {
+        ret = load_cancel_all_orders(params);
+    }
+    else if (strcmp(method, "batch") == 0)
+    {
+        ret = load_batch(params);
+    }
     else
     {
         return -__LINE__;
@@ -424,61 +786,354 @@ static int load_oper(json_t *detail)
 
     return ret;
 }
+# define OPERLOG_BATCH_SIZE   10000
+# define OPERLOG_PARSE_THREAD 4
 
-//载入操作历史记录
-int load_operlog(MYSQL *conn, const char *table, uint64_t *start_id)
+//一批操作记录：预取线程读取，解析线程并行解析，主线程按id顺序串行应用
+struct oper_batch
 {
-    size_t query_limit = 1000;
-    uint64_t last_id = *start_id;
-    while (true)
+    size_t count;
+    uint64_t *ids;
+    double *times;
+    sds *details;
+    json_t **opers;
+};
+
+static struct oper_batch *oper_batch_create(void)
+{
+    struct oper_batch *batch = malloc(sizeof(struct oper_batch));
+    batch->count = 0;
+    batch->ids = malloc(sizeof(uint64_t) * OPERLOG_BATCH_SIZE);
+    batch->times = malloc(sizeof(double) * OPERLOG_BATCH_SIZE);
+    batch->details = malloc(sizeof(sds) * OPERLOG_BATCH_SIZE);
+    batch->opers = malloc(sizeof(json_t *) * OPERLOG_BATCH_SIZE);
+    return batch;
+}
+
+static void oper_batch_clear(struct oper_batch *batch)
+{
+    for (size_t i = 0; i < batch->count; ++i)
     {
-        sds sql = sdsempty();
-        sql = sdscatprintf(sql, "SELECT `id`, `detail` from `%s` WHERE `id` > %" PRIu64 " ORDER BY `id` LIMIT %zu", table, last_id, query_limit);
-        log_trace("exec sql: %s", sql);
-        int ret = mysql_real_query(conn, sql, sdslen(sql));
-        if (ret != 0)
+        sdsfree(batch->details[i]);
+        if (batch->opers[i])
+            json_decref(batch->opers[i]);
+    }
+    batch->count = 0;
+}
+
+static void oper_batch_release(struct oper_batch *batch)
+{
+    oper_batch_clear(batch);
+    free(batch->ids);
+    free(batch->times);
+    free(batch->details);
+    free(batch->opers);
+    free(batch);
+}
+
+static void oper_batch_add(struct oper_batch *batch, uint64_t id, double t, const char *detail, size_t len)
+{
+    batch->ids[batch->count] = id;
+    batch->times[batch->count] = t;
+    batch->details[batch->count] = sdsnewlen(detail, len);
+    batch->opers[batch->count] = NULL;
+    batch->count += 1;
+}
+
+struct parse_arg
+{
+    struct oper_batch *batch;
+    size_t start;
+};
+
+static void *parse_thread(void *data)
+{
+    struct parse_arg *arg = data;
+    struct oper_batch *batch = arg->batch;
+    for (size_t i = arg->start; i < batch->count; i += OPERLOG_PARSE_THREAD)
+    {
+        batch->opers[i] = json_loadb(batch->details[i], sdslen(batch->details[i]), 0, NULL);
+    }
+    return NULL;
+}
+
+//并行解析一批记录的detail
+static void oper_batch_parse(struct oper_batch *batch)
+{
+    pthread_t threads[OPERLOG_PARSE_THREAD];
+    struct parse_arg args[OPERLOG_PARSE_THREAD];
+    int started = 0;
+    for (int i = 1; i < OPERLOG_PARSE_THREAD; ++i)
+    {
+        args[i].batch = batch;
+        args[i].start = i;
+        if (pthread_create(&threads[i], NULL, parse_thread, &args[i]) != 0)
+            break;
+        started = i;
+    }
+    args[0].batch = batch;
+    args[0].start = 0;
+    parse_thread(&args[0]);
+    for (int i = 1; i <= started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    // 线程创建失败的分片在主线程补上
+    for (int i = started + 1; i < OPERLOG_PARSE_THREAD; ++i)
+    {
+        args[i].batch = batch;
+        args[i].start = i;
+        parse_thread(&args[i]);
+    }
+}
+
+//按id顺序应用一批记录，ship_id之后的记录补发给MySQL
+static int oper_batch_apply(struct oper_batch *batch, uint64_t ship_id)
+{
+    for (size_t i = 0; i < batch->count; ++i)
+    {
+        if (batch->opers[i] == NULL)
         {
-            log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
-            sdsfree(sql);
+            log_error("invalid detail data: %s", batch->details[i]);
+            return -__LINE__;
+        }
+        int ret = load_oper(batch->opers[i]);
+        if (ret < 0)
+        {
+            log_error("load_oper: %" PRIu64 ":%s fail: %d", batch->ids[i], batch->details[i], ret);
             return -__LINE__;
         }
+        if (batch->ids[i] > ship_id)
+        {
+            reship_operlog(batch->ids[i], batch->times[i], batch->details[i]);
+        }
+    }
+
+    return 0;
+}
+
+static void report_replay(const char *from, size_t count, double start)
+{
+    double cost = current_timestamp() - start;
+    log_info("replay %zu opers from %s in %.3fs, %.0f/s", count, from, cost, cost > 0 ? count / cost : 0);
+    log_stderr("replay %zu opers from %s in %.3fs, %.0f/s", count, from, cost, cost > 0 ? count / cost : 0);
+}
+
+struct fetch_arg
+{
+    MYSQL *conn;
+    const char *table;
+    uint64_t last_id;
+    struct oper_batch *batch;
+    int ret;
+};
+
+//从数据库读取last_id之后的一批记录，检查id连续
+static void fetch_batch(struct fetch_arg *arg)
+{
+    sds sql = sdsempty();
+    sql = sdscatprintf(sql, "SELECT `id`, `time`, `detail` from `%s` WHERE `id` > %" PRIu64 " ORDER BY `id` LIMIT %d",
+            arg->table, arg->last_id, OPERLOG_BATCH_SIZE);
+    log_trace("exec sql: %s", sql);
+    int ret = mysql_real_query(arg->conn, sql, sdslen(sql));
+    if (ret != 0)
+    {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(arg->conn), mysql_error(arg->conn));
         sdsfree(sql);
+        arg->ret = -__LINE__;
+        return;
+    }
+    sdsfree(sql);
 
-        MYSQL_RES *result = mysql_store_result(conn);
-        size_t num_rows = mysql_num_rows(result);
-        for (size_t i = 0; i < num_rows; ++i)
+    arg->ret = 0;
+    uint64_t last_id = arg->last_id;
+    MYSQL_RES *result = mysql_store_result(arg->conn);
+    size_t num_rows = mysql_num_rows(result);
+    for (size_t i = 0; i < num_rows; ++i)
+    {
+        MYSQL_ROW row = mysql_fetch_row(result);
+        unsigned long *lengths = mysql_fetch_lengths(result);
+        uint64_t id = strtoull(row[0], NULL, 0);
+        if (id != last_id + 1)
         {
-            MYSQL_ROW row = mysql_fetch_row(result);
-            uint64_t id = strtoull(row[0], NULL, 0);
-            if (id != last_id + 1)
+            log_error("invalid id: %" PRIu64 ", last id: %" PRIu64 "", id, last_id);
+            arg->ret = -__LINE__;
+            break;
+        }
+        last_id = id;
+        oper_batch_add(arg->batch, id, strtod(row[1], NULL), row[2], lengths[2]);
+    }
+    mysql_free_result(result);
+}
+
+static void *fetch_thread(void *data)
+{
+    mysql_thread_init();
+    fetch_batch(data);
+    mysql_thread_end();
+    return NULL;
+}
+
+//载入操作历史记录，预取下一批的同时解析并应用当前批
+int load_operlog(MYSQL *conn, const char *table, uint64_t *start_id)
+{
+    double start = current_timestamp();
+    size_t total = 0;
+    struct oper_batch *curr = oper_batch_create();
+    struct oper_batch *next = oper_batch_create();
+
+    struct fetch_arg arg = {conn, table, *start_id, curr, 0};
+    fetch_batch(&arg);
+    int ret = arg.ret;
+    while (ret == 0 && curr->count > 0)
+    {
+        // 本批不满说明已读完，不再预取
+        bool more = curr->count == OPERLOG_BATCH_SIZE;
+        pthread_t fetcher;
+        struct fetch_arg next_arg = {conn, table, curr->ids[curr->count - 1], next, 0};
+        if (more && pthread_create(&fetcher, NULL, fetch_thread, &next_arg) != 0)
+        {
+            ret = -__LINE__;
+            break;
+        }
+
+        oper_batch_parse(curr);
+        ret = oper_batch_apply(curr, UINT64_MAX);
+        if (ret == 0)
+        {
+            *start_id = curr->ids[curr->count - 1];
+            total += curr->count;
+        }
+        oper_batch_clear(curr);
+
+        if (!more)
+            break;
+        pthread_join(fetcher, NULL);
+        if (ret == 0)
+            ret = next_arg.ret;
+
+        struct oper_batch *tmp = curr;
+        curr = next;
+        next = tmp;
+    }
+
+    oper_batch_release(curr);
+    oper_batch_release(next);
+    report_replay(table, total, start);
+
+    return ret;
+}
+
+//从本地操作日志文件载入，遇到不完整或校验失败的记录即停止，之后的部分由数据库补齐，
+//文件截断到最后一条完整的记录，重启后追加的记录才能被读出
+//ship_id之后的记录在MySQL中还没有，需要重新补发
+int load_operlog_file(const char *path, uint64_t *start_id, uint64_t ship_id)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        log_error("open file: %s fail: %d %s", path, errno, strerror(errno));
+        return -__LINE__;
+    }
+
+    double start = current_timestamp();
+    size_t total = 0;
+    struct oper_batch *batch = oper_batch_create();
+    uint64_t last_id = *start_id;
+    size_t offset = 0;
+    size_t buf_size = 0;
+    char *buf = NULL;
+    bool eof = false;
+    bool damaged = false;
+    int ret = 0;
+    while (!eof && ret == 0)
+    {
+        while (batch->count < OPERLOG_BATCH_SIZE)
+        {
+            struct operlog_record record;
+            size_t n = fread(&record, 1, sizeof(record), fp);
+            if (n == 0)
             {
-                log_error("invalid id: %" PRIu64 ", last id: %" PRIu64 "", id, last_id);
-                return -__LINE__;
+                eof = true;
+                break;
             }
-            last_id = id;
-            json_t *detail = json_loadb(row[1], strlen(row[1]), 0, NULL);
-            if (detail == NULL)
+            if (n != sizeof(record) || record.len > OPERLOG_RECORD_MAX_LEN)
             {
-                log_error("invalid detail data: %s", row[1]);
-                mysql_free_result(result);
-                return -__LINE__;
+                log_error("invalid record at %s:%zu", path, offset);
+                damaged = true;
+                eof = true;
+                break;
             }
-            ret = load_oper(detail);
-            if (ret < 0)
+
+            size_t size = sizeof(record) + record.len;
+            if (size > buf_size)
             {
-                json_decref(detail);
-                log_error("load_oper: %" PRIu64 ":%s fail: %d", id, row[1], ret);
-                mysql_free_result(result);
-                return -__LINE__;
+                char *tmp = realloc(buf, size);
+                if (tmp == NULL)
+                {
+                    ret = -__LINE__;
+                    break;
+                }
+                buf = tmp;
+                buf_size = size;
             }
-            json_decref(detail);
-        }
-        mysql_free_result(result);
+            memcpy(buf, &record, sizeof(record));
+            char *detail = buf + sizeof(record);
+            if (fread(detail, 1, record.len, fp) != record.len)
+            {
+                log_error("truncated record at %s:%zu", path, offset);
+                damaged = true;
+                eof = true;
+                break;
+            }
+            if (operlog_record_crc(buf, record.len) != record.crc)
+            {
+                log_error("crc mismatch at %s:%zu", path, offset);
+                damaged = true;
+                eof = true;
+                break;
+            }
+            offset += size;
 
-        if (num_rows < query_limit)
+            if (record.id <= last_id)
+                continue;
+            if (record.id != last_id + 1)
+            {
+                log_error("invalid id: %" PRIu64 ", last id: %" PRIu64 "", record.id, last_id);
+                eof = true;
+                break;
+            }
+            last_id = record.id;
+            oper_batch_add(batch, record.id, record.time, detail, record.len);
+        }
+        if (ret < 0 || batch->count == 0)
             break;
+
+        oper_batch_parse(batch);
+        ret = oper_batch_apply(batch, ship_id);
+        if (ret == 0)
+        {
+            *start_id = batch->ids[batch->count - 1];
+            total += batch->count;
+        }
+        oper_batch_clear(batch);
     }
 
-    *start_id = last_id;
-    return 0;
+    free(buf);
+    fclose(fp);
+    oper_batch_release(batch);
+    report_replay(path, total, start);
+
+    if (ret == 0 && damaged)
+    {
+        log_error("truncate operlog file: %s to %zu", path, offset);
+        log_stderr("truncate operlog file: %s to %zu", path, offset);
+        if (truncate(path, offset) != 0)
+        {
+            log_error("truncate %s fail: %d %s", path, errno, strerror(errno));
+            return -__LINE__;
+        }
+    }
+
+    return ret;
 }
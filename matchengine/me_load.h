@@ -8,12 +8,17 @@
 
 # include <stdint.h>
 # include "ut_mysql.h"
+# include "me_dump.h"
 
 int load_orders(MYSQL *conn, const char *table);
 int load_markets(MYSQL *conn, const char *table);
 int load_balance(MYSQL *conn, const char *table);
 
+int load_slice_head(const char *path, struct slice_file_head *head);
+int load_slice_file(const char *path, bool *damaged);
+
 int load_operlog(MYSQL *conn, const char *table, uint64_t *start_id);
+int load_operlog_file(const char *path, uint64_t *start_id, uint64_t ship_id);
 
 # endif
 
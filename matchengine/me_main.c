@@ -138,19 +138,19 @@ int main(int argc, char *argv[]) {
 
   /* 杂项 */
 
-  // 从数据库保存的切片数据复原
-  ret = init_from_db();
-  if (ret < 0) {
-    error(EXIT_FAILURE, errno, "init from db fail: %d", ret);
-  }
-
-  // 初始化操作历史
+  // 初始化操作历史，需在复原之前，以便补发本地文件中MySQL缺少的记录
   // me_operlog.c
   ret = init_operlog();
   if (ret < 0) {
     error(EXIT_FAILURE, errno, "init oper log fail: %d", ret);
   }
 
+  // 从数据库保存的切片数据复原
+  ret = init_from_db();
+  if (ret < 0) {
+    error(EXIT_FAILURE, errno, "init from db fail: %d", ret);
+  }
+
   //初始化历史
   // me_history.c
   ret = init_history();
@@ -13,6 +13,7 @@
 #include "me_config.h"
 #include "me_history.h"
 #include "me_message.h"
+#include "me_trade.h"
 
 uint64_t order_id_start; //订单id的初始值
 uint64_t deals_id_start; //交易id的初始值
@@ -33,71 +34,61 @@ static uint32_t dict_user_hash_function(const void *key) {
   return obj->user_id;
 }
 
-static int dict_user_key_compare(const void *key1, const void *key2) {
-  const struct dict_user_key *obj1 = key1;
-  const struct dict_user_key *obj2 = key2;
-  if (obj1->user_id == obj2->user_id) {
-    return 0;
-  }
-  return 1;
-}
-
-static void *dict_user_key_dup(const void *key) {
-  struct dict_user_key *obj = malloc(sizeof(struct dict_user_key));
-  memcpy(obj, key, sizeof(struct dict_user_key));
-  return obj;
+// value是存放在表中的skiplist_t指针
+static void dict_user_val_free(void *val) {
+  skiplist_release(*(skiplist_t **)val);
 }
 
-static void dict_user_key_free(void *key) { free(key); }
-
-static void dict_user_val_free(void *key) { skiplist_release(key); }
-
 //创建订单字典的相关函数
 static uint32_t dict_order_hash_function(const void *key) {
   return dict_generic_hash_function(key, sizeof(struct dict_order_key));
 }
 
-static int dict_order_key_compare(const void *key1, const void *key2) {
-  const struct dict_order_key *obj1 = key1;
-  const struct dict_order_key *obj2 = key2;
-  if (obj1->order_id == obj2->order_id) {
-    return 0;
-  }
-  return 1;
+//创建来源字典的相关函数
+static uint32_t dict_source_hash_function(const void *key) {
+  return dict_generic_hash_function(key, strlen(key));
 }
 
-static void *dict_order_key_dup(const void *key) {
-  struct dict_order_key *obj = malloc(sizeof(struct dict_order_key));
-  memcpy(obj, key, sizeof(struct dict_order_key));
-  return obj;
+static int dict_source_key_compare(const void *key1, const void *key2) {
+  return strcmp(key1, key2);
 }
 
-static void dict_order_key_free(void *key) { free(key); }
+static void *dict_source_key_dup(const void *key) { return strdup(key); }
 
-//订单价格比较
-static int order_match_compare(const void *value1, const void *value2) {
-  const order_t *order1 = value1;
-  const order_t *order2 = value2;
+static void dict_source_key_free(void *key) { free(key); }
 
-  if (order1->id == order2->id) {
-    return 0; //订单id相同，返回0
-  }
-  if (order1->type != order2->type) {
-    return 1; //订单类型不相同，返回1
+//价位价格比较：asks从低到高，bids从高到低
+static int price_level_compare(const void *value1, const void *value2) {
+  const price_level_t *level1 = value1;
+  const price_level_t *level2 = value2;
+
+  int cmp = mpd_cmp(level1->price, level2->price, &mpd_ctx);
+  if (level1->side == MARKET_ORDER_SIDE_ASK) {
+    return cmp;
   }
+  return -cmp;
+}
 
-  int cmp;
-  if (order1->side == MARKET_ORDER_SIDE_ASK) //如果order1是买单
-  {
-    cmp = mpd_cmp(order1->price, order2->price, &mpd_ctx);
-  } else {
-    cmp = mpd_cmp(order2->price, order1->price, &mpd_ctx);
+//价位价格比较，定点数版本
+static int price_level_compare_fixed(const void *value1, const void *value2) {
+  const price_level_t *level1 = value1;
+  const price_level_t *level2 = value2;
+
+  if (level1->fx_price == level2->fx_price) {
+    return 0;
   }
-  if (cmp != 0) {
-    return cmp; //返回订单价格比较结果
+  if (level1->side == MARKET_ORDER_SIDE_ASK) {
+    return level1->fx_price > level2->fx_price ? 1 : -1;
   }
+  return level1->fx_price < level2->fx_price ? 1 : -1;
+}
 
-  return order1->id > order2->id ? 1 : -1; //返回订单id比较的大小
+//释放价位占用的内存
+static void price_level_free(void *value) {
+  price_level_t *level = value;
+  mpd_del(level->price);
+  mpd_del(level->amount);
+  free(level);
 }
 
 //订单id比较
@@ -111,8 +102,74 @@ static int order_id_compare(const void *value1, const void *value2) {
   return order1->id > order2->id ? -1 : 1;
 }
 
-//释放订单占用的内存
-static void order_free(order_t *order) {
+//订单池每次批量分配的订单数
+#define ORDER_POOL_BATCH 1024
+
+//取得来源字符串的共享副本，引用计数加一
+static char *source_intern(market_t *m, const char *source) {
+  dict_entry *entry = dict_find(m->sources, source);
+  if (entry == NULL) {
+    entry = dict_add(m->sources, (void *)source, NULL);
+    if (entry == NULL)
+      return NULL;
+  }
+  entry->val = (void *)((uintptr_t)entry->val + 1);
+  return entry->key;
+}
+
+//来源字符串引用计数减一，为0时删除
+static void source_release(market_t *m, char *source) {
+  if (source == NULL)
+    return;
+  dict_entry *entry = dict_find(m->sources, source);
+  if (entry == NULL)
+    return;
+  entry->val = (void *)((uintptr_t)entry->val - 1);
+  if (entry->val == NULL) {
+    dict_delete(m->sources, source);
+  }
+}
+
+//从订单池分配订单，高精度字段指向内联存储，由调用方赋值
+order_t *market_alloc_order(market_t *m) {
+  if (m->order_free_list == NULL) {
+    order_t *batch = malloc(sizeof(order_t) * ORDER_POOL_BATCH);
+    if (batch == NULL)
+      return NULL;
+    for (int i = ORDER_POOL_BATCH - 1; i >= 0; --i) {
+      batch[i].next = m->order_free_list;
+      m->order_free_list = &batch[i];
+    }
+    m->order_pool_size += ORDER_POOL_BATCH;
+  }
+
+  order_t *order = m->order_free_list;
+  m->order_free_list = order->next;
+  m->order_pool_used += 1;
+
+  memset(order, 0, offsetof(order_t, mpd));
+  mpd_t **fields[ORDER_MPD_NUM] = {
+      &order->price,      &order->amount,     &order->taker_fee,
+      &order->maker_fee,  &order->left,       &order->freeze,
+      &order->deal_stock, &order->deal_money, &order->deal_fee};
+  for (int i = 0; i < ORDER_MPD_NUM; ++i) {
+    mpd_t *value = &order->mpd[i];
+    value->flags = MPD_STATIC | MPD_STATIC_DATA;
+    value->exp = 0;
+    value->digits = 0;
+    value->len = 0;
+    value->alloc = ORDER_MPD_WORDS;
+    value->data = order->mpd_data[i];
+    *fields[i] = value;
+  }
+  order->market = m->name;
+
+  return order;
+}
+
+//订单放回订单池
+static void order_free(market_t *m, order_t *order) {
+  // 内联存储不够用时libmpdec会改为动态分配，这里释放
   mpd_del(order->price);
   mpd_del(order->amount);
   mpd_del(order->taker_fee);
@@ -122,9 +179,93 @@ static void order_free(order_t *order) {
   mpd_del(order->deal_stock);
   mpd_del(order->deal_money);
   mpd_del(order->deal_fee);
-  free(order->market);
-  free(order->source);
-  free(order);
+  source_release(m, order->source);
+
+  order->next = m->order_free_list;
+  m->order_free_list = order;
+  m->order_pool_used -= 1;
+}
+
+//未加入交易对的订单放回订单池，用于载入失败时
+void market_free_order(market_t *m, order_t *order) { order_free(m, order); }
+
+//高精度数值转为int64定点数
+static int get_fixed64(mpd_t *value, int prec, int64_t *result) {
+  fixed_t val;
+  if (mpd_get_fixed(value, prec, &val) < 0)
+    return -1;
+  if (val > INT64_MAX || val < INT64_MIN)
+    return -1;
+  *result = (int64_t)val;
+  return 0;
+}
+
+//手续费的精度：卖单收取money，买单收取stock
+static int order_fee_prec(market_t *m, order_t *order) {
+  if (order->side == MARKET_ORDER_SIDE_ASK)
+    return m->money_prec + m->stock_prec + m->fee_prec;
+  return m->stock_prec + m->fee_prec;
+}
+
+//冻结量的精度：卖单冻结stock，买单冻结money
+static int order_freeze_prec(market_t *m, order_t *order) {
+  if (order->side == MARKET_ORDER_SIDE_ASK)
+    return m->stock_prec;
+  return m->money_prec + m->stock_prec;
+}
+
+//从高精度字段载入订单的定点数镜像
+static int order_load_fixed(market_t *m, order_t *order) {
+  if (get_fixed64(order->price, m->money_prec, &order->fx_price) < 0)
+    return -__LINE__;
+  if (get_fixed64(order->taker_fee, m->fee_prec, &order->fx_taker_fee) < 0)
+    return -__LINE__;
+  if (get_fixed64(order->maker_fee, m->fee_prec, &order->fx_maker_fee) < 0)
+    return -__LINE__;
+  if (get_fixed64(order->left, m->stock_prec, &order->fx_left) < 0)
+    return -__LINE__;
+  if (get_fixed64(order->deal_stock, m->stock_prec, &order->fx_deal_stock) < 0)
+    return -__LINE__;
+  if (mpd_get_fixed(order->freeze, order_freeze_prec(m, order),
+                    &order->fx_freeze) < 0)
+    return -__LINE__;
+  if (mpd_get_fixed(order->deal_money, m->money_prec + m->stock_prec,
+                    &order->fx_deal_money) < 0)
+    return -__LINE__;
+  if (mpd_get_fixed(order->deal_fee, order_fee_prec(m, order),
+                    &order->fx_deal_fee) < 0)
+    return -__LINE__;
+  return 0;
+}
+
+//市价单按高精度计算成交，成交前换算maker的定点数增量，超出范围时不成交
+static int order_deal_fixed(market_t *m, order_t *maker, mpd_t *amount,
+                            mpd_t *deal, mpd_t *fee, int64_t *fx_amount,
+                            fixed_t *fx_deal, fixed_t *fx_fee) {
+  if (get_fixed64(amount, m->stock_prec, fx_amount) < 0)
+    return -__LINE__;
+  if (mpd_get_fixed(deal, m->money_prec + m->stock_prec, fx_deal) < 0)
+    return -__LINE__;
+  if (mpd_get_fixed(fee, order_fee_prec(m, maker), fx_fee) < 0)
+    return -__LINE__;
+  if (*fx_amount > maker->fx_left)
+    return -__LINE__;
+  if (maker->fx_deal_money + *fx_deal >= fixed_pow10(FIXED_MAX_DIGITS) ||
+      maker->fx_deal_fee + *fx_fee >= fixed_pow10(FIXED_MAX_DIGITS))
+    return -__LINE__;
+  return 0;
+}
+
+//成交后将定点数镜像写回高精度字段，供json/sql/kafka使用
+static void order_flush_fixed(market_t *m, order_t *order, bool freeze) {
+  mpd_set_fixed(order->left, order->fx_left, m->stock_prec);
+  mpd_set_fixed(order->deal_stock, order->fx_deal_stock, m->stock_prec);
+  mpd_set_fixed(order->deal_money, order->fx_deal_money,
+                m->money_prec + m->stock_prec);
+  mpd_set_fixed(order->deal_fee, order->fx_deal_fee, order_fee_prec(m, order));
+  if (freeze) {
+    mpd_set_fixed(order->freeze, order->fx_freeze, order_freeze_prec(m, order));
+  }
 }
 
 //获取订单信息
@@ -151,23 +292,188 @@ json_t *get_order_info(order_t *order) {
   return info;
 }
 
-//订单放入market
-static int order_put(market_t *m, order_t *order) {
+//记录价位变动，同一价位在一次操作中只记录一次
+static void depth_touch(market_t *m, price_level_t *level) {
+  if (level->depth_index)
+    return;
+  if (m->depth_change_num == m->depth_change_max) {
+    size_t max = m->depth_change_max ? m->depth_change_max * 2 : 16;
+    depth_change *changes =
+        realloc(m->depth_changes, sizeof(depth_change) * max);
+    if (changes == NULL) {
+      m->depth_lost = true;
+      return;
+    }
+    m->depth_changes = changes;
+    m->depth_change_max = max;
+  }
+  depth_change *change = &m->depth_changes[m->depth_change_num++];
+  change->side = level->side;
+  change->level = level;
+  change->price = NULL;
+  level->depth_index = m->depth_change_num;
+}
+
+//价位删除前保存价格，推送时余量为0
+static void depth_detach(market_t *m, price_level_t *level) {
+  depth_touch(m, level);
+  if (level->depth_index == 0)
+    return;
+  depth_change *change = &m->depth_changes[level->depth_index - 1];
+  change->level = NULL;
+  change->price = mpd_qncopy(level->price);
+  level->depth_index = 0;
+}
+
+//操作结束时推送本次变动的价位及其余量，重放操作日志时只清空
+static void depth_flush(bool real, market_t *m) {
+  if (m->depth_change_num == 0 && !m->depth_lost)
+    return;
+
+  if (real) {
+    json_t *asks = json_array();
+    json_t *bids = json_array();
+    for (size_t i = 0; i < m->depth_change_num; ++i) {
+      depth_change *change = &m->depth_changes[i];
+      json_t *info = json_array();
+      if (change->level) {
+        json_array_append_new_mpd(info, change->level->price);
+        json_array_append_new_mpd(info, change->level->amount);
+      } else {
+        json_array_append_new_mpd(info, change->price);
+        json_array_append_new_mpd(info, mpd_zero);
+      }
+      json_array_append_new(
+          change->side == MARKET_ORDER_SIDE_ASK ? asks : bids, info);
+    }
+    m->depth_seq += m->depth_lost ? 2 : 1;
+    push_depth_message(m, asks, bids);
+    json_decref(asks);
+    json_decref(bids);
+  }
+
+  for (size_t i = 0; i < m->depth_change_num; ++i) {
+    depth_change *change = &m->depth_changes[i];
+    if (change->level) {
+      change->level->depth_index = 0;
+    } else {
+      mpd_del(change->price);
+    }
+  }
+  m->depth_change_num = 0;
+  m->depth_lost = false;
+}
+
+//订单加入所在价位的队尾，价位不存在时创建
+static int book_insert(market_t *m, skiplist_t *book, order_t *order) {
+  price_level_t key = {
+      .side = order->side, .price = order->price, .fx_price = order->fx_price};
+  price_level_t *level;
+  skiplist_node *node = skiplist_find(book, &key);
+  if (node) {
+    level = node->value;
+  } else {
+    level = malloc(sizeof(price_level_t));
+    if (level == NULL)
+      return -__LINE__;
+    memset(level, 0, sizeof(price_level_t));
+    level->side = order->side;
+    level->price = mpd_qncopy(order->price);
+    level->fx_price = order->fx_price;
+    level->amount = mpd_new(&mpd_ctx);
+    mpd_copy(level->amount, mpd_zero, &mpd_ctx);
+    if (skiplist_insert(book, level) == NULL) {
+      price_level_free(level);
+      return -__LINE__;
+    }
+  }
+
+  order->level = level;
+  order->prev = level->tail;
+  order->next = NULL;
+  if (level->tail) {
+    level->tail->next = order;
+  } else {
+    level->head = order;
+  }
+  level->tail = order;
+  level->count += 1;
+  mpd_add(level->amount, level->amount, order->left, &mpd_ctx);
+  depth_touch(m, level);
+  // 价位在跳表中的权重为订单数，用于按订单偏移定位
+  if (level->count > 1)
+    skiplist_set_weight(book, level, level->count);
+  return 0;
+}
+
+//订单移出价位队列，价位为空时删除
+static void book_remove(market_t *m, skiplist_t *book, order_t *order) {
+  price_level_t *level = order->level;
+  if (order->prev) {
+    order->prev->next = order->next;
+  } else {
+    level->head = order->next;
+  }
+  if (order->next) {
+    order->next->prev = order->prev;
+  } else {
+    level->tail = order->prev;
+  }
+  order->level = NULL;
+  order->prev = order->next = NULL;
+
+  level->count -= 1;
+  mpd_sub(level->amount, level->amount, order->left, &mpd_ctx);
+  if (level->count == 0) {
+    depth_detach(m, level);
+    skiplist_node *node = skiplist_find(book, level);
+    if (node) {
+      skiplist_delete(book, node);
+    }
+  } else {
+    depth_touch(m, level);
+    skiplist_set_weight(book, level, level->count);
+  }
+}
+
+//最优价位的第一个订单
+static order_t *book_head(skiplist_t *book) {
+  skiplist_node *node = book->header->forward[0];
+  if (node == NULL) {
+    return NULL;
+  }
+  price_level_t *level = node->value;
+  return level->head;
+}
+
+//maker成交后更新所在价位及盘口的余量
+static void book_deal(market_t *m, order_t *maker, mpd_t *amount) {
+  mpd_sub(maker->level->amount, maker->level->amount, amount, &mpd_ctx);
+  depth_touch(m, maker->level);
+  if (maker->side == MARKET_ORDER_SIDE_ASK) {
+    mpd_sub(m->ask_amount, m->ask_amount, amount, &mpd_ctx);
+  } else {
+    mpd_sub(m->bid_amount, m->bid_amount, amount, &mpd_ctx);
+  }
+}
+
+//订单放入market，freeze为false时不冻结余额
+static int order_put(market_t *m, order_t *order, bool freeze) {
   if (order->type != MARKET_ORDER_TYPE_LIMIT) //检查是否是limit限价订单
     return -__LINE__;
 
   struct dict_order_key order_key = {.order_id = order->id};
-  if (dict_add(m->orders, &order_key, order) ==
+  if (hashmap_add(m->orders, &order_key, &order) ==
       NULL) //将订单id加入交易对的订单字典
     return -__LINE__;
 
   struct dict_user_key user_key = {
       .user_id = order->user_id}; //将用户id加入交易对的用户字典
-  dict_entry *entry = dict_find(m->users, &user_key); //查找刚加入的用户
+  skiplist_t **val = hashmap_find(m->users, &user_key); //查找刚加入的用户
 
-  if (entry) //如果找到刚加入的用户
+  if (val) //如果找到刚加入的用户
   {
-    skiplist_t *order_list = entry->val; //跳过的订单列表
+    skiplist_t *order_list = *val; //跳过的订单列表
     if (skiplist_insert(order_list, order) == NULL)
       return -__LINE__;
   } else //如果没有找到刚加入的用户
@@ -180,29 +486,35 @@ static int order_put(market_t *m, order_t *order) {
       return -__LINE__;
     if (skiplist_insert(order_list, order) == NULL)
       return -__LINE__;
-    if (dict_add(m->users, &user_key, order_list) == NULL)
+    if (hashmap_add(m->users, &user_key, &order_list) == NULL)
       return -__LINE__;
   }
 
   if (order->side == MARKET_ORDER_SIDE_ASK) //检查订单是否是市价买单
   {
-    if (skiplist_insert(m->asks, order) == NULL)
+    if (book_insert(m, m->asks, order) < 0)
       return -__LINE__;
+    m->ask_count += 1;
+    mpd_add(m->ask_amount, m->ask_amount, order->left, &mpd_ctx);
     mpd_copy(order->freeze, order->left, &mpd_ctx);
-    if (balance_freeze(order->user_id, m->stock, order->left) == NULL)
+    order->fx_freeze = order->fx_left;
+    if (freeze && balance_freeze(order->user_id, m->stock, order->left) == NULL)
       return -__LINE__;
   } else //否则订单就是市价卖单
   {
-    if (skiplist_insert(m->bids, order) == NULL)
-      return -__LINE__;
-    mpd_t *result = mpd_new(&mpd_ctx);
-    mpd_mul(result, order->price, order->left, &mpd_ctx);
-    mpd_copy(order->freeze, result, &mpd_ctx);
-    if (balance_freeze(order->user_id, m->money, result) == NULL) {
-      mpd_del(result);
+    if (book_insert(m, m->bids, order) < 0)
       return -__LINE__;
+    m->bid_count += 1;
+    mpd_add(m->bid_amount, m->bid_amount, order->left, &mpd_ctx);
+    if (m->fixed) {
+      order->fx_freeze = (fixed_t)order->fx_price * order->fx_left;
+      mpd_set_fixed(order->freeze, order->fx_freeze,
+                    m->money_prec + m->stock_prec);
+    } else {
+      mpd_mul(order->freeze, order->price, order->left, &mpd_ctx);
     }
-    mpd_del(result);
+    if (freeze && balance_freeze(order->user_id, m->money, order->freeze) == NULL)
+      return -__LINE__;
   }
 
   return 0;
@@ -211,9 +523,10 @@ static int order_put(market_t *m, order_t *order) {
 //订单完成
 static int order_finish(bool real, market_t *m, order_t *order) {
   if (order->side == MARKET_ORDER_SIDE_ASK) {
-    skiplist_node *node = skiplist_find(m->asks, order);
-    if (node) {
-      skiplist_delete(m->asks, node);
+    if (order->level) {
+      book_remove(m, m->asks, order);
+      m->ask_count -= 1;
+      mpd_sub(m->ask_amount, m->ask_amount, order->left, &mpd_ctx);
     }
     if (mpd_cmp(order->freeze, mpd_zero, &mpd_ctx) > 0) {
       if (balance_unfreeze(order->user_id, m->stock, order->freeze) == NULL) {
@@ -221,9 +534,10 @@ static int order_finish(bool real, market_t *m, order_t *order) {
       }
     }
   } else {
-    skiplist_node *node = skiplist_find(m->bids, order);
-    if (node) {
-      skiplist_delete(m->bids, node);
+    if (order->level) {
+      book_remove(m, m->bids, order);
+      m->bid_count -= 1;
+      mpd_sub(m->bid_amount, m->bid_amount, order->left, &mpd_ctx);
     }
     if (mpd_cmp(order->freeze, mpd_zero, &mpd_ctx) > 0) {
       if (balance_unfreeze(order->user_id, m->money, order->freeze) == NULL) {
@@ -233,12 +547,12 @@ static int order_finish(bool real, market_t *m, order_t *order) {
   }
 
   struct dict_order_key order_key = {.order_id = order->id};
-  dict_delete(m->orders, &order_key);
+  hashmap_delete(m->orders, &order_key);
 
   struct dict_user_key user_key = {.user_id = order->user_id};
-  dict_entry *entry = dict_find(m->users, &user_key);
-  if (entry) {
-    skiplist_t *order_list = entry->val;
+  skiplist_t **val = hashmap_find(m->users, &user_key);
+  if (val) {
+    skiplist_t *order_list = *val;
     skiplist_node *node = skiplist_find(order_list, order);
     if (node) {
       skiplist_delete(order_list, node);
@@ -255,7 +569,7 @@ static int order_finish(bool real, market_t *m, order_t *order) {
     }
   }
 
-  order_free(order);
+  order_free(m, order);
   return 0;
 }
 
@@ -284,36 +598,48 @@ market_t *market_create(struct market *conf) {
   m->money_prec = conf->money_prec;
   m->fee_prec = conf->fee_prec;
   m->min_amount = mpd_qncopy(conf->min_amount);
+  m->ask_amount = mpd_qncopy(mpd_zero);
+  m->bid_amount = mpd_qncopy(mpd_zero);
+  m->fixed = conf->fixed_point;
+  m->fx_limit = fixed_pow10(FIXED_MAX_DIGITS - conf->fee_prec);
+
+  // 用户字典和订单字典，key和value都直接存放在表中
+  hashmap_types ht;
+  memset(&ht, 0, sizeof(ht));
+  ht.hash_function = dict_user_hash_function;
+  ht.val_destructor = dict_user_val_free;
+
+  m->users = hashmap_create(&ht, sizeof(struct dict_user_key),
+                            sizeof(skiplist_t *), 1024);
+  if (m->users == NULL)
+    return NULL;
 
-  dict_types dt;
-
-  // 用户字典
-  memset(&dt, 0, sizeof(dt));
-  dt.hash_function = dict_user_hash_function;
-  dt.key_compare = dict_user_key_compare;
-  dt.key_dup = dict_user_key_dup;
-  dt.key_destructor = dict_user_key_free;
-  dt.val_destructor = dict_user_val_free;
+  memset(&ht, 0, sizeof(ht));
+  ht.hash_function = dict_order_hash_function;
 
-  m->users = dict_create(&dt, 1024);
-  if (m->users == NULL)
+  m->orders = hashmap_create(&ht, sizeof(struct dict_order_key),
+                             sizeof(order_t *), 1024);
+  if (m->orders == NULL)
     return NULL;
 
-  //订单字典
+  dict_types dt;
+
+  //来源字典
   memset(&dt, 0, sizeof(dt));
-  dt.hash_function = dict_order_hash_function;
-  dt.key_compare = dict_order_key_compare;
-  dt.key_dup = dict_order_key_dup;
-  dt.key_destructor = dict_order_key_free;
+  dt.hash_function = dict_source_hash_function;
+  dt.key_compare = dict_source_key_compare;
+  dt.key_dup = dict_source_key_dup;
+  dt.key_destructor = dict_source_key_free;
 
-  m->orders = dict_create(&dt, 1024);
-  if (m->orders == NULL)
+  m->sources = dict_create(&dt, 16);
+  if (m->sources == NULL)
     return NULL;
 
-  // asks与bids列表
+  // asks与bids价位列表
   skiplist_type lt;
   memset(&lt, 0, sizeof(lt));
-  lt.compare = order_match_compare;
+  lt.compare = m->fixed ? price_level_compare_fixed : price_level_compare;
+  lt.free = price_level_free;
 
   m->asks = skiplist_create(&lt);
   m->bids = skiplist_create(&lt);
@@ -327,60 +653,27 @@ market_t *market_create(struct market *conf) {
 static int append_balance_trade_add(order_t *order, const char *asset,
                                     mpd_t *change, mpd_t *price,
                                     mpd_t *amount) {
-  json_t *detail = json_object();
-  json_object_set_new(detail, "m", json_string(order->market));
-  json_object_set_new(detail, "i", json_integer(order->id));
-  json_object_set_new_mpd(detail, "p", price);
-  json_object_set_new_mpd(detail, "a", amount);
-  char *detail_str = json_dumps(detail, JSON_SORT_KEYS);
-  int ret = append_user_balance_history(order->update_time, order->user_id,
-                                        asset, "trade", change, detail_str);
-  free(detail_str);
-  json_decref(detail);
-  return ret;
+  return append_user_balance_trade_history(
+      order->update_time, order->user_id, asset, false, change, order->market,
+      order->id, price, amount, NULL);
 }
 
 //保存历史记录
 static int append_balance_trade_sub(order_t *order, const char *asset,
                                     mpd_t *change, mpd_t *price,
                                     mpd_t *amount) {
-  json_t *detail = json_object();
-  json_object_set_new(detail, "m", json_string(order->market));
-  json_object_set_new(detail, "i", json_integer(order->id));
-  json_object_set_new_mpd(detail, "p", price);
-  json_object_set_new_mpd(detail, "a", amount);
-  char *detail_str = json_dumps(detail, JSON_SORT_KEYS);
-  mpd_t *real_change = mpd_new(&mpd_ctx);
-  mpd_copy_negate(real_change, change, &mpd_ctx);
-  int ret =
-      append_user_balance_history(order->update_time, order->user_id, asset,
-                                  "trade", real_change, detail_str);
-  mpd_del(real_change);
-  free(detail_str);
-  json_decref(detail);
-  return ret;
+  return append_user_balance_trade_history(
+      order->update_time, order->user_id, asset, true, change, order->market,
+      order->id, price, amount, NULL);
 }
 
 //保存历史记录
 static int append_balance_trade_fee(order_t *order, const char *asset,
                                     mpd_t *change, mpd_t *price, mpd_t *amount,
                                     mpd_t *fee_rate) {
-  json_t *detail = json_object();
-  json_object_set_new(detail, "m", json_string(order->market));
-  json_object_set_new(detail, "i", json_integer(order->id));
-  json_object_set_new_mpd(detail, "p", price);
-  json_object_set_new_mpd(detail, "a", amount);
-  json_object_set_new_mpd(detail, "f", fee_rate);
-  char *detail_str = json_dumps(detail, JSON_SORT_KEYS);
-  mpd_t *real_change = mpd_new(&mpd_ctx);
-  mpd_copy_negate(real_change, change, &mpd_ctx);
-  int ret =
-      append_user_balance_history(order->update_time, order->user_id, asset,
-                                  "trade", real_change, detail_str);
-  mpd_del(real_change);
-  free(detail_str);
-  json_decref(detail);
-  return ret;
+  return append_user_balance_trade_history(
+      order->update_time, order->user_id, asset, true, change, order->market,
+      order->id, price, amount, fee_rate);
 }
 
 //执行限价买单
@@ -394,16 +687,13 @@ static int execute_limit_ask_order(bool real, market_t *m, order_t *taker) {
   mpd_t *bid_fee = mpd_new(&mpd_ctx);
   mpd_t *result = mpd_new(&mpd_ctx);
 
-  //询价出价列表
-  skiplist_node *node;
-  skiplist_iter *iter = skiplist_get_iterator(m->bids);
+  //出价列表的最优订单
+  order_t *maker;
 
-  while ((node = skiplist_next(iter)) != NULL) {
+  while ((maker = book_head(m->bids)) != NULL) {
     if (mpd_cmp(taker->left, mpd_zero, &mpd_ctx) == 0) {
       break;
     }
-    // 从深度提供表取出一个maker
-    order_t *maker = node->value;
 
     if (mpd_cmp(taker->price, maker->price, &mpd_ctx) > 0) {
       //如果taker价格高于maker,跳过该maker
@@ -477,6 +767,7 @@ static int execute_limit_ask_order(bool real, market_t *m, order_t *taker) {
     /* maker */
     // 余量
     mpd_sub(maker->left, maker->left, amount, &mpd_ctx);
+    book_deal(m, maker, amount);
     // 冻结量
     mpd_sub(maker->freeze, maker->freeze, deal, &mpd_ctx);
     // 成交标的量
@@ -518,9 +809,6 @@ static int execute_limit_ask_order(bool real, market_t *m, order_t *taker) {
     }
   }
 
-  // 释放skiplist遍历器
-  skiplist_release_iterator(iter);
-
   // 释放参数变量
   mpd_del(amount);
   mpd_del(price);
@@ -541,14 +829,12 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker) {
   mpd_t *bid_fee = mpd_new(&mpd_ctx);
   mpd_t *result = mpd_new(&mpd_ctx);
 
-  skiplist_node *node;
-  skiplist_iter *iter = skiplist_get_iterator(m->asks);
-  while ((node = skiplist_next(iter)) != NULL) {
+  order_t *maker;
+  while ((maker = book_head(m->asks)) != NULL) {
     if (mpd_cmp(taker->left, mpd_zero, &mpd_ctx) == 0) {
       break;
     }
 
-    order_t *maker = node->value;
     if (mpd_cmp(taker->price, maker->price, &mpd_ctx) < 0) {
       break;
     }
@@ -597,6 +883,7 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker) {
     }
 
     mpd_sub(maker->left, maker->left, amount, &mpd_ctx);
+    book_deal(m, maker, amount);
     mpd_sub(maker->freeze, maker->freeze, amount, &mpd_ctx);
     mpd_add(maker->deal_stock, maker->deal_stock, amount, &mpd_ctx);
     mpd_add(maker->deal_money, maker->deal_money, deal, &mpd_ctx);
@@ -629,7 +916,6 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker) {
       }
     }
   }
-  skiplist_release_iterator(iter);
 
   mpd_del(amount);
   mpd_del(price);
@@ -641,6 +927,229 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker) {
   return 0;
 }
 
+//执行限价买单，定点数版本
+//价格、数量、费用均以整数计算，只在写历史、推送消息和更新余额时转为mpd_t
+static int execute_limit_ask_order_fixed(bool real, market_t *m,
+                                         order_t *taker) {
+  int deal_prec = m->money_prec + m->stock_prec;
+
+  mpd_t *price = mpd_new(&mpd_ctx);
+  mpd_t *amount = mpd_new(&mpd_ctx);
+  mpd_t *deal = mpd_new(&mpd_ctx);
+  mpd_t *ask_fee = mpd_new(&mpd_ctx);
+  mpd_t *bid_fee = mpd_new(&mpd_ctx);
+
+  order_t *maker;
+  while ((maker = book_head(m->bids)) != NULL) {
+    if (taker->fx_left == 0) {
+      break;
+    }
+
+    if (taker->fx_price > maker->fx_price) {
+      break;
+    }
+
+    int64_t fx_amount =
+        taker->fx_left < maker->fx_left ? taker->fx_left : maker->fx_left;
+    fixed_t fx_deal = (fixed_t)maker->fx_price * fx_amount;
+    fixed_t fx_ask_fee = fx_deal * taker->fx_taker_fee;
+    fixed_t fx_bid_fee = (fixed_t)fx_amount * maker->fx_maker_fee;
+
+    mpd_set_fixed(price, maker->fx_price, m->money_prec);
+    mpd_set_fixed(amount, fx_amount, m->stock_prec);
+    mpd_set_fixed(deal, fx_deal, deal_prec);
+    mpd_set_fixed(ask_fee, fx_ask_fee, deal_prec + m->fee_prec);
+    mpd_set_fixed(bid_fee, fx_bid_fee, m->stock_prec + m->fee_prec);
+
+    taker->update_time = maker->update_time = current_timestamp();
+    uint64_t deal_id = ++deals_id_start;
+    if (real) {
+      append_order_deal_history(taker->update_time, deal_id, taker,
+                                MARKET_ROLE_TAKER, maker, MARKET_ROLE_MAKER,
+                                price, amount, deal, ask_fee, bid_fee);
+      push_deal_message(taker->update_time, m->name, taker, maker, price,
+                        amount, ask_fee, bid_fee, MARKET_ORDER_SIDE_ASK,
+                        deal_id, m->stock, m->money);
+    }
+
+    taker->fx_left -= fx_amount;
+    taker->fx_deal_stock += fx_amount;
+    taker->fx_deal_money += fx_deal;
+    taker->fx_deal_fee += fx_ask_fee;
+    order_flush_fixed(m, taker, false);
+
+    balance_sub(taker->user_id, BALANCE_TYPE_AVAILABLE, m->stock, amount);
+    if (real) {
+      append_balance_trade_sub(taker, m->stock, amount, price, amount);
+    }
+    balance_add(taker->user_id, BALANCE_TYPE_AVAILABLE, m->money, deal);
+    if (real) {
+      append_balance_trade_add(taker, m->money, deal, price, amount);
+    }
+    if (fx_ask_fee > 0) {
+      balance_sub(taker->user_id, BALANCE_TYPE_AVAILABLE, m->money, ask_fee);
+      if (real) {
+        append_balance_trade_fee(taker, m->money, ask_fee, price, amount,
+                                 taker->taker_fee);
+      }
+    }
+
+    maker->fx_left -= fx_amount;
+    book_deal(m, maker, amount);
+    maker->fx_freeze -= fx_deal;
+    maker->fx_deal_stock += fx_amount;
+    maker->fx_deal_money += fx_deal;
+    maker->fx_deal_fee += fx_bid_fee;
+    order_flush_fixed(m, maker, true);
+
+    balance_sub(maker->user_id, BALANCE_TYPE_FREEZE, m->money, deal);
+    if (real) {
+      append_balance_trade_sub(maker, m->money, deal, price, amount);
+    }
+    balance_add(maker->user_id, BALANCE_TYPE_AVAILABLE, m->stock, amount);
+    if (real) {
+      append_balance_trade_add(maker, m->stock, amount, price, amount);
+    }
+    if (fx_bid_fee > 0) {
+      balance_sub(maker->user_id, BALANCE_TYPE_AVAILABLE, m->stock, bid_fee);
+      if (real) {
+        append_balance_trade_fee(maker, m->stock, bid_fee, price, amount,
+                                 maker->maker_fee);
+      }
+    }
+
+    if (maker->fx_left == 0) {
+      if (real) {
+        push_order_message(ORDER_EVENT_FINISH, maker, m);
+      }
+      order_finish(real, m, maker);
+    } else {
+      if (real) {
+        push_order_message(ORDER_EVENT_UPDATE, maker, m);
+      }
+    }
+  }
+
+  mpd_del(amount);
+  mpd_del(price);
+  mpd_del(deal);
+  mpd_del(ask_fee);
+  mpd_del(bid_fee);
+
+  return 0;
+}
+
+//执行限价卖单，定点数版本
+static int execute_limit_bid_order_fixed(bool real, market_t *m,
+                                         order_t *taker) {
+  int deal_prec = m->money_prec + m->stock_prec;
+
+  mpd_t *price = mpd_new(&mpd_ctx);
+  mpd_t *amount = mpd_new(&mpd_ctx);
+  mpd_t *deal = mpd_new(&mpd_ctx);
+  mpd_t *ask_fee = mpd_new(&mpd_ctx);
+  mpd_t *bid_fee = mpd_new(&mpd_ctx);
+
+  order_t *maker;
+  while ((maker = book_head(m->asks)) != NULL) {
+    if (taker->fx_left == 0) {
+      break;
+    }
+
+    if (taker->fx_price < maker->fx_price) {
+      break;
+    }
+
+    int64_t fx_amount =
+        taker->fx_left < maker->fx_left ? taker->fx_left : maker->fx_left;
+    fixed_t fx_deal = (fixed_t)maker->fx_price * fx_amount;
+    fixed_t fx_ask_fee = fx_deal * maker->fx_maker_fee;
+    fixed_t fx_bid_fee = (fixed_t)fx_amount * taker->fx_taker_fee;
+
+    mpd_set_fixed(price, maker->fx_price, m->money_prec);
+    mpd_set_fixed(amount, fx_amount, m->stock_prec);
+    mpd_set_fixed(deal, fx_deal, deal_prec);
+    mpd_set_fixed(ask_fee, fx_ask_fee, deal_prec + m->fee_prec);
+    mpd_set_fixed(bid_fee, fx_bid_fee, m->stock_prec + m->fee_prec);
+
+    taker->update_time = maker->update_time = current_timestamp();
+    uint64_t deal_id = ++deals_id_start;
+    if (real) {
+      append_order_deal_history(taker->update_time, deal_id, maker,
+                                MARKET_ROLE_MAKER, taker, MARKET_ROLE_TAKER,
+                                price, amount, deal, ask_fee, bid_fee);
+      push_deal_message(taker->update_time, m->name, maker, taker, price,
+                        amount, ask_fee, bid_fee, MARKET_ORDER_SIDE_BID,
+                        deal_id, m->stock, m->money);
+    }
+
+    taker->fx_left -= fx_amount;
+    taker->fx_deal_stock += fx_amount;
+    taker->fx_deal_money += fx_deal;
+    taker->fx_deal_fee += fx_bid_fee;
+    order_flush_fixed(m, taker, false);
+
+    balance_sub(taker->user_id, BALANCE_TYPE_AVAILABLE, m->money, deal);
+    if (real) {
+      append_balance_trade_sub(taker, m->money, deal, price, amount);
+    }
+    balance_add(taker->user_id, BALANCE_TYPE_AVAILABLE, m->stock, amount);
+    if (real) {
+      append_balance_trade_add(taker, m->stock, amount, price, amount);
+    }
+    if (fx_bid_fee > 0) {
+      balance_sub(taker->user_id, BALANCE_TYPE_AVAILABLE, m->stock, bid_fee);
+      if (real) {
+        append_balance_trade_fee(taker, m->stock, bid_fee, price, amount,
+                                 taker->taker_fee);
+      }
+    }
+
+    maker->fx_left -= fx_amount;
+    book_deal(m, maker, amount);
+    maker->fx_freeze -= fx_amount;
+    maker->fx_deal_stock += fx_amount;
+    maker->fx_deal_money += fx_deal;
+    maker->fx_deal_fee += fx_ask_fee;
+    order_flush_fixed(m, maker, true);
+
+    balance_sub(maker->user_id, BALANCE_TYPE_FREEZE, m->stock, amount);
+    if (real) {
+      append_balance_trade_sub(maker, m->stock, amount, price, amount);
+    }
+    balance_add(maker->user_id, BALANCE_TYPE_AVAILABLE, m->money, deal);
+    if (real) {
+      append_balance_trade_add(maker, m->money, deal, price, amount);
+    }
+    if (fx_ask_fee > 0) {
+      balance_sub(maker->user_id, BALANCE_TYPE_AVAILABLE, m->money, ask_fee);
+      if (real) {
+        append_balance_trade_fee(maker, m->money, ask_fee, price, amount,
+                                 maker->maker_fee);
+      }
+    }
+
+    if (maker->fx_left == 0) {
+      if (real) {
+        push_order_message(ORDER_EVENT_FINISH, maker, m);
+      }
+      order_finish(real, m, maker);
+    } else {
+      if (real) {
+        push_order_message(ORDER_EVENT_UPDATE, maker, m);
+      }
+    }
+  }
+
+  mpd_del(amount);
+  mpd_del(price);
+  mpd_del(deal);
+  mpd_del(ask_fee);
+  mpd_del(bid_fee);
+
+  return 0;
+}
+
 //将限价订单加入交易对撮合池
 int market_put_limit_order(bool real, json_t **result, market_t *m,
                            uint32_t user_id, uint32_t side, mpd_t *amount,
@@ -678,11 +1187,30 @@ int market_put_limit_order(bool real, json_t **result, market_t *m,
     return -2;
   }
 
-  // 创建订单对象
-  order_t *order = malloc(sizeof(order_t));
+  // 定点数撮合：检查数值范围，超出范围无法保证与高精度计算结果一致
+  int64_t fx_price = 0, fx_amount = 0, fx_taker_fee = 0, fx_maker_fee = 0;
+  if (m->fixed) {
+    if (get_fixed64(price, m->money_prec, &fx_price) < 0 ||
+        get_fixed64(amount, m->stock_prec, &fx_amount) < 0 ||
+        get_fixed64(taker_fee, m->fee_prec, &fx_taker_fee) < 0 ||
+        get_fixed64(maker_fee, m->fee_prec, &fx_maker_fee) < 0) {
+      return -3;
+    }
+    if ((fixed_t)fx_price * fx_amount >= m->fx_limit) {
+      return -3;
+    }
+  }
+
+  // 从订单池取出订单对象，交易对名称已绑定
+  order_t *order = market_alloc_order(m);
   if (order == NULL) {
     return -__LINE__;
   }
+  order->source = source_intern(m, source); // source
+  if (order->source == NULL) {
+    order_free(m, order);
+    return -__LINE__;
+  }
 
   // 绑定订单参数
   order->id = ++order_id_start;             // 订单id
@@ -690,21 +1218,8 @@ int market_put_limit_order(bool real, json_t **result, market_t *m,
   order->side = side;                       // 订单买入卖出
   order->create_time = current_timestamp(); // 时间戳
   order->update_time = order->create_time;  // 更新时间戳
-  order->market = strdup(m->name);          //交易对名称
-  order->source = strdup(source);           // source
   order->user_id = user_id;                 //用户id
 
-  // 订单高精度部分初始化
-  order->price = mpd_new(&mpd_ctx);      //价格
-  order->amount = mpd_new(&mpd_ctx);     //数量
-  order->taker_fee = mpd_new(&mpd_ctx);  // 拿走深度费用
-  order->maker_fee = mpd_new(&mpd_ctx);  //创建深度费用
-  order->left = mpd_new(&mpd_ctx);       //余额
-  order->freeze = mpd_new(&mpd_ctx);     //冻结
-  order->deal_stock = mpd_new(&mpd_ctx); //交易的标的
-  order->deal_money = mpd_new(&mpd_ctx); //交易的资金
-  order->deal_fee = mpd_new(&mpd_ctx);   //交易的费用
-
   // 订单高精度部分赋值
   mpd_copy(order->price, price, &mpd_ctx);
   mpd_copy(order->amount, amount, &mpd_ctx);
@@ -716,20 +1231,39 @@ int market_put_limit_order(bool real, json_t **result, market_t *m,
   mpd_copy(order->deal_money, mpd_zero, &mpd_ctx);
   mpd_copy(order->deal_fee, mpd_zero, &mpd_ctx);
 
+  // 订单定点数部分赋值
+  order->fx_price = fx_price;
+  order->fx_taker_fee = fx_taker_fee;
+  order->fx_maker_fee = fx_maker_fee;
+  order->fx_left = fx_amount;
+  order->fx_deal_stock = 0;
+  order->fx_freeze = 0;
+  order->fx_deal_money = 0;
+  order->fx_deal_fee = 0;
+
   // 处理结果
   int ret;
   if (side == MARKET_ORDER_SIDE_ASK) {
     //执行询价单
-    ret = execute_limit_ask_order(real, m, order);
+    if (m->fixed) {
+      ret = execute_limit_ask_order_fixed(real, m, order);
+    } else {
+      ret = execute_limit_ask_order(real, m, order);
+    }
   } else {
     //执行出价单
-    ret = execute_limit_bid_order(real, m, order);
+    if (m->fixed) {
+      ret = execute_limit_bid_order_fixed(real, m, order);
+    } else {
+      ret = execute_limit_bid_order(real, m, order);
+    }
   }
 
   if (ret < 0) {
     //执行失败
     log_error("execute order: %" PRIu64 " fail: %d", order->id, ret);
-    order_free(order);
+    order_free(m, order);
+    depth_flush(real, m);
     return -__LINE__;
   }
 
@@ -747,17 +1281,18 @@ int market_put_limit_order(bool real, json_t **result, market_t *m,
       // 查询订单消息
       *result = get_order_info(order);
     }
-    order_free(order);
+    order_free(m, order);
   } else {
     if (real) {
       push_order_message(ORDER_EVENT_PUT, order, m);
       *result = get_order_info(order);
     }
-    ret = order_put(m, order);
+    ret = order_put(m, order, true);
     if (ret < 0) {
       log_fatal("order_put fail: %d, order: %" PRIu64 "", ret, order->id);
     }
   }
+  depth_flush(real, m);
 
   return 0;
 }
@@ -772,16 +1307,14 @@ static int execute_market_ask_order(bool real, market_t *m, order_t *taker) {
   mpd_t *result = mpd_new(&mpd_ctx);
 
   // 变量列表
-  skiplist_node *node;
-  skiplist_iter *iter = skiplist_get_iterator(m->bids);
-  while ((node = skiplist_next(iter)) != NULL) {
+  order_t *maker;
+  while ((maker = book_head(m->bids)) != NULL) {
 
     // 如果taker的余量为0，跳过taker
     if (mpd_cmp(taker->left, mpd_zero, &mpd_ctx) == 0) {
       break;
     }
 
-    order_t *maker = node->value;
 
     // 成交价格：maker的价格
     mpd_copy(price, maker->price, &mpd_ctx);
@@ -800,6 +1333,20 @@ static int execute_market_ask_order(bool real, market_t *m, order_t *taker) {
     // bid方费用
     mpd_mul(bid_fee, amount, maker->maker_fee, &mpd_ctx);
 
+    // 定点数撮合：成交前检查maker的定点数镜像能否同步，
+    // 之前的成交已生效，超出范围时按部分成交结束
+    int64_t fx_amount = 0;
+    fixed_t fx_deal = 0, fx_fee = 0;
+    if (m->fixed) {
+      int ret = order_deal_fixed(m, maker, amount, deal, bid_fee, &fx_amount,
+                                 &fx_deal, &fx_fee);
+      if (ret < 0) {
+        log_error("order: %" PRIu64 " deal out of fixed point range: %d",
+                  maker->id, ret);
+        break;
+      }
+    }
+
     taker->update_time = maker->update_time = current_timestamp();
 
     // 成交id
@@ -840,10 +1387,18 @@ static int execute_market_ask_order(bool real, market_t *m, order_t *taker) {
 
     /* maker方处理事项 */
     mpd_sub(maker->left, maker->left, amount, &mpd_ctx);
+    book_deal(m, maker, amount);
     mpd_sub(maker->freeze, maker->freeze, deal, &mpd_ctx);
     mpd_add(maker->deal_stock, maker->deal_stock, amount, &mpd_ctx);
     mpd_add(maker->deal_money, maker->deal_money, deal, &mpd_ctx);
     mpd_add(maker->deal_fee, maker->deal_fee, bid_fee, &mpd_ctx);
+    if (m->fixed) {
+      maker->fx_left -= fx_amount;
+      maker->fx_freeze -= fx_deal;
+      maker->fx_deal_stock += fx_amount;
+      maker->fx_deal_money += fx_deal;
+      maker->fx_deal_fee += fx_fee;
+    }
 
     balance_sub(maker->user_id, BALANCE_TYPE_FREEZE, m->money, deal);
     if (real) {
@@ -872,7 +1427,6 @@ static int execute_market_ask_order(bool real, market_t *m, order_t *taker) {
       }
     }
   }
-  skiplist_release_iterator(iter);
 
   mpd_del(amount);
   mpd_del(price);
@@ -893,14 +1447,12 @@ static int execute_market_bid_order(bool real, market_t *m, order_t *taker) {
   mpd_t *bid_fee = mpd_new(&mpd_ctx);
   mpd_t *result = mpd_new(&mpd_ctx);
 
-  skiplist_node *node;
-  skiplist_iter *iter = skiplist_get_iterator(m->asks);
-  while ((node = skiplist_next(iter)) != NULL) {
+  order_t *maker;
+  while ((maker = book_head(m->asks)) != NULL) {
     if (mpd_cmp(taker->left, mpd_zero, &mpd_ctx) == 0) {
       break;
     }
 
-    order_t *maker = node->value;
     mpd_copy(price, maker->price, &mpd_ctx);
 
     mpd_div(amount, taker->left, price, &mpd_ctx);
@@ -927,6 +1479,18 @@ static int execute_market_bid_order(bool real, market_t *m, order_t *taker) {
     mpd_mul(ask_fee, deal, maker->maker_fee, &mpd_ctx);
     mpd_mul(bid_fee, amount, taker->taker_fee, &mpd_ctx);
 
+    int64_t fx_amount = 0;
+    fixed_t fx_deal = 0, fx_fee = 0;
+    if (m->fixed) {
+      int ret = order_deal_fixed(m, maker, amount, deal, ask_fee, &fx_amount,
+                                 &fx_deal, &fx_fee);
+      if (ret < 0) {
+        log_error("order: %" PRIu64 " deal out of fixed point range: %d",
+                  maker->id, ret);
+        break;
+      }
+    }
+
     taker->update_time = maker->update_time = current_timestamp();
     uint64_t deal_id = ++deals_id_start;
     if (real) {
@@ -960,10 +1524,18 @@ static int execute_market_bid_order(bool real, market_t *m, order_t *taker) {
     }
 
     mpd_sub(maker->left, maker->left, amount, &mpd_ctx);
+    book_deal(m, maker, amount);
     mpd_sub(maker->freeze, maker->freeze, amount, &mpd_ctx);
     mpd_add(maker->deal_stock, maker->deal_stock, amount, &mpd_ctx);
     mpd_add(maker->deal_money, maker->deal_money, deal, &mpd_ctx);
     mpd_add(maker->deal_fee, maker->deal_fee, ask_fee, &mpd_ctx);
+    if (m->fixed) {
+      maker->fx_left -= fx_amount;
+      maker->fx_freeze -= fx_amount;
+      maker->fx_deal_stock += fx_amount;
+      maker->fx_deal_money += fx_deal;
+      maker->fx_deal_fee += fx_fee;
+    }
 
     balance_sub(maker->user_id, BALANCE_TYPE_FREEZE, m->stock, amount);
     if (real) {
@@ -992,7 +1564,6 @@ static int execute_market_bid_order(bool real, market_t *m, order_t *taker) {
       }
     }
   }
-  skiplist_release_iterator(iter);
 
   mpd_del(amount);
   mpd_del(price);
@@ -1014,13 +1585,9 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
       return -1;
     }
 
-    skiplist_iter *iter = skiplist_get_iterator(m->bids);
-    skiplist_node *node = skiplist_next(iter);
-    if (node == NULL) {
-      skiplist_release_iterator(iter);
+    if (book_head(m->bids) == NULL) {
       return -3;
     }
-    skiplist_release_iterator(iter);
 
     if (mpd_cmp(amount, m->min_amount, &mpd_ctx) < 0) {
       return -2;
@@ -1031,15 +1598,11 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
       return -1;
     }
 
-    skiplist_iter *iter = skiplist_get_iterator(m->asks);
-    skiplist_node *node = skiplist_next(iter);
-    if (node == NULL) {
-      skiplist_release_iterator(iter);
+    order_t *order = book_head(m->asks);
+    if (order == NULL) {
       return -3;
     }
-    skiplist_release_iterator(iter);
 
-    order_t *order = node->value;
     mpd_t *require = mpd_new(&mpd_ctx);
     mpd_mul(require, order->price, m->min_amount, &mpd_ctx);
     if (mpd_cmp(amount, require, &mpd_ctx) < 0) {
@@ -1049,28 +1612,39 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
     mpd_del(require);
   }
 
-  order_t *order = malloc(sizeof(order_t));
+  // 定点数撮合：成交前检查taker的数值范围，撮合中途不能再失败
+  if (m->fixed) {
+    int64_t fx_amount, fx_taker_fee;
+    int amount_prec =
+        side == MARKET_ORDER_SIDE_ASK ? m->stock_prec : m->money_prec;
+    if (get_fixed64(amount, amount_prec, &fx_amount) < 0 ||
+        get_fixed64(taker_fee, m->fee_prec, &fx_taker_fee) < 0) {
+      return -4;
+    }
+    // 卖单的成交额不超过 数量 * 最优买价
+    order_t *head = book_head(m->bids);
+    if (side == MARKET_ORDER_SIDE_ASK &&
+        (fixed_t)head->fx_price * fx_amount >= m->fx_limit) {
+      return -4;
+    }
+  }
+
+  order_t *order = market_alloc_order(m);
   if (order == NULL) {
     return -__LINE__;
   }
+  order->source = source_intern(m, source);
+  if (order->source == NULL) {
+    order_free(m, order);
+    return -__LINE__;
+  }
 
   order->id = ++order_id_start;
   order->type = MARKET_ORDER_TYPE_MARKET;
   order->side = side;
   order->create_time = current_timestamp();
   order->update_time = order->create_time;
-  order->market = strdup(m->name);
-  order->source = strdup(source);
   order->user_id = user_id;
-  order->price = mpd_new(&mpd_ctx);
-  order->amount = mpd_new(&mpd_ctx);
-  order->taker_fee = mpd_new(&mpd_ctx);
-  order->maker_fee = mpd_new(&mpd_ctx);
-  order->left = mpd_new(&mpd_ctx);
-  order->freeze = mpd_new(&mpd_ctx);
-  order->deal_stock = mpd_new(&mpd_ctx);
-  order->deal_money = mpd_new(&mpd_ctx);
-  order->deal_fee = mpd_new(&mpd_ctx);
 
   mpd_copy(order->price, mpd_zero, &mpd_ctx);
   mpd_copy(order->amount, amount, &mpd_ctx);
@@ -1088,9 +1662,10 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
   } else {
     ret = execute_market_bid_order(real, m, order);
   }
+  depth_flush(real, m);
   if (ret < 0) {
     log_error("execute order: %" PRIu64 " fail: %d", order->id, ret);
-    order_free(order);
+    order_free(m, order);
     return -__LINE__;
   }
 
@@ -1104,7 +1679,7 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
     *result = get_order_info(order);
   }
 
-  order_free(order);
+  order_free(m, order);
   return 0;
 }
 
@@ -1116,11 +1691,87 @@ int market_cancel_order(bool real, json_t **result, market_t *m,
     *result = get_order_info(order);
   }
   order_finish(real, m, order);
+  depth_flush(real, m);
   return 0;
 }
 
+//撤单并推送消息，批量撤单时盘口变动在结束时一次推送
+static int cancel_order(bool real, market_t *m, order_t *order) {
+  if (real) {
+    push_order_message(ORDER_EVENT_FINISH, order, m);
+  }
+  return order_finish(real, m, order);
+}
+
+//撤销用户在该交易对的全部挂单，side为0时不区分买卖方向
+int market_cancel_user_orders(bool real, market_t *m, uint32_t user_id,
+                              uint32_t side, size_t limit, size_t *count) {
+  *count = 0;
+  skiplist_t *order_list = market_get_order_list(m, user_id);
+  if (order_list == NULL)
+    return 0;
+
+  int ret = 0;
+  skiplist_node *node = order_list->header->forward[0];
+  while (node && (limit == 0 || *count < limit)) {
+    // order_finish只删除当前节点，先取下一个
+    skiplist_node *next = node->forward[0];
+    order_t *order = node->value;
+    if (side == 0 || order->side == side) {
+      ret = cancel_order(real, m, order);
+      if (ret < 0)
+        break;
+      *count += 1;
+    }
+    node = next;
+  }
+  depth_flush(real, m);
+  return ret;
+}
+
+//撤销交易对的全部挂单，按价位从优到劣、同价位按时间先后
+int market_cancel_all_orders(bool real, market_t *m, uint32_t side,
+                             size_t limit, size_t *count) {
+  *count = 0;
+  int ret = 0;
+  for (int i = 0; i < 2 && ret == 0; ++i) {
+    uint32_t book_side =
+        i == 0 ? MARKET_ORDER_SIDE_ASK : MARKET_ORDER_SIDE_BID;
+    if (side != 0 && side != book_side)
+      continue;
+    skiplist_t *book = book_side == MARKET_ORDER_SIDE_ASK ? m->asks : m->bids;
+    // 价位的最后一个订单撤销后价位被删除，每次都从表头取
+    skiplist_node *node;
+    while ((node = book->header->forward[0]) != NULL) {
+      if (limit && *count >= limit)
+        break;
+      price_level_t *level = node->value;
+      ret = cancel_order(real, m, level->head);
+      if (ret < 0)
+        break;
+      *count += 1;
+    }
+  }
+  depth_flush(real, m);
+  return ret;
+}
+
+//加入订单，之后调用方不再持有订单，定点数范围检查失败时订单放回订单池
 int market_put_order(market_t *m, order_t *order) {
-  return order_put(m, order);
+  int ret;
+  if (m->fixed) {
+    ret = order_load_fixed(m, order);
+    if (ret < 0) {
+      log_error("order: %" PRIu64 " out of fixed point range: %d", order->id,
+                ret);
+      order_free(m, order);
+      return ret;
+    }
+  }
+  // 载入时余额在订单之后载入，冻结量以载入的余额为准
+  ret = order_put(m, order, false);
+  depth_flush(false, m); //载入切片不推送盘口变动
+  return ret;
 }
 
 //查询订单
@@ -1129,10 +1780,10 @@ order_t *market_get_order(market_t *m, uint64_t order_id) {
   //字典的键
   struct dict_order_key key = {.order_id = order_id};
   // 根据订单id从订单表里查找
-  dict_entry *entry = dict_find(m->orders, &key);
-  if (entry) {
+  order_t **val = hashmap_find(m->orders, &key);
+  if (val) {
     //如果找到，返回数据
-    return entry->val;
+    return *val;
   }
   return NULL;
 }
@@ -1141,9 +1792,9 @@ order_t *market_get_order(market_t *m, uint64_t order_id) {
 skiplist_t *market_get_order_list(market_t *m, uint32_t user_id) {
   struct dict_user_key key = {.user_id = user_id};
   // 根据用户id从用户表里查找
-  dict_entry *entry = dict_find(m->users, &key);
-  if (entry) {
-    return entry->val;
+  skiplist_t **val = hashmap_find(m->users, &key);
+  if (val) {
+    return *val;
   }
   return NULL;
 }
@@ -1151,24 +1802,10 @@ skiplist_t *market_get_order_list(market_t *m, uint32_t user_id) {
 //查询交易对撮合池状态
 int market_get_status(market_t *m, size_t *ask_count, mpd_t *ask_amount,
                       size_t *bid_count, mpd_t *bid_amount) {
-  *ask_count = m->asks->len;
-  *bid_count = m->bids->len;
-  mpd_copy(ask_amount, mpd_zero, &mpd_ctx);
-  mpd_copy(bid_amount, mpd_zero, &mpd_ctx);
-
-  skiplist_node *node;
-  skiplist_iter *iter = skiplist_get_iterator(m->asks);
-  while ((node = skiplist_next(iter)) != NULL) {
-    order_t *order = node->value;
-    mpd_add(ask_amount, ask_amount, order->left, &mpd_ctx);
-  }
-  skiplist_release_iterator(iter);
-
-  iter = skiplist_get_iterator(m->bids);
-  while ((node = skiplist_next(iter)) != NULL) {
-    order_t *order = node->value;
-    mpd_add(bid_amount, bid_amount, order->left, &mpd_ctx);
-  }
+  *ask_count = m->ask_count;
+  *bid_count = m->bid_count;
+  mpd_copy(ask_amount, m->ask_amount, &mpd_ctx);
+  mpd_copy(bid_amount, m->bid_amount, &mpd_ctx);
 
   return 0;
 }
@@ -1177,5 +1814,14 @@ int market_get_status(market_t *m, size_t *ask_count, mpd_t *ask_amount,
 sds market_status(sds reply) {
   reply = sdscatprintf(reply, "order last ID: %" PRIu64 "\n", order_id_start);
   reply = sdscatprintf(reply, "deals last ID: %" PRIu64 "\n", deals_id_start);
+  for (size_t i = 0; i < settings.market_num; ++i) {
+    market_t *m = get_market(settings.markets[i].name);
+    if (m == NULL)
+      continue;
+    reply = sdscatprintf(reply,
+                         "%s order pool: %zu used, %zu allocated, %u sources\n",
+                         m->name, m->order_pool_used, m->order_pool_size,
+                         dict_size(m->sources));
+  }
   return reply;
 }
@@ -11,6 +11,12 @@
 extern uint64_t order_id_start;
 extern uint64_t deals_id_start;
 
+struct price_level_t;
+
+// 订单高精度字段的内联存储：字段数和每个字段的字数(每字19位十进制)
+#define ORDER_MPD_NUM 9
+#define ORDER_MPD_WORDS 4
+
 // 订单
 typedef struct order_t {
   uint64_t id;
@@ -32,8 +38,46 @@ typedef struct order_t {
   mpd_t *deal_stock;
   mpd_t *deal_money;
   mpd_t *deal_fee;
+
+  // 定点数镜像，交易对开启fixed_point时有效，数值为 value * 10^prec
+  int64_t fx_price;      // money_prec
+  int64_t fx_taker_fee;  // fee_prec
+  int64_t fx_maker_fee;  // fee_prec
+  int64_t fx_left;       // stock_prec
+  int64_t fx_deal_stock; // stock_prec
+  fixed_t fx_freeze;     // ask: stock_prec, bid: money_prec + stock_prec
+  fixed_t fx_deal_money; // money_prec + stock_prec
+  fixed_t fx_deal_fee; // ask: money_prec + stock_prec + fee_prec, bid: stock_prec + fee_prec
+
+  // 所在价位的先进先出队列，在订单池中时next为空闲链表
+  struct price_level_t *level;
+  struct order_t *prev;
+  struct order_t *next;
+
+  // 高精度字段的内联存储，price等指针指向这里
+  mpd_t mpd[ORDER_MPD_NUM];
+  mpd_uint_t mpd_data[ORDER_MPD_NUM][ORDER_MPD_WORDS];
 } order_t;
 
+// 价位：同一价格的挂单按时间先后排队
+typedef struct price_level_t {
+  uint32_t side;
+  mpd_t *price;
+  int64_t fx_price; // money_prec，交易对开启fixed_point时有效
+  mpd_t *amount;    // 该价位挂单余量之和
+  size_t count;     // 该价位挂单数
+  size_t depth_index; // 在本次操作盘口变动中的位置+1，0表示未变动
+  order_t *head;
+  order_t *tail;
+} price_level_t;
+
+// 盘口变动，价位被删除后level为空，price为删除前价格的拷贝
+typedef struct depth_change {
+  uint32_t side;
+  price_level_t *level;
+  mpd_t *price;
+} depth_change;
+
 // 交易对
 typedef struct market_t {
   // 交易对基本参数
@@ -47,15 +91,40 @@ typedef struct market_t {
   int fee_prec;
   mpd_t *min_amount;
 
+  // 定点数撮合
+  bool fixed;
+  fixed_t fx_limit; // price * amount 的上限，保证手续费不超过34位有效数字
+
   // 订单表
-  dict_t *orders;
+  hashmap_t *orders;
   // 用户表
-  dict_t *users;
+  hashmap_t *users;
 
-  // 询价表
+  // 询价表，价位按价格从低到高
   skiplist_t *asks;
-  // 出价表
+  // 出价表，价位按价格从高到低
   skiplist_t *bids;
+  // 挂单数
+  size_t ask_count;
+  size_t bid_count;
+  // 挂单余量之和，随挂单、成交、撤单增量维护
+  mpd_t *ask_amount;
+  mpd_t *bid_amount;
+
+  // 盘口变动序号，每推送一次盘口变动消息加1
+  uint64_t depth_seq;
+  // 本次操作中变动的价位，操作结束时合并推送
+  depth_change *depth_changes;
+  size_t depth_change_num;
+  size_t depth_change_max;
+  bool depth_lost; // 记录变动失败，推送时跳过一个序号使订阅方重新同步
+
+  // 订单池
+  order_t *order_free_list;
+  size_t order_pool_size; // 已分配的订单对象数
+  size_t order_pool_used; // 使用中的订单对象数
+  // 订单来源字符串，值为引用计数
+  dict_t *sources;
 } market_t;
 
 market_t *market_create(struct market *conf);
@@ -71,7 +140,14 @@ int market_put_market_order(bool real, json_t **result, market_t *m,
                             mpd_t *taker_fee, const char *source);
 int market_cancel_order(bool real, json_t **result, market_t *m,
                         order_t *order);
-
+// 批量撤单，side为0时不区分买卖方向，limit不为0时最多撤limit个，count返回撤单数
+int market_cancel_user_orders(bool real, market_t *m, uint32_t user_id,
+                              uint32_t side, size_t limit, size_t *count);
+int market_cancel_all_orders(bool real, market_t *m, uint32_t side,
+                             size_t limit, size_t *count);
+
+order_t *market_alloc_order(market_t *m);
+void market_free_order(market_t *m, order_t *order);
 int market_put_order(market_t *m, order_t *order);
 
 json_t *get_order_info(order_t *order);
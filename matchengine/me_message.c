@@ -13,10 +13,12 @@ static rd_kafka_t *rk;
 static rd_kafka_topic_t *rkt_deals;    //交易topic通道
 static rd_kafka_topic_t *rkt_orders;   //订单topic通道
 static rd_kafka_topic_t *rkt_balances; //账户topic通道
+static rd_kafka_topic_t *rkt_depth;    //盘口变动topic通道
 
 static list_t *list_deals;    //交易列表
 static list_t *list_orders;   //订单列表
 static list_t *list_balances; //账户列表
+static list_t *list_depth;    //盘口变动列表
 
 static nw_timer timer; //计时器
 
@@ -77,6 +79,10 @@ static void on_timer(nw_timer *t, void *privdata)
     {
         produce_list(list_deals, rkt_deals);
     }
+    if (list_depth->len)
+    {
+        produce_list(list_depth, rkt_depth);
+    }
 
     rd_kafka_poll(rk, 0);
 }
@@ -130,6 +136,12 @@ int init_message(void)
         log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
         return -__LINE__;
     }
+    rkt_depth = rd_kafka_topic_new(rk, "depth", NULL); //新建盘口变动topic
+    if (rkt_depth == NULL)
+    {
+        log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
+        return -__LINE__;
+    }
 
     list_type lt;
     memset(&lt, 0, sizeof(lt));
@@ -144,6 +156,9 @@ int init_message(void)
     list_balances = list_create(&lt); //创建账户list
     if (list_balances == NULL)
         return -__LINE__;
+    list_depth = list_create(&lt); //创建盘口变动list
+    if (list_depth == NULL)
+        return -__LINE__;
 
     nw_timer_set(&timer, 0.1, true, on_timer, NULL);
     nw_timer_start(&timer);
@@ -160,6 +175,7 @@ int fini_message(void)
     rd_kafka_topic_destroy(rkt_balances);
     rd_kafka_topic_destroy(rkt_orders);
     rd_kafka_topic_destroy(rkt_deals);
+    rd_kafka_topic_destroy(rkt_depth);
     rd_kafka_destroy(rk);
 
     return 0;
@@ -259,6 +275,21 @@ int push_deal_message(double t, const char *market, order_t *ask, order_t *bid,
     return 0;
 }
 
+//推送盘口变动消息，asks和bids为本次变动价位的[价格, 余量]，余量为0表示价位删除
+int push_depth_message(market_t *market, json_t *asks, json_t *bids)
+{
+    json_t *message = json_object();
+    json_object_set_new(message, "market", json_string(market->name));
+    json_object_set_new(message, "seq", json_integer(market->depth_seq));
+    json_object_set(message, "asks", asks);
+    json_object_set(message, "bids", bids);
+
+    push_message(json_dumps(message, 0), rkt_depth, list_depth);
+    json_decref(message);
+
+    return 0;
+}
+
 //消息是否阻塞
 bool is_message_block(void)
 {
@@ -268,6 +299,8 @@ bool is_message_block(void)
         return true;
     if (list_balances->len >= MAX_PENDING_MESSAGE)
         return true;
+    if (list_depth->len >= MAX_PENDING_MESSAGE)
+        return true;
 
     return false;
 }
@@ -278,5 +311,6 @@ sds message_status(sds reply)
     reply = sdscatprintf(reply, "message deals pending: %lu\n", list_deals->len);
     reply = sdscatprintf(reply, "message orders pending: %lu\n", list_orders->len);
     reply = sdscatprintf(reply, "message balances pending: %lu\n", list_balances->len);
+    reply = sdscatprintf(reply, "message depth pending: %lu\n", list_depth->len);
     return reply;
 }
@@ -22,6 +22,7 @@ int push_balance_message(double t, uint32_t user_id, const char *asset, const ch
 int push_order_message(uint32_t event, order_t *order, market_t *market);
 int push_deal_message(double t, const char *market, order_t *ask, order_t *bid, mpd_t *price, mpd_t *amount,
         mpd_t *ask_fee, mpd_t *bid_fee, int side, uint64_t id, const char *stock, const char *money);
+int push_depth_message(market_t *market, json_t *asks, json_t *bids);
 
 bool is_message_block(void);
 sds message_status(sds reply);
@@ -7,8 +7,13 @@
 *   操作历史记录
 */
 
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
 #include "me_config.h"
 #include "me_operlog.h"
+#include "ut_crc32.h"
 
 uint64_t operlog_id_start;
 
@@ -17,6 +22,11 @@ static nw_job *job;
 static list_t *list;
 static nw_timer timer;
 
+// 本地操作日志，按组提交写入文件
+static sds file_buf;
+static nw_job *file_job;
+static nw_timer file_timer;
+
 struct operlog
 {
     uint64_t id;
@@ -57,6 +67,90 @@ static void on_job_release(void *privdata)
     mysql_close(privdata);
 }
 
+struct operlog_batch
+{
+    sds name;
+    sds data;
+};
+
+struct operlog_file
+{
+    int fd;
+    sds name;
+};
+
+static void *on_file_job_init(void)
+{
+    struct operlog_file *file = malloc(sizeof(struct operlog_file));
+    if (file == NULL)
+        return NULL;
+    file->fd = -1;
+    file->name = sdsempty();
+    return file;
+}
+
+static void on_file_job(nw_job_entry *entry, void *privdata)
+{
+    struct operlog_file *file = privdata;
+    struct operlog_batch *batch = entry->request;
+
+    // 跨天切换到新的文件
+    if (file->fd >= 0 && sdscmp(file->name, batch->name) != 0)
+    {
+        close(file->fd);
+        file->fd = -1;
+    }
+    while (file->fd < 0)
+    {
+        file->fd = open(batch->name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (file->fd < 0)
+        {
+            log_fatal("open operlog file: %s fail: %d %s", batch->name, errno, strerror(errno));
+            usleep(1000 * 1000);
+            continue;
+        }
+        file->name = sdscpy(file->name, batch->name);
+    }
+
+    size_t pos = 0;
+    size_t len = sdslen(batch->data);
+    while (pos < len)
+    {
+        ssize_t ret = write(file->fd, batch->data + pos, len - pos);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            log_fatal("write operlog file: %s fail: %d %s", file->name, errno, strerror(errno));
+            usleep(1000 * 1000);
+            continue;
+        }
+        pos += ret;
+    }
+
+    if (settings.operlog_fsync && fdatasync(file->fd) != 0)
+    {
+        log_fatal("sync operlog file: %s fail: %d %s", file->name, errno, strerror(errno));
+    }
+}
+
+static void on_file_job_cleanup(nw_job_entry *entry)
+{
+    struct operlog_batch *batch = entry->request;
+    sdsfree(batch->name);
+    sdsfree(batch->data);
+    free(batch);
+}
+
+static void on_file_job_release(void *privdata)
+{
+    struct operlog_file *file = privdata;
+    if (file->fd >= 0)
+        close(file->fd);
+    sdsfree(file->name);
+    free(file);
+}
+
 static void on_list_free(void *value)
 {
     struct operlog *log = value;
@@ -86,7 +180,7 @@ static void flush_log(void)
     }
 
     sds sql = sdsempty();
-    sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `time`, `detail`) VALUES ", table);
+    sql = sdscatprintf(sql, "INSERT IGNORE INTO `%s` (`id`, `time`, `detail`) VALUES ", table);
     sdsfree(table);
 
     size_t count = 0;
@@ -119,6 +213,47 @@ static void on_timer(nw_timer *t, void *privdata)
     }
 }
 
+// 把一批记录交给写文件线程
+static void flush_file(void)
+{
+    struct operlog_batch *batch = malloc(sizeof(struct operlog_batch));
+    batch->name = operlog_file_name(sdsempty(), time(NULL));
+    batch->data = file_buf;
+    file_buf = sdsempty();
+    nw_job_add(file_job, 0, batch);
+}
+
+static void on_file_timer(nw_timer *t, void *privdata)
+{
+    if (sdslen(file_buf) > 0)
+    {
+        flush_file();
+    }
+}
+
+static int init_operlog_file(void)
+{
+    if (mkdir(settings.operlog_path, 0755) != 0 && errno != EEXIST)
+        return -__LINE__;
+
+    nw_job_type type;
+    memset(&type, 0, sizeof(type));
+    type.on_init = on_file_job_init;
+    type.on_job = on_file_job;
+    type.on_cleanup = on_file_job_cleanup;
+    type.on_release = on_file_job_release;
+
+    file_job = nw_job_create(&type, 1);
+    if (file_job == NULL)
+        return -__LINE__;
+
+    file_buf = sdsempty();
+    nw_timer_set(&file_timer, settings.operlog_flush_interval, true, on_file_timer, NULL);
+    nw_timer_start(&file_timer);
+
+    return 0;
+}
+
 int init_operlog(void)
 {
     mysql_conn = mysql_init(NULL);
@@ -148,40 +283,131 @@ int init_operlog(void)
     nw_timer_set(&timer, 0.1, true, on_timer, NULL);
     nw_timer_start(&timer);
 
+    if (settings.operlog_path[0])
+    {
+        int ret = init_operlog_file();
+        if (ret < 0)
+            return ret;
+    }
+
     return 0;
 }
 
 int fini_operlog(void)
 {
     on_timer(NULL, NULL);
+    if (file_job)
+    {
+        on_file_timer(NULL, NULL);
+        while (file_job->request_count > 0)
+        {
+            usleep(10 * 1000);
+        }
+    }
 
     usleep(100 * 1000);
     nw_job_release(job);
     mysql_close(mysql_conn);
+    if (file_job)
+    {
+        nw_job_release(file_job);
+    }
 
     return 0;
 }
 
+sds operlog_file_name(sds name, time_t t)
+{
+    struct tm *tm = localtime(&t);
+    return sdscatprintf(name, "%s/operlog_%04d%02d%02d.bin", settings.operlog_path, 1900 + tm->tm_year, 1 + tm->tm_mon, tm->tm_mday);
+}
+
+uint32_t operlog_record_crc(const char *data, size_t len)
+{
+    size_t offset = offsetof(struct operlog_record, id);
+    return generate_crc32c(data + offset, sizeof(struct operlog_record) - offset + len);
+}
+
+// 编码一条记录追加到待写文件的缓冲
+static void append_file(struct operlog *log)
+{
+    struct operlog_record record;
+    record.len = strlen(log->detail);
+    record.crc = 0;
+    record.id = log->id;
+    record.time = log->create_time;
+
+    size_t offset = sdslen(file_buf);
+    file_buf = sdscatlen(file_buf, &record, sizeof(record));
+    file_buf = sdscatlen(file_buf, log->detail, record.len);
+    record.crc = operlog_record_crc(file_buf + offset, record.len);
+    memcpy(file_buf + offset + offsetof(struct operlog_record, crc), &record.crc, sizeof(record.crc));
+}
+
+// 批量命令执行期间的操作，结束时合并为一条batch记录
+static __thread json_t *batch_opers;
+
+void operlog_batch_begin(void)
+{
+    batch_opers = json_array();
+}
+
+int operlog_batch_end(void)
+{
+    json_t *opers = batch_opers;
+    batch_opers = NULL;
+    int ret = 0;
+    if (json_array_size(opers) > 0)
+        ret = append_operlog("batch", opers);
+    json_decref(opers);
+    return ret;
+}
+
 int append_operlog(const char *method, json_t *params)
 {
     json_t *detail = json_object();
     json_object_set_new(detail, "method", json_string(method));
     json_object_set(detail, "params", params);
+    if (batch_opers)
+    {
+        json_array_append_new(batch_opers, detail);
+        return 0;
+    }
     struct operlog *log = malloc(sizeof(struct operlog));
     log->id = ++operlog_id_start;
     log->create_time = current_timestamp();
     log->detail = json_dumps(detail, JSON_SORT_KEYS);
     json_decref(detail);
+    if (file_job)
+    {
+        append_file(log);
+    }
     list_add_node_tail(list, log);
     log_debug("add log: %s", log->detail);
 
     return 0;
 }
 
+// 重放本地文件时，把MySQL中还没有的记录补发过去
+int reship_operlog(uint64_t id, double create_time, const char *detail)
+{
+    struct operlog *log = malloc(sizeof(struct operlog));
+    if (log == NULL)
+        return -__LINE__;
+    log->id = id;
+    log->create_time = create_time;
+    log->detail = strdup(detail);
+    list_add_node_tail(list, log);
+
+    return 0;
+}
+
 bool is_operlog_block(void)
 {
     if (job->request_count >= MAX_PENDING_OPERLOG)
         return true;
+    if (file_job && file_job->request_count >= MAX_PENDING_OPERLOG)
+        return true;
     return false;
 }
 
@@ -189,5 +415,9 @@ sds operlog_status(sds reply)
 {
     reply = sdscatprintf(reply, "operlog last ID: %" PRIu64 "\n", operlog_id_start);
     reply = sdscatprintf(reply, "operlog pending: %d\n", job->request_count);
+    if (file_job)
+    {
+        reply = sdscatprintf(reply, "operlog file pending: %d\n", file_job->request_count);
+    }
     return reply;
 }
@@ -10,10 +10,28 @@
 
 extern uint64_t operlog_id_start;
 
+// 本地操作日志记录头，后接len字节的detail；crc覆盖id、time与detail
+struct operlog_record
+{
+    uint32_t len;
+    uint32_t crc;
+    uint64_t id;
+    double time;
+};
+
+# define OPERLOG_RECORD_MAX_LEN (64 * 1024 * 1024)
+
 int init_operlog(void);
 int fini_operlog(void);
 
 int append_operlog(const char *method, json_t *params);
+// 两者之间的操作记为一条记录，params为各操作的{"method","params"}数组
+void operlog_batch_begin(void);
+int operlog_batch_end(void);
+int reship_operlog(uint64_t id, double create_time, const char *detail);
+
+sds operlog_file_name(sds name, time_t t);
+uint32_t operlog_record_crc(const char *data, size_t len);
 
 bool is_operlog_block(void);
 sds operlog_status(sds reply);
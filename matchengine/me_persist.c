@@ -14,6 +14,8 @@
 #include "me_market.h"
 #include "me_operlog.h"
 
+#include <sys/stat.h>
+
 static time_t last_slice_time;
 static nw_timer timer;
 
@@ -66,7 +68,51 @@ static int get_last_slice(MYSQL *conn, time_t *timestamp,
   return 0;
 }
 
-static int load_slice_from_db(MYSQL *conn, time_t timestamp) {
+static sds get_slice_file_name(sds name, time_t timestamp) {
+  return sdscatprintf(name, "%s/slice_%ld.bin", settings.slice_path, timestamp);
+}
+
+// 优先载入二进制切片文件，文件不存在或与切片记录不符时从数据库载入
+static int load_slice_from_file(time_t timestamp, uint64_t oper_id) {
+  sds name = get_slice_file_name(sdsempty(), timestamp);
+  struct slice_file_head head;
+  if (load_slice_head(name, &head) < 0 || head.time != timestamp ||
+      head.oper_id != oper_id) {
+    log_error("slice file %s not usable", name);
+    log_stderr("slice file %s not usable", name);
+    sdsfree(name);
+    return 0;
+  }
+
+  log_stderr("load slice from: %s", name);
+  bool damaged = false;
+  int ret = load_slice_file(name, &damaged);
+  if (ret < 0 && damaged) {
+    // 切片文件只用于加速，损坏时从数据库载入
+    log_error("slice file %s damaged: %d, load from db", name, ret);
+    log_stderr("slice file %s damaged: %d, load from db", name, ret);
+    sdsfree(name);
+    return 0;
+  }
+  if (ret < 0) {
+    log_error("load_slice_file from %s fail: %d", name, ret);
+    log_stderr("load_slice_file from %s fail: %d", name, ret);
+    sdsfree(name);
+    return -__LINE__;
+  }
+
+  sdsfree(name);
+  return 1;
+}
+
+static int load_slice_from_db(MYSQL *conn, time_t timestamp,
+                              uint64_t oper_id) {
+  if (settings.slice_path[0]) {
+    int ret = load_slice_from_file(timestamp, oper_id);
+    if (ret != 0)
+      return ret < 0 ? ret : 0;
+  }
+
   sds table = sdsempty();
 
   table = sdscatprintf(table, "slice_order_%ld", timestamp);
@@ -94,13 +140,73 @@ static int load_slice_from_db(MYSQL *conn, time_t timestamp) {
   return 0;
 }
 
+// 读出操作日志表中的最大id
+static int get_operlog_max_id(MYSQL *conn, const char *table,
+                              uint64_t *max_id) {
+  sds sql = sdsempty();
+  sql = sdscatprintf(sql, "SELECT MAX(`id`) from `%s`", table);
+  log_trace("exec sql: %s", sql);
+  int ret = mysql_real_query(conn, sql, sdslen(sql));
+  if (ret != 0) {
+    log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn),
+              mysql_error(conn));
+    sdsfree(sql);
+    return -__LINE__;
+  }
+  sdsfree(sql);
+
+  MYSQL_RES *result = mysql_store_result(conn);
+  MYSQL_ROW row = mysql_fetch_row(result);
+  *max_id = (row && row[0]) ? strtoull(row[0], NULL, 0) : 0;
+  mysql_free_result(result);
+
+  return 0;
+}
+
+// 优先从本地操作日志文件重放，文件中缺少的部分再从数据库补齐
+static int load_operlog_from_file(MYSQL *conn, time_t date, const char *table,
+                                  bool table_exists, uint64_t *start_id) {
+  sds name = operlog_file_name(sdsempty(), date);
+  if (access(name, F_OK) != 0) {
+    sdsfree(name);
+    return 0;
+  }
+
+  uint64_t ship_id = 0;
+  if (table_exists && get_operlog_max_id(conn, table, &ship_id) < 0) {
+    sdsfree(name);
+    return -__LINE__;
+  }
+
+  log_stderr("load oper log from: %s", name);
+  int ret = load_operlog_file(name, start_id, ship_id);
+  if (ret < 0) {
+    log_error("load_operlog_file from %s fail: %d", name, ret);
+    log_stderr("load_operlog_file from %s fail: %d", name, ret);
+    sdsfree(name);
+    return -__LINE__;
+  }
+
+  sdsfree(name);
+  return 0;
+}
+
 static int load_operlog_from_db(MYSQL *conn, time_t date, uint64_t *start_id) {
   struct tm *t = localtime(&date);
   sds table = sdsempty();
   table = sdscatprintf(table, "operlog_%04d%02d%02d", 1900 + t->tm_year,
                        1 + t->tm_mon, t->tm_mday);
+  bool table_exists = is_table_exists(conn, table);
+  if (settings.operlog_path[0]) {
+    int ret = load_operlog_from_file(conn, date, table, table_exists, start_id);
+    if (ret < 0) {
+      sdsfree(table);
+      return ret;
+    }
+  }
+
   log_stderr("load oper log from: %s", table);
-  if (!is_table_exists(conn, table)) {
+  if (!table_exists) {
     log_error("table %s not exist", table);
     log_stderr("table %s not exist", table);
     sdsfree(table);
@@ -159,7 +265,7 @@ int init_from_db(void) {
     if (ret < 0)
       goto cleanup;
   } else {
-    ret = load_slice_from_db(conn, last_slice_time);
+    ret = load_slice_from_db(conn, last_slice_time, last_oper_id);
     if (ret < 0) {
       goto cleanup;
     }
@@ -239,6 +345,20 @@ int update_slice_history(MYSQL *conn, time_t end) {
   return 0;
 }
 
+static int dump_slice_to_file(time_t timestamp) {
+  sds name = get_slice_file_name(sdsempty(), timestamp);
+  log_info("dump slice to: %s", name);
+  int ret = dump_slice_file(name, timestamp);
+  if (ret < 0) {
+    log_error("dump_slice_file to %s fail: %d", name, ret);
+    sdsfree(name);
+    return -__LINE__;
+  }
+  sdsfree(name);
+
+  return 0;
+}
+
 int dump_to_db(time_t timestamp) {
   MYSQL *conn = mysql_connect(&settings.db_log);
   if (conn == NULL) {
@@ -249,14 +369,23 @@ int dump_to_db(time_t timestamp) {
   log_info("start dump slice, timestamp: %ld", timestamp);
 
   int ret;
-  ret = dump_order_to_db(conn, timestamp);
-  if (ret < 0) {
-    goto cleanup;
+  if (settings.slice_path[0]) {
+    ret = dump_slice_to_file(timestamp);
+    if (ret < 0) {
+      goto cleanup;
+    }
   }
 
-  ret = dump_balance_to_db(conn, timestamp);
-  if (ret < 0) {
-    goto cleanup;
+  if (settings.slice_to_db || !settings.slice_path[0]) {
+    ret = dump_order_to_db(conn, timestamp);
+    if (ret < 0) {
+      goto cleanup;
+    }
+
+    ret = dump_balance_to_db(conn, timestamp);
+    if (ret < 0) {
+      goto cleanup;
+    }
   }
 
   ret = update_slice_history(conn, timestamp);
@@ -308,7 +437,7 @@ static int delete_slice(MYSQL *conn, uint64_t id, time_t timestamp) {
 
   int ret;
   sds sql = sdsempty();
-  sql = sdscatprintf(sql, "DROP TABLE `slice_order_%ld`", timestamp);
+  sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `slice_order_%ld`", timestamp);
   log_trace("exec sql: %s", sql);
   ret = mysql_real_query(conn, sql, sdslen(sql));
   if (ret != 0) {
@@ -318,7 +447,8 @@ static int delete_slice(MYSQL *conn, uint64_t id, time_t timestamp) {
   }
   sdsclear(sql);
 
-  sql = sdscatprintf(sql, "DROP TABLE `slice_balance_%ld`", timestamp);
+  sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `slice_balance_%ld`",
+                     timestamp);
   log_trace("exec sql: %s", sql);
   ret = mysql_real_query(conn, sql, sdslen(sql));
   if (ret != 0) {
@@ -328,6 +458,14 @@ static int delete_slice(MYSQL *conn, uint64_t id, time_t timestamp) {
   }
   sdsclear(sql);
 
+  if (settings.slice_path[0]) {
+    sds name = get_slice_file_name(sdsempty(), timestamp);
+    if (unlink(name) != 0 && errno != ENOENT) {
+      log_error("unlink %s fail: %d %s", name, errno, strerror(errno));
+    }
+    sdsfree(name);
+  }
+
   sql = sdscatprintf(
       sql, "DELETE FROM `slice_history` WHERE `id` = %" PRIu64 "", id);
   log_trace("exec sql: %s", sql);
@@ -434,6 +572,10 @@ static void on_timer(nw_timer *timer, void *privdata) {
 }
 
 int init_persist(void) {
+  if (settings.slice_path[0] && mkdir(settings.slice_path, 0755) != 0 &&
+      errno != EEXIST) {
+    return -__LINE__;
+  }
 
   // 设定计时器，绑定操作
   nw_timer_set(&timer, 1.0, true, on_timer, NULL);
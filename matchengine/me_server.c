@@ -17,6 +17,11 @@ static rpc_svr *svr;         //服务端
 static dict_t *dict_cache;   // 缓存字典
 static nw_timer cache_timer; // 缓存计时器
 
+// 执行批量命令时，子命令的响应收集到这里，不单独发送
+static json_t *batch_replies;
+
+typedef int (*cmd_handler)(nw_ses *ses, rpc_pkg *pkg, json_t *params);
+
 // 缓存数据
 struct cache_val {
   double time;
@@ -25,26 +30,33 @@ struct cache_val {
 
 /*1. 响应 */
 
-//返回json
+//返回json，按请求的包体类型编码
 static int reply_json(nw_ses *ses, rpc_pkg *pkg, const json_t *json) {
-  char *message_data;
-  if (settings.debug) {
-    message_data = json_dumps(json, JSON_INDENT(4));
-  } else {
-    message_data = json_dumps(json, 0);
+  if (batch_replies) {
+    json_array_append(batch_replies, (json_t *)json);
+    return 0;
   }
-  if (message_data == NULL)
-    return -__LINE__;
-  log_trace("connection: %s send: %s", nw_sock_human_addr(&ses->peer_addr),
-            message_data);
 
   rpc_pkg reply;
   memcpy(&reply, pkg, sizeof(reply));
   reply.pkg_type = RPC_PKG_TYPE_REPLY;
-  reply.body = message_data;
-  reply.body_size = strlen(message_data);
+  int type = rpc_body_type(pkg);
+  if (type == RPC_BODY_JSON && settings.debug) {
+    reply.body = json_dumps(json, JSON_INDENT(4));
+    if (reply.body == NULL)
+      return -__LINE__;
+    reply.body_size = strlen(reply.body);
+    rpc_body_set_type(&reply, type);
+  } else if (rpc_body_dump(&reply, json, type) < 0) {
+    return -__LINE__;
+  }
+  if (type == RPC_BODY_JSON) {
+    log_trace("connection: %s send: %.*s", nw_sock_human_addr(&ses->peer_addr),
+              (int)reply.body_size, (char *)reply.body);
+  }
+
   rpc_send(ses, &reply);
-  free(message_data);
+  free(reply.body);
 
   return 0;
 }
@@ -112,7 +124,7 @@ static bool process_cache(nw_ses *ses, rpc_pkg *pkg, sds *cache_key) {
   key = sdscatlen(key, pkg->body, pkg->body_size);
   dict_entry *entry = dict_find(dict_cache, key);
   if (entry == NULL) {
-    *cache_key = key;
+      *cache_key = key;
     return false;
   }
 
@@ -120,7 +132,7 @@ static bool process_cache(nw_ses *ses, rpc_pkg *pkg, sds *cache_key) {
   double now = current_timestamp();
   if ((now - cache->time) > settings.cache_timeout) {
     dict_delete(dict_cache, key);
-    *cache_key = key;
+      *cache_key = key;
     return false;
   }
 
@@ -448,6 +460,8 @@ static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   // 提交限价订单
   int ret = market_put_limit_order(true, &result, market, user_id, side, amount,
                                    price, taker_fee, maker_fee, source);
+  if (ret >= 0)
+    append_operlog("limit_order", params);
 
   mpd_del(amount);
   mpd_del(price);
@@ -459,14 +473,13 @@ static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
     return reply_error(ses, pkg, 10, "balance not enough");
   } else if (ret == -2) {
     return reply_error(ses, pkg, 11, "amount too small");
+  } else if (ret == -3) {
+    return reply_error(ses, pkg, 12, "amount too large");
   } else if (ret < 0) {
     log_fatal("market_put_limit_order fail: %d", ret);
     return reply_error_internal_error(ses, pkg);
   }
 
-  // 记录操作日志
-  append_operlog("limit_order", params);
-
   //生成响应数据
   ret = reply_result(ses, pkg, result);
   json_decref(result);
@@ -542,6 +555,8 @@ static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   // 提交市价订单
   int ret = market_put_market_order(true, &result, market, user_id, side,
                                     amount, taker_fee, source);
+  if (ret >= 0)
+    append_operlog("market_order", params);
 
   mpd_del(amount);
   mpd_del(taker_fee);
@@ -552,12 +567,13 @@ static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
     return reply_error(ses, pkg, 11, "amount too small");
   } else if (ret == -3) {
     return reply_error(ses, pkg, 12, "no enough trader");
+  } else if (ret == -4) {
+    return reply_error(ses, pkg, 13, "amount too large");
   } else if (ret < 0) {
     log_fatal("market_put_limit_order fail: %d", ret);
     return reply_error_internal_error(ses, pkg);
   }
 
-  append_operlog("market_order", params);
   ret = reply_result(ses, pkg, result);
   json_decref(result);
   return ret;
@@ -612,19 +628,12 @@ static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   } else {
     json_object_set_new(result, "total", json_integer(order_list->len));
     if (offset < order_list->len) {
-      skiplist_iter *iter = skiplist_get_iterator(order_list);
-      skiplist_node *node;
-      for (size_t i = 0; i < offset; i++) {
-        if (skiplist_next(iter) == NULL)
-          break;
-      }
-      size_t index = 0;
-      while ((node = skiplist_next(iter)) != NULL && index < limit) {
-        index++;
+      skiplist_node *node = skiplist_seek(order_list, offset, NULL);
+      for (size_t index = 0; node && index < limit; index++) {
         order_t *order = node->value;
         json_array_append_new(orders, get_order_info(order));
+        node = node->forward[0];
       }
-      skiplist_release_iterator(iter);
     }
   }
 
@@ -667,17 +676,213 @@ static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
 
   json_t *result = NULL;
   int ret = market_cancel_order(true, &result, market, order);
+  if (ret >= 0)
+    append_operlog("cancel_order", params);
+  if (ret < 0) {
+    log_fatal("cancel order: %" PRIu64 " fail: %d", order_id, ret);
+    return reply_error_internal_error(ses, pkg);
+  }
+
+  ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
+//解析可选的买卖方向参数，缺省为0，表示不区分方向
+static int get_cancel_side(json_t *params, size_t index, uint32_t *side) {
+  *side = 0;
+  if (json_array_size(params) <= index)
+    return 0;
+  if (!json_is_integer(json_array_get(params, index)))
+    return -__LINE__;
+  *side = json_integer_value(json_array_get(params, index));
+  if (*side != 0 && *side != MARKET_ORDER_SIDE_ASK &&
+      *side != MARKET_ORDER_SIDE_BID)
+    return -__LINE__;
+  return 0;
+}
+
+//中途失败时已撤的订单不回滚，操作日志补上side和撤单数，重放时只撤同样的前count个
+static json_t *cancel_log_params(json_t *params, size_t side_index,
+                                 uint32_t side, size_t count) {
+  json_t *log_params = json_array();
+  for (size_t i = 0; i < side_index; ++i)
+    json_array_append(log_params, json_array_get(params, i));
+  json_array_append_new(log_params, json_integer(side));
+  json_array_append_new(log_params, json_integer(count));
+  return log_params;
+}
+
+//事件：撤销用户在交易对的全部挂单
+/*
+params: [user_id, market] 或 [user_id, market, side]
+*/
+static int on_cmd_order_cancel_all(nw_ses *ses, rpc_pkg *pkg,
+                                   json_t *params) {
+  if (json_array_size(params) != 2 && json_array_size(params) != 3)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // user_id
+  if (!json_is_integer(json_array_get(params, 0)))
+    return reply_error_invalid_argument(ses, pkg);
+  uint32_t user_id = json_integer_value(json_array_get(params, 0));
+
+  // market
+  if (!json_is_string(json_array_get(params, 1)))
+    return reply_error_invalid_argument(ses, pkg);
+  const char *market_name = json_string_value(json_array_get(params, 1));
+  market_t *market = get_market(market_name);
+  if (market == NULL)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // side
+  uint32_t side;
+  if (get_cancel_side(params, 2, &side) < 0)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // 所有撤单只记录一条操作日志，重放时按同样的顺序撤单
+  size_t count = 0;
+  int ret = market_cancel_user_orders(true, market, user_id, side, 0, &count);
+  if (ret >= 0 && count > 0) {
+    append_operlog("cancel_user_orders", params);
+  } else if (count > 0) {
+    json_t *log_params = cancel_log_params(params, 2, side, count);
+    append_operlog("cancel_user_orders", log_params);
+    json_decref(log_params);
+  }
+  if (ret < 0) {
+    log_fatal("cancel user: %u orders fail: %d, cancelled: %zu", user_id, ret,
+              count);
+    return reply_error_internal_error(ses, pkg);
+  }
+
+  json_t *result = json_object();
+  json_object_set_new(result, "count", json_integer(count));
+  ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
+//事件：撤销交易对的全部挂单
+/*
+params: [market] 或 [market, side]
+*/
+static int on_cmd_order_cancel_market(nw_ses *ses, rpc_pkg *pkg,
+                                      json_t *params) {
+  if (json_array_size(params) != 1 && json_array_size(params) != 2)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // market
+  if (!json_is_string(json_array_get(params, 0)))
+    return reply_error_invalid_argument(ses, pkg);
+  const char *market_name = json_string_value(json_array_get(params, 0));
+  market_t *market = get_market(market_name);
+  if (market == NULL)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // side
+  uint32_t side;
+  if (get_cancel_side(params, 1, &side) < 0)
+    return reply_error_invalid_argument(ses, pkg);
+
+  size_t count = 0;
+  int ret = market_cancel_all_orders(true, market, side, 0, &count);
+  if (ret >= 0 && count > 0) {
+    append_operlog("cancel_all_orders", params);
+  } else if (count > 0) {
+    json_t *log_params = cancel_log_params(params, 1, side, count);
+    append_operlog("cancel_all_orders", log_params);
+    json_decref(log_params);
+  }
   if (ret < 0) {
-    log_fatal("cancel order: %" PRIu64 " fail: %d", order->id, ret);
+    log_fatal("cancel market: %s orders fail: %d, cancelled: %zu", market_name,
+              ret, count);
     return reply_error_internal_error(ses, pkg);
   }
 
-  append_operlog("cancel_order", params);
+  json_t *result = json_object();
+  json_object_set_new(result, "count", json_integer(count));
   ret = reply_result(ses, pkg, result);
   json_decref(result);
   return ret;
 }
 
+//批量命令中允许的子命令
+static cmd_handler get_batch_handler(json_t *command) {
+  if (!json_is_integer(command))
+    return NULL;
+  switch (json_integer_value(command)) {
+  case CMD_ORDER_PUT_LIMIT:
+    return on_cmd_order_put_limit;
+  case CMD_ORDER_PUT_MARKET:
+    return on_cmd_order_put_market;
+  case CMD_ORDER_CANCEL:
+    return on_cmd_order_cancel;
+  case CMD_ORDER_CANCEL_ALL:
+    return on_cmd_order_cancel_all;
+  }
+  return NULL;
+}
+
+//事件：批量下单、撤单
+/*
+params: [market, [[command, params], ...]]，子命令可为限价单、市价单、撤单和撤销用户全部挂单
+子命令按顺序执行，操作日志合并为一条，
+结果为各子命令的响应数组，某个子命令失败不影响后续子命令
+*/
+static int on_cmd_order_batch(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
+  if (json_array_size(params) != 2)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // market
+  if (!json_is_string(json_array_get(params, 0)))
+    return reply_error_invalid_argument(ses, pkg);
+  const char *market_name = json_string_value(json_array_get(params, 0));
+  if (get_market(market_name) == NULL)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // 子命令的交易对须与批量命令相同
+  json_t *requests = json_array_get(params, 1);
+  size_t count = json_array_size(requests);
+  if (!json_is_array(requests) || count == 0 || count > ORDER_BATCH_MAX_LEN)
+    return reply_error_invalid_argument(ses, pkg);
+  for (size_t i = 0; i < count; ++i) {
+    json_t *request = json_array_get(requests, i);
+    if (!json_is_array(request) || json_array_size(request) != 2)
+      return reply_error_invalid_argument(ses, pkg);
+    if (get_batch_handler(json_array_get(request, 0)) == NULL)
+      return reply_error_invalid_argument(ses, pkg);
+    json_t *sub_params = json_array_get(request, 1);
+    if (!json_is_array(sub_params))
+      return reply_error_invalid_argument(ses, pkg);
+    const char *name = json_string_value(json_array_get(sub_params, 1));
+    if (name == NULL || strcmp(name, market_name) != 0)
+      return reply_error_invalid_argument(ses, pkg);
+  }
+
+  json_t *result = json_array();
+  operlog_batch_begin();
+  batch_replies = result;
+  for (size_t i = 0; i < count; ++i) {
+    json_t *request = json_array_get(requests, i);
+    cmd_handler handler = get_batch_handler(json_array_get(request, 0));
+    int ret = handler(ses, pkg, json_array_get(request, 1));
+    if (ret < 0) {
+      log_error("batch cmd: %" PRId64 " fail: %d",
+                (int64_t)json_integer_value(json_array_get(request, 0)), ret);
+    }
+    // 保证每个子命令都有一个响应
+    if (json_array_size(result) == i)
+      reply_error_internal_error(ses, pkg);
+  }
+  batch_replies = NULL;
+  operlog_batch_end();
+
+  int ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
 //事件：订单深度
 static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   if (json_array_size(params) != 4)
@@ -715,32 +920,34 @@ static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   json_object_set_new(result, "limit", json_integer(limit));
 
   uint64_t total;
-  skiplist_iter *iter;
+  skiplist_t *book;
   if (side == MARKET_ORDER_SIDE_ASK) {
-    iter = skiplist_get_iterator(market->asks);
-    total = market->asks->len;
-    json_object_set_new(result, "total", json_integer(total));
+    book = market->asks;
+    total = market->ask_count;
   } else {
-    iter = skiplist_get_iterator(market->bids);
-    total = market->bids->len;
-    json_object_set_new(result, "total", json_integer(total));
+    book = market->bids;
+    total = market->bid_count;
   }
+  json_object_set_new(result, "total", json_integer(total));
 
   json_t *orders = json_array();
   if (offset < total) {
-    for (size_t i = 0; i < offset; i++) {
-      if (skiplist_next(iter) == NULL)
-        break;
-    }
+    // 价位的权重为订单数，直接定位到offset所在的价位
+    unsigned long before;
+    skiplist_node *node = skiplist_seek(book, offset, &before);
+    size_t skip = offset - before;
     size_t index = 0;
-    skiplist_node *node;
-    while ((node = skiplist_next(iter)) != NULL && index < limit) {
-      index++;
-      order_t *order = node->value;
-      json_array_append_new(orders, get_order_info(order));
+    for (; node && index < limit; node = node->forward[0]) {
+      price_level_t *level = node->value;
+      order_t *order = level->head;
+      for (; skip > 0; skip--)
+        order = order->next;
+      for (; order && index < limit; order = order->next) {
+        index++;
+        json_array_append_new(orders, get_order_info(order));
+      }
     }
   }
-  skiplist_release_iterator(iter);
 
   json_object_set_new(result, "orders", orders);
   int ret = reply_result(ses, pkg, result);
@@ -750,60 +957,33 @@ static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
 
 //订单深度
 static json_t *get_depth(market_t *market, size_t limit) {
-  mpd_t *price = mpd_new(&mpd_ctx);
-  mpd_t *amount = mpd_new(&mpd_ctx);
-
   json_t *asks = json_array();
   skiplist_iter *iter = skiplist_get_iterator(market->asks);
-  skiplist_node *node = skiplist_next(iter);
+  skiplist_node *node;
   size_t index = 0;
-  while (node && index < limit) {
+  while ((node = skiplist_next(iter)) != NULL && index < limit) {
     index++;
-    order_t *order = node->value;
-    mpd_copy(price, order->price, &mpd_ctx);
-    mpd_copy(amount, order->left, &mpd_ctx);
-    while ((node = skiplist_next(iter)) != NULL) {
-      order = node->value;
-      if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
-        mpd_add(amount, amount, order->left, &mpd_ctx);
-      } else {
-        break;
-      }
-    }
+    price_level_t *level = node->value;
     json_t *info = json_array();
-    json_array_append_new_mpd(info, price);
-    json_array_append_new_mpd(info, amount);
+    json_array_append_new_mpd(info, level->price);
+    json_array_append_new_mpd(info, level->amount);
     json_array_append_new(asks, info);
   }
   skiplist_release_iterator(iter);
 
   json_t *bids = json_array();
   iter = skiplist_get_iterator(market->bids);
-  node = skiplist_next(iter);
   index = 0;
-  while (node && index < limit) {
+  while ((node = skiplist_next(iter)) != NULL && index < limit) {
     index++;
-    order_t *order = node->value;
-    mpd_copy(price, order->price, &mpd_ctx);
-    mpd_copy(amount, order->left, &mpd_ctx);
-    while ((node = skiplist_next(iter)) != NULL) {
-      order = node->value;
-      if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
-        mpd_add(amount, amount, order->left, &mpd_ctx);
-      } else {
-        break;
-      }
-    }
+    price_level_t *level = node->value;
     json_t *info = json_array();
-    json_array_append_new_mpd(info, price);
-    json_array_append_new_mpd(info, amount);
+    json_array_append_new_mpd(info, level->price);
+    json_array_append_new_mpd(info, level->amount);
     json_array_append_new(bids, info);
   }
   skiplist_release_iterator(iter);
 
-  mpd_del(price);
-  mpd_del(amount);
-
   json_t *result = json_object();
   json_object_set_new(result, "asks", asks);
   json_object_set_new(result, "bids", bids);
@@ -825,17 +1005,17 @@ static json_t *get_depth_merge(market_t *market, size_t limit,
   size_t index = 0;
   while (node && index < limit) {
     index++;
-    order_t *order = node->value;
-    mpd_divmod(q, r, order->price, interval, &mpd_ctx);
+    price_level_t *level = node->value;
+    mpd_divmod(q, r, level->price, interval, &mpd_ctx);
     mpd_mul(price, q, interval, &mpd_ctx);
     if (mpd_cmp(r, mpd_zero, &mpd_ctx) != 0) {
       mpd_add(price, price, interval, &mpd_ctx);
     }
-    mpd_copy(amount, order->left, &mpd_ctx);
+    mpd_copy(amount, level->amount, &mpd_ctx);
     while ((node = skiplist_next(iter)) != NULL) {
-      order = node->value;
-      if (mpd_cmp(price, order->price, &mpd_ctx) >= 0) {
-        mpd_add(amount, amount, order->left, &mpd_ctx);
+      level = node->value;
+      if (mpd_cmp(price, level->price, &mpd_ctx) >= 0) {
+        mpd_add(amount, amount, level->amount, &mpd_ctx);
       } else {
         break;
       }
@@ -853,14 +1033,14 @@ static json_t *get_depth_merge(market_t *market, size_t limit,
   index = 0;
   while (node && index < limit) {
     index++;
-    order_t *order = node->value;
-    mpd_divmod(q, r, order->price, interval, &mpd_ctx);
+    price_level_t *level = node->value;
+    mpd_divmod(q, r, level->price, interval, &mpd_ctx);
     mpd_mul(price, q, interval, &mpd_ctx);
-    mpd_copy(amount, order->left, &mpd_ctx);
+    mpd_copy(amount, level->amount, &mpd_ctx);
     while ((node = skiplist_next(iter)) != NULL) {
-      order = node->value;
-      if (mpd_cmp(price, order->price, &mpd_ctx) <= 0) {
-        mpd_add(amount, amount, order->left, &mpd_ctx);
+      level = node->value;
+      if (mpd_cmp(price, level->price, &mpd_ctx) <= 0) {
+        mpd_add(amount, amount, level->amount, &mpd_ctx);
       } else {
         break;
       }
@@ -944,6 +1124,31 @@ static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   return ret;
 }
 
+//事件：完整盘口快照，附带盘口变动序号，订阅方据此衔接depth消息
+static int on_cmd_order_book_snapshot(nw_ses *ses, rpc_pkg *pkg,
+                                      json_t *params) {
+  if (json_array_size(params) != 1)
+    return reply_error_invalid_argument(ses, pkg);
+
+  // market
+  if (!json_is_string(json_array_get(params, 0)))
+    return reply_error_invalid_argument(ses, pkg);
+  const char *market_name = json_string_value(json_array_get(params, 0));
+  market_t *market = get_market(market_name);
+  if (market == NULL)
+    return reply_error_invalid_argument(ses, pkg);
+
+  size_t limit = skiplist_len(market->asks);
+  if (skiplist_len(market->bids) > limit)
+    limit = skiplist_len(market->bids);
+  json_t *result = get_depth(market, limit);
+  json_object_set_new(result, "seq", json_integer(market->depth_seq));
+
+  int ret = reply_result(ses, pkg, result);
+  json_decref(result);
+  return ret;
+}
+
 //事件：订单详情
 static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, json_t *params) {
   if (json_array_size(params) != 2)
@@ -1054,13 +1259,13 @@ invalid_argument:
 // 服务端接收到数据包时，根据数据包中的命令进行处理并响应
 static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
 
-  // 载入json参数
-  json_t *params = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+  // 载入参数，json或二进制包体
+  json_t *params = rpc_body_load(pkg);
   if (params == NULL || !json_is_array(params)) {
     goto decode_error;
   }
   // 参数的动态字符串
-  sds params_str = sdsnewlen(pkg->body, pkg->body_size);
+  sds params_str = rpc_body_str(pkg);
 
   // 结果变量return
   int ret;
@@ -1172,6 +1377,54 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
     }
     break;
 
+    // 撤销用户的全部挂单
+  case CMD_ORDER_CANCEL_ALL:
+    if (is_operlog_block() || is_history_block() || is_message_block()) {
+      log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                is_operlog_block(), is_history_block(), is_message_block());
+      reply_error_service_unavailable(ses, pkg);
+      goto cleanup;
+    }
+    log_trace("from: %s cmd order cancel all, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_order_cancel_all(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_order_cancel_all %s fail: %d", params_str, ret);
+    }
+    break;
+
+    // 撤销交易对的全部挂单
+  case CMD_ORDER_CANCEL_MARKET:
+    if (is_operlog_block() || is_history_block() || is_message_block()) {
+      log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                is_operlog_block(), is_history_block(), is_message_block());
+      reply_error_service_unavailable(ses, pkg);
+      goto cleanup;
+    }
+    log_trace("from: %s cmd order cancel market, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_order_cancel_market(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_order_cancel_market %s fail: %d", params_str, ret);
+    }
+    break;
+
+    // 批量下单、撤单
+  case CMD_ORDER_BATCH:
+    if (is_operlog_block() || is_history_block() || is_message_block()) {
+      log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                is_operlog_block(), is_history_block(), is_message_block());
+      reply_error_service_unavailable(ses, pkg);
+      goto cleanup;
+    }
+    log_trace("from: %s cmd order batch, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_order_batch(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_order_batch %s fail: %d", params_str, ret);
+    }
+    break;
+
     // 订单表
   case CMD_ORDER_BOOK:
     log_trace("from: %s cmd order book, sequence: %u params: %s",
@@ -1192,6 +1445,16 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg) {
     }
     break;
 
+    // 盘口快照
+  case CMD_ORDER_BOOK_SNAPSHOT:
+    log_trace("from: %s cmd order book snapshot, sequence: %u params: %s",
+              nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+    ret = on_cmd_order_book_snapshot(ses, pkg, params);
+    if (ret < 0) {
+      log_error("on_cmd_order_book_snapshot %s fail: %d", params_str, ret);
+    }
+    break;
+
     // 订单详情
   case CMD_ORDER_DETAIL:
     log_trace("from: %s cmd order detail, sequence: %u params: %s",
@@ -1313,6 +1576,7 @@ int init_server(void) {
   type.on_recv_pkg = svr_on_recv_pkg; //绑定接收到数据包的事件
   type.on_new_connection = svr_on_new_connection;     //绑定连接事件
   type.on_connection_close = svr_on_connection_close; //绑定连接关闭事件
+  type.binary_body = true; //支持二进制包体
 
   //实例化rpc服务
   svr = rpc_svr_create(&settings.svr, &type);
@@ -12,11 +12,43 @@
 # define NW_CACHE_INIT_SIZE    64
 # define NW_CACHE_MAX_SIZE     65535
 
+nw_buf_ref *nw_buf_ref_create(const void *data, size_t size)
+{
+    if (size > UINT32_MAX)
+        return NULL;
+    nw_buf_ref *ref = malloc(sizeof(nw_buf_ref) + size);
+    if (ref == NULL)
+        return NULL;
+    ref->refcount = 1;
+    ref->size = size;
+    if (data)
+        memcpy(ref->data, data, size);
+
+    return ref;
+}
+
+nw_buf_ref *nw_buf_ref_retain(nw_buf_ref *ref)
+{
+    __sync_add_and_fetch(&ref->refcount, 1);
+    return ref;
+}
+
+void nw_buf_ref_release(nw_buf_ref *ref)
+{
+    if (__sync_sub_and_fetch(&ref->refcount, 1) == 0)
+        free(ref);
+}
+
 size_t nw_buf_size(nw_buf *buf)
 {
     return buf->wpos - buf->rpos;
 }
 
+char *nw_buf_rptr(nw_buf *buf)
+{
+    return (buf->ref ? buf->ref->data : buf->data) + buf->rpos;
+}
+
 size_t nw_buf_avail(nw_buf *buf)
 {
     return buf->size - buf->wpos;
@@ -69,6 +101,7 @@ nw_buf *nw_buf_alloc(nw_buf_pool *pool)
         buf->rpos = 0;
         buf->wpos = 0;
         buf->next = NULL;
+        buf->ref = NULL;
         return buf;
     }
 
@@ -79,6 +112,7 @@ nw_buf *nw_buf_alloc(nw_buf_pool *pool)
     buf->rpos = 0;
     buf->wpos = 0;
     buf->next = NULL;
+    buf->ref = NULL;
 
     return buf;
 }
@@ -178,6 +212,41 @@ size_t nw_buf_list_append(nw_buf_list *list, const void *data, size_t len)
     return len;
 }
 
+size_t nw_buf_list_append_ref(nw_buf_list *list, nw_buf_ref *ref, size_t offset)
+{
+    if (offset >= ref->size)
+        return 0;
+    if (list->limit && list->count >= list->limit)
+        return 0;
+    /* a reference buf has no data of itself, size equal to wpos so nothing can be written into it */
+    nw_buf *buf = malloc(sizeof(nw_buf));
+    if (buf == NULL)
+        return 0;
+    buf->size = ref->size;
+    buf->rpos = offset;
+    buf->wpos = ref->size;
+    buf->next = NULL;
+    buf->ref = nw_buf_ref_retain(ref);
+    if (list->head == NULL)
+        list->head = buf;
+    if (list->tail != NULL)
+        list->tail->next = buf;
+    list->tail = buf;
+    list->count++;
+
+    return ref->size - offset;
+}
+
+static void nw_buf_list_free(nw_buf_list *list, nw_buf *buf)
+{
+    if (buf->ref) {
+        nw_buf_ref_release(buf->ref);
+        free(buf);
+    } else {
+        nw_buf_free(list->pool, buf);
+    }
+}
+
 void nw_buf_list_shift(nw_buf_list *list)
 {
     if (list->head) {
@@ -187,7 +256,7 @@ void nw_buf_list_shift(nw_buf_list *list)
             list->tail = NULL;
         }
         list->count--;
-        nw_buf_free(list->pool, tmp);
+        nw_buf_list_free(list, tmp);
     }
 }
 
@@ -197,7 +266,7 @@ void nw_buf_list_release(nw_buf_list *list)
     nw_buf *next = NULL;
     while (curr) {
         next = curr->next;
-        nw_buf_free(list->pool, curr);
+        nw_buf_list_free(list, curr);
         curr = next;
     }
     free(list);
@@ -11,12 +11,22 @@
 
 /* buf management */
 
-/* nw_buf is the basic instance of buf, with limit size */
+/* nw_buf_ref is a reference counted payload, it can be queued to many
+ * nw_buf_list without copying, the last release free it */
+typedef struct nw_buf_ref {
+    uint32_t refcount;
+    uint32_t size;
+    char data[];
+} nw_buf_ref;
+
+/* nw_buf is the basic instance of buf, with limit size,
+ * if ref is not NULL, the buf has no data of itself and [rpos, wpos) is in ref->data */
 typedef struct nw_buf {
     uint32_t size;
     uint32_t rpos;
     uint32_t wpos;
     struct nw_buf *next;
+    nw_buf_ref *ref;
     char data[];
 } nw_buf;
 
@@ -47,8 +57,15 @@ typedef struct nw_cache {
     void **free_arr;
 } nw_cache;
 
+/* nw_buf_ref operation, if data is NULL, the payload is left uninitialized */
+nw_buf_ref *nw_buf_ref_create(const void *data, size_t size);
+nw_buf_ref *nw_buf_ref_retain(nw_buf_ref *ref);
+void nw_buf_ref_release(nw_buf_ref *ref);
+
 /* nw_buf operation */
 size_t nw_buf_size(nw_buf *buf);
+/* the unread data of buf */
+char *nw_buf_rptr(nw_buf *buf);
 size_t nw_buf_avail(nw_buf *buf);
 size_t nw_buf_write(nw_buf *buf, const void *data, size_t len);
 void nw_buf_shift(nw_buf *buf);
@@ -66,6 +83,8 @@ size_t nw_buf_list_write(nw_buf_list *list, const void *data, size_t len);
 /* append data to a new buf instance, will expand the list, len shoud not big than buf size
  * return the size actually write */
 size_t nw_buf_list_append(nw_buf_list *list, const void *data, size_t len);
+/* append a reference of ref->data[offset, size) to the list, return the size actually append */
+size_t nw_buf_list_append_ref(nw_buf_list *list, nw_buf_ref *ref, size_t offset);
 /* remove the head buf if exist */
 void nw_buf_list_shift(nw_buf_list *list);
 void nw_buf_list_release(nw_buf_list *list);
@@ -4,7 +4,9 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "nw_log.h"
@@ -69,6 +71,46 @@ static int nw_write_stream(nw_ses *ses, const void *data, size_t size) {
   return spos;
 }
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// 用一次writev写出写缓冲链表头部的多个缓冲，total返回本次提交的字节数
+static ssize_t nw_writev_stream(nw_ses *ses, size_t *total) {
+  struct iovec iov[IOV_MAX];
+  int count = 0;
+  *total = 0;
+  for (nw_buf *buf = ses->write_buf->head; buf && count < IOV_MAX;
+       buf = buf->next) {
+    iov[count].iov_base = nw_buf_rptr(buf);
+    iov[count].iov_len = nw_buf_size(buf);
+    *total += iov[count].iov_len;
+    count++;
+  }
+
+  while (true) {
+    ssize_t ret = writev(ses->sockfd, iov, count);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    return ret;
+  }
+}
+
+// 丢弃写缓冲链表中已写出的size字节
+static void nw_write_buf_consume(nw_ses *ses, size_t size) {
+  while (size > 0 && ses->write_buf->count > 0) {
+    nw_buf *buf = ses->write_buf->head;
+    size_t buf_size = nw_buf_size(buf);
+    if (size < buf_size) {
+      buf->rpos += size;
+      return;
+    }
+    size -= buf_size;
+    nw_buf_list_shift(ses->write_buf);
+  }
+}
+
 static int nw_write_packet(nw_ses *ses, const void *data, size_t size) {
   while (true) {
     struct msghdr msg;
@@ -249,31 +291,42 @@ static void on_can_write(nw_ses *ses) {
   if (ses->sockfd < 0)
     return;
 
-  while (ses->write_buf->count > 0) {
-    nw_buf *buf = ses->write_buf->head;
-    size_t size = nw_buf_size(buf);
-    int nwrite = 0;
-    if (ses->sock_type == SOCK_STREAM) {
-      nwrite = nw_write_stream(ses, buf->data + buf->rpos, size);
-    } else {
-      nwrite = nw_write_packet(ses, buf->data + buf->rpos, size);
-    }
-    if (nwrite < size) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        if (ses->sock_type == SOCK_STREAM) {
-          buf->rpos += nwrite;
-          break;
-        } else {
+  if (ses->sock_type == SOCK_STREAM) {
+    // 流式连接按链表顺序聚合写出，写不完时只推进已写部分
+    while (ses->write_buf->count > 0) {
+      size_t total;
+      ssize_t nwrite = nw_writev_stream(ses, &total);
+      if (nwrite < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
           break;
         }
-      } else {
         char errmsg[100];
         snprintf(errmsg, sizeof(errmsg), "write error: %s", strerror(errno));
         ses->on_error(ses, errmsg);
         return;
       }
-    } else {
-      nw_buf_list_shift(ses->write_buf);
+      nw_write_buf_consume(ses, nwrite);
+      if (nwrite < total) {
+        break;
+      }
+    }
+  } else {
+    while (ses->write_buf->count > 0) {
+      nw_buf *buf = ses->write_buf->head;
+      size_t size = nw_buf_size(buf);
+      int nwrite = nw_write_packet(ses, nw_buf_rptr(buf), size);
+      if (nwrite < (int)size) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          break;
+        } else {
+          char errmsg[100];
+          snprintf(errmsg, sizeof(errmsg), "write error: %s", strerror(errno));
+          ses->on_error(ses, errmsg);
+          return;
+        }
+      } else {
+        nw_buf_list_shift(ses->write_buf);
+      }
     }
   }
 
@@ -490,6 +543,42 @@ int nw_ses_send(nw_ses *ses, const void *data, size_t size) {
   return 0;
 }
 
+// 发送共享数据，流式连接中排队时只引用不复制
+int nw_ses_send_ref(nw_ses *ses, nw_buf_ref *ref) {
+  if (ses->sockfd < 0) {
+    return -1;
+  }
+  if (ses->sock_type != SOCK_STREAM) {
+    return nw_ses_send(ses, ref->data, ref->size);
+  }
+
+  bool idle = ses->write_buf->count == 0;
+  size_t nwrite = 0;
+  if (idle) {
+    nwrite = nw_write_stream(ses, ref->data, ref->size);
+    if (nwrite == ref->size) {
+      return 0;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      char errmsg[100];
+      snprintf(errmsg, sizeof(errmsg), "write error: %s", strerror(errno));
+      ses->on_error(ses, errmsg);
+      return -1;
+    }
+  }
+
+  if (nw_buf_list_append_ref(ses->write_buf, ref, nwrite) !=
+      ref->size - nwrite) {
+    ses->on_error(ses, "no send buf");
+    return -1;
+  }
+  if (idle) {
+    watch_read_write(ses);
+  }
+
+  return 0;
+}
+
 int nw_ses_send_fd(nw_ses *ses, int fd) {
   log_info(" 开始向nw_ses发送fd消息fd: %d", fd);
 
@@ -93,6 +93,9 @@ int nw_ses_connect(nw_ses *ses, nw_addr_t *addr);
 int nw_ses_start(nw_ses *ses);
 int nw_ses_stop(nw_ses *ses);
 int nw_ses_send(nw_ses *ses, const void *data, size_t size);
+/* send a shared payload, when it has to be queued only a reference is kept,
+ * so one payload can be sent to many sessions without copying */
+int nw_ses_send_ref(nw_ses *ses, nw_buf_ref *ref);
 
 /* send a fd, only when the connection is SOCK_SEQPACKET type */
 int nw_ses_send_fd(nw_ses *ses, int fd);
@@ -0,0 +1,158 @@
+/*
+ * Description: 深度订单簿：rpc快照与kafka深度消息先后到达的顺序
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# include "../../accessws/aw_depth.c"
+
+# define MARKET "BTCUSDT"
+
+struct settings settings;
+
+int send_notify(nw_ses *ses, const char *method, json_t *params)
+{
+    return 0;
+}
+
+int send_notify_dict(dict_t *sessions, const char *method, json_t *params)
+{
+    return 0;
+}
+
+// 一档卖盘变动，amount为0时删除该价位
+static json_t *depth_msg(uint64_t seq, const char *price, const char *amount)
+{
+    json_t *unit = json_array();
+    json_array_append_new(unit, json_string(price));
+    json_array_append_new(unit, json_string(amount));
+    json_t *asks = json_array();
+    json_array_append_new(asks, unit);
+
+    json_t *msg = json_object();
+    json_object_set_new(msg, "market", json_string(MARKET));
+    json_object_set_new(msg, "seq", json_integer(seq));
+    json_object_set_new(msg, "asks", asks);
+    json_object_set_new(msg, "bids", json_array());
+    return msg;
+}
+
+static int on_message(uint64_t seq, const char *price, const char *amount)
+{
+    json_t *msg = depth_msg(seq, price, amount);
+    int ret = depth_on_message(msg);
+    json_decref(msg);
+    return ret;
+}
+
+static int on_snapshot(uint64_t seq, const char *price, const char *amount)
+{
+    json_t *result = depth_msg(seq, price, amount);
+    int ret = on_snapshot_reply(MARKET, result);
+    json_decref(result);
+    return ret;
+}
+
+// 检查同步状态、seq和某一价位的卖盘数量
+static int check(struct depth_book *book, uint64_t seq, const char *price, const char *amount)
+{
+    if (!book->synced || book->seq != seq) {
+        printf("synced: %d, seq: %"PRIu64", expect: %"PRIu64"\n", book->synced, book->seq, seq);
+        return -__LINE__;
+    }
+
+    json_t *unit = json_array();
+    json_array_append_new(unit, json_string(price));
+    json_array_append_new(unit, json_string(amount));
+    fixed_t fx_price, fx_amount;
+    int ret = get_unit(book, unit, &fx_price, &fx_amount);
+    json_decref(unit);
+    if (ret < 0)
+        return ret;
+
+    struct depth_level key = { .price = fx_price };
+    skiplist_node *node = skiplist_find(book->asks, &key);
+    fixed_t left = node ? ((struct depth_level *)node->value)->amount : 0;
+    if (left != fx_amount) {
+        printf("seq: %"PRIu64", price: %s, amount mismatch, expect: %s\n", seq, price, amount);
+        return -__LINE__;
+    }
+    return 0;
+}
+
+// 快照之前的消息暂存，快照到达后只应用比快照新的
+static int test_pending(struct depth_book *book)
+{
+    ERR_RET(on_message(5, "100", "1"));
+    ERR_RET(on_message(6, "101", "2"));
+    if (book->synced || list_len(book->pending) != 2)
+        return -__LINE__;
+
+    ERR_RET(on_snapshot(5, "100", "1"));
+    ERR_RET(check(book, 6, "101", "2"));
+    if (list_len(book->pending) != 0)
+        return -__LINE__;
+    return 0;
+}
+
+// 快照领先于kafka消息，同步后到达的旧消息被忽略，不触发重新同步
+static int test_snapshot_ahead(struct depth_book *book)
+{
+    ERR_RET(on_snapshot(10, "102", "3"));
+    ERR_RET(check(book, 10, "102", "3"));
+
+    for (uint64_t seq = 7; seq <= 10; ++seq) {
+        ERR_RET(on_message(seq, "102", "9"));
+        ERR_RET(check(book, 10, "102", "3"));
+    }
+
+    ERR_RET(on_message(11, "102", "0"));
+    ERR_RET(check(book, 11, "102", "0"));
+    ERR_RET(on_message(12, "103", "4"));
+    ERR_RET(check(book, 12, "103", "4"));
+    return 0;
+}
+
+// 消息缺失时重新同步
+static int test_gap(struct depth_book *book)
+{
+    if (on_message(14, "103", "5") >= 0)
+        return -__LINE__;
+    if (book->synced)
+        return -__LINE__;
+
+    ERR_RET(on_message(15, "104", "6"));
+    ERR_RET(on_snapshot(14, "103", "5"));
+    ERR_RET(check(book, 15, "104", "6"));
+    ERR_RET(check(book, 15, "103", "5"));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    dict_types dt;
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = dict_book_hash_func;
+    dt.key_compare = dict_book_key_compare;
+    dt.key_dup = dict_book_key_dup;
+    dt.key_destructor = dict_book_key_free;
+    dt.val_dup = dict_book_val_dup;
+    dt.val_destructor = dict_book_val_free;
+    dict_book = dict_create(&dt, 64);
+
+    struct depth_book *book = get_book(MARKET);
+    if (book == NULL)
+        return 1;
+
+    int ret = test_pending(book);
+    if (ret == 0)
+        ret = test_snapshot_ahead(book);
+    if (ret == 0)
+        ret = test_gap(book);
+    if (ret < 0) {
+        printf("test fail: %d\n", ret);
+        return 1;
+    }
+
+    printf("ok\n");
+    return 0;
+}
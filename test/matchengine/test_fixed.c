@@ -0,0 +1,251 @@
+/*
+ * Description: 同一订单流分别在定点数和高精度交易对上撮合，比较成交、手续费和余额
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# include "me_config.h"
+# include "me_balance.h"
+# include "me_market.h"
+# include "me_history.h"
+# include "me_message.h"
+# include "me_trade.h"
+
+# define USER_NUM    20
+# define USER_OFFSET 1000
+# define ORDER_NUM   20000
+
+struct settings settings;
+
+static market_t *market_decimal;
+static market_t *market_fixed;
+static sds deals_decimal;
+static sds deals_fixed;
+
+market_t *get_market(const char *name)
+{
+    if (strcmp(name, market_decimal->name) == 0)
+        return market_decimal;
+    if (strcmp(name, market_fixed->name) == 0)
+        return market_fixed;
+    return NULL;
+}
+
+int append_order_history(order_t *order)
+{
+    return 0;
+}
+
+int append_user_balance_trade_history(double t, uint32_t user_id, const char *asset, bool negative, mpd_t *change,
+        const char *market, uint64_t order_id, mpd_t *price, mpd_t *amount, mpd_t *fee_rate)
+{
+    return 0;
+}
+
+int push_order_message(uint32_t event, order_t *order, market_t *market)
+{
+    return 0;
+}
+
+int push_deal_message(double t, const char *market, order_t *ask, order_t *bid, mpd_t *price, mpd_t *amount,
+        mpd_t *ask_fee, mpd_t *bid_fee, int side, uint64_t id, const char *stock, const char *money)
+{
+    return 0;
+}
+
+int push_depth_message(market_t *market, json_t *asks, json_t *bids)
+{
+    return 0;
+}
+
+// 两个交易对的成交按相同格式记录，用户id去掉偏移
+int append_order_deal_history(double t, uint64_t deal_id, order_t *ask, int ask_role, order_t *bid, int bid_role,
+        mpd_t *price, mpd_t *amount, mpd_t *deal, mpd_t *ask_fee, mpd_t *bid_fee)
+{
+    sds *deals = strcmp(ask->market, market_fixed->name) == 0 ? &deals_fixed : &deals_decimal;
+    char buf[5][MPD_FORMAT_MAX];
+    mpd_format(buf[0], price, true);
+    mpd_format(buf[1], amount, true);
+    mpd_format(buf[2], deal, true);
+    mpd_format(buf[3], ask_fee, true);
+    mpd_format(buf[4], bid_fee, true);
+    *deals = sdscatprintf(*deals, "%u %u %s %s %s %s %s\n", ask->user_id % USER_OFFSET, bid->user_id % USER_OFFSET,
+            buf[0], buf[1], buf[2], buf[3], buf[4]);
+    return 0;
+}
+
+static mpd_t *random_decimal(long max, int prec)
+{
+    char str[64];
+    long scale = 1;
+    for (int i = 0; i < prec; ++i)
+        scale *= 10;
+    long value = 1 + random() % (max * scale);
+    snprintf(str, sizeof(str), "%ld.%0*ld", value / scale, prec, value % scale);
+    return decimal(str, prec);
+}
+
+static int init_test(void)
+{
+    static struct asset assets[] = {
+        { "BTC", 12, 12 },
+        { "USDT", 12, 12 },
+    };
+    settings.asset_num = 2;
+    settings.assets = assets;
+    if (init_balance() < 0)
+        return -__LINE__;
+
+    struct market conf = { "BTCUSDT", "BTC", "USDT", 4, 6, 4, decimal("0.0001", 0), false };
+    market_decimal = market_create(&conf);
+    conf.name = "BTCUSDT_FIXED";
+    conf.fixed_point = true;
+    market_fixed = market_create(&conf);
+    if (market_decimal == NULL || market_fixed == NULL)
+        return -__LINE__;
+
+    mpd_t *amount = decimal("100000000", 0);
+    for (uint32_t user_id = 1; user_id <= USER_NUM; ++user_id) {
+        balance_set(user_id, BALANCE_TYPE_AVAILABLE, "BTC", amount);
+        balance_set(user_id, BALANCE_TYPE_AVAILABLE, "USDT", amount);
+        balance_set(user_id + USER_OFFSET, BALANCE_TYPE_AVAILABLE, "BTC", amount);
+        balance_set(user_id + USER_OFFSET, BALANCE_TYPE_AVAILABLE, "USDT", amount);
+    }
+    mpd_del(amount);
+
+    deals_decimal = sdsempty();
+    deals_fixed = sdsempty();
+    return 0;
+}
+
+static int put_order(uint32_t *order_ids, size_t *order_num)
+{
+    uint32_t user_id = 1 + random() % USER_NUM;
+    uint32_t side = 1 + random() % 2;
+    bool limit = random() % 10 != 0;
+    mpd_t *amount = random_decimal(limit ? 10 : 1000, limit ? 6 : 4);
+    mpd_t *price = random_decimal(100, 4);
+    mpd_t *taker_fee = random_decimal(1, 4);
+    mpd_t *maker_fee = random_decimal(1, 4);
+    mpd_div(taker_fee, taker_fee, mpd_ten, &mpd_ctx);
+    mpd_div(maker_fee, maker_fee, mpd_ten, &mpd_ctx);
+    mpd_rescale(taker_fee, taker_fee, -4, &mpd_ctx);
+    mpd_rescale(maker_fee, maker_fee, -4, &mpd_ctx);
+
+    int ret[2];
+    json_t *result[2] = { NULL, NULL };
+    market_t *markets[2] = { market_decimal, market_fixed };
+    for (int i = 0; i < 2; ++i) {
+        uint32_t user = user_id + i * USER_OFFSET;
+        if (limit) {
+            ret[i] = market_put_limit_order(true, &result[i], markets[i], user, side, amount, price,
+                    taker_fee, maker_fee, "test");
+        } else {
+            ret[i] = market_put_market_order(true, &result[i], markets[i], user, side, amount, taker_fee, "test");
+        }
+    }
+
+    mpd_del(amount);
+    mpd_del(price);
+    mpd_del(taker_fee);
+    mpd_del(maker_fee);
+    if (ret[0] != ret[1]) {
+        printf("put order result mismatch: %d %d\n", ret[0], ret[1]);
+        return -__LINE__;
+    }
+    if (ret[0] == 0 && limit) {
+        order_ids[*order_num * 2] = json_integer_value(json_object_get(result[0], "id"));
+        order_ids[*order_num * 2 + 1] = json_integer_value(json_object_get(result[1], "id"));
+        *order_num += 1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (result[i])
+            json_decref(result[i]);
+    }
+    return 0;
+}
+
+static int cancel_order(uint32_t *order_ids, size_t order_num)
+{
+    if (order_num == 0)
+        return 0;
+    size_t index = random() % order_num;
+    order_t *order[2];
+    order[0] = market_get_order(market_decimal, order_ids[index * 2]);
+    order[1] = market_get_order(market_fixed, order_ids[index * 2 + 1]);
+    if ((order[0] == NULL) != (order[1] == NULL)) {
+        printf("order %zu exist mismatch\n", index);
+        return -__LINE__;
+    }
+    if (order[0] == NULL)
+        return 0;
+
+    json_t *result[2] = { NULL, NULL };
+    market_cancel_order(true, &result[0], market_decimal, order[0]);
+    market_cancel_order(true, &result[1], market_fixed, order[1]);
+    json_decref(result[0]);
+    json_decref(result[1]);
+    return 0;
+}
+
+static int check_balance(void)
+{
+    const char *assets[] = { "BTC", "USDT" };
+    uint32_t types[] = { BALANCE_TYPE_AVAILABLE, BALANCE_TYPE_FREEZE };
+    for (uint32_t user_id = 1; user_id <= USER_NUM; ++user_id) {
+        for (int i = 0; i < 2; ++i) {
+            for (int j = 0; j < 2; ++j) {
+                mpd_t *a = balance_get(user_id, types[j], assets[i]);
+                mpd_t *b = balance_get(user_id + USER_OFFSET, types[j], assets[i]);
+                if ((a == NULL) != (b == NULL) || (a && mpd_cmp(a, b, &mpd_ctx) != 0)) {
+                    char *sa = a ? mpd_to_sci(a, 0) : strdup("null");
+                    char *sb = b ? mpd_to_sci(b, 0) : strdup("null");
+                    printf("user: %u, type: %u, asset: %s, balance mismatch: %s %s\n",
+                            user_id, types[j], assets[i], sa, sb);
+                    free(sa);
+                    free(sb);
+                    return -__LINE__;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    init_mpd();
+    int ret = init_test();
+    if (ret < 0) {
+        printf("init test fail: %d\n", ret);
+        return 1;
+    }
+
+    uint32_t *order_ids = malloc(sizeof(uint32_t) * ORDER_NUM * 2);
+    size_t order_num = 0;
+    for (int i = 0; i < ORDER_NUM; ++i) {
+        if (random() % 4 == 0) {
+            ret = cancel_order(order_ids, order_num);
+        } else {
+            ret = put_order(order_ids, &order_num);
+        }
+        if (ret < 0) {
+            printf("step %d fail: %d\n", i, ret);
+            return 1;
+        }
+    }
+
+    if (sdslen(deals_decimal) == 0 || strcmp(deals_decimal, deals_fixed) != 0) {
+        printf("deals mismatch, decimal: %zu bytes, fixed: %zu bytes\n", sdslen(deals_decimal), sdslen(deals_fixed));
+        return 1;
+    }
+    if (check_balance() < 0)
+        return 1;
+    if (market_decimal->ask_count != market_fixed->ask_count || market_decimal->bid_count != market_fixed->bid_count) {
+        printf("order book mismatch\n");
+        return 1;
+    }
+
+    printf("orders: %d, deals: %zu bytes, ok\n", ORDER_NUM, sdslen(deals_decimal));
+    free(order_ids);
+    return 0;
+}
@@ -1,15 +1,67 @@
 /*
- * Description: 
- *     History: yang@haipo.me, 2017/06/05, create
+ * Description: mpd_format与mpd_to_sci的结果比较
+ *     History: yang@haipo.me, 2026/10/17, create
  */
 
 # include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
 # include "ut_decimal.h"
 # include "ut_misc.h"
 
+static int check_format(const char *str)
+{
+    mpd_t *value = decimal(str, 0);
+    for (int strip = 0; strip < 2; ++strip) {
+        char buf[MPD_FORMAT_MAX];
+        mpd_format(buf, value, strip);
+        char *expect = mpd_to_sci(value, 0);
+        if (strip)
+            rstripzero(expect);
+        if (strcmp(buf, expect) != 0) {
+            printf("format %s fail: %s, expect: %s\n", str, buf, expect);
+            free(expect);
+            mpd_del(value);
+            return -1;
+        }
+        free(expect);
+    }
+    mpd_del(value);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     init_mpd();
+
+    const char *cases[] = { "0", "-0.00", "100", "100.12345678", "0.000001", "0.0000001", "1E-10", "0E-10",
+        "1E+3", "-12345678901234567890.123", "1234567890123456789012345678901234", "0.1000000000000000000000", NULL };
+    for (int i = 0; cases[i]; ++i) {
+        if (check_format(cases[i]) < 0)
+            return 1;
+    }
+    for (int i = 0; i < 100000; ++i) {
+        char str[64];
+        snprintf(str, sizeof(str), "%s%ld.%0*ldE%d", i % 3 ? "" : "-", random(), i % 20, random() % 100000, (int)(random() % 30) - 20);
+        if (check_format(str) < 0)
+            return 1;
+    }
+
+    // 超出缓冲区的数值不截断，返回0
+    mpd_context_t ctx;
+    mpd_maxcontext(&ctx);
+    char str[MPD_FORMAT_MAX + 8];
+    memset(str, '9', MPD_FORMAT_MAX + 2);
+    str[MPD_FORMAT_MAX + 2] = '\0';
+    mpd_t *big = mpd_new(&ctx);
+    mpd_set_string(big, str, &ctx);
+    char buf[MPD_FORMAT_MAX];
+    if (mpd_format(buf, big, false) != 0 || buf[0] != '\0') {
+        printf("format %zu digits fail: %s\n", (size_t)big->digits, buf);
+        return 1;
+    }
+    mpd_del(big);
+
     mpd_t *a = decimal("100.12345678", 0);
     mpd_t *b = decimal("200.12345678", 0);
     mpd_t *c = mpd_new(&mpd_ctx);
@@ -0,0 +1,184 @@
+/*
+ * Description: dict_t在渐进式rehash期间的查找、添加、删除和遍历
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include "ut_dict.h"
+
+# define KEY_MAX 100000
+
+static uint32_t key_hash(const void *key)
+{
+    return dict_generic_hash_function(key, sizeof(uint32_t));
+}
+
+static int key_compare(const void *key1, const void *key2)
+{
+    return memcmp(key1, key2, sizeof(uint32_t));
+}
+
+static void *key_dup(const void *key)
+{
+    uint32_t *obj = malloc(sizeof(uint32_t));
+    memcpy(obj, key, sizeof(uint32_t));
+    return obj;
+}
+
+static void key_free(void *key)
+{
+    free(key);
+}
+
+static uint8_t exist[KEY_MAX];
+static uint8_t visit[KEY_MAX];
+
+static dict_t *create(void)
+{
+    dict_types dt;
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = key_hash;
+    dt.key_compare = key_compare;
+    dt.key_dup = key_dup;
+    dt.key_destructor = key_free;
+    return dict_create(&dt, 4);
+}
+
+static int add(dict_t *dict, uint32_t key)
+{
+    if (dict_add(dict, &key, (void *)(uintptr_t)key) == NULL)
+        return -1;
+    exist[key] = 1;
+    return 0;
+}
+
+// 所有key都能查到，值正确，数量一致
+static int check(dict_t *dict)
+{
+    uint32_t count = 0;
+    for (uint32_t key = 0; key < KEY_MAX; ++key) {
+        dict_entry *entry = dict_find(dict, &key);
+        if ((entry != NULL) != exist[key]) {
+            printf("find %u: %p, expect exist: %d\n", key, (void *)entry, exist[key]);
+            return -1;
+        }
+        if (entry && (uintptr_t)entry->val != key) {
+            printf("find %u: value %lu\n", key, (uintptr_t)entry->val);
+            return -1;
+        }
+        count += exist[key];
+    }
+    if (dict_size(dict) != count) {
+        printf("size: %u, expect: %u\n", dict_size(dict), count);
+        return -1;
+    }
+    return 0;
+}
+
+// 查找不改变rehash进度
+static int test_find(dict_t *dict)
+{
+    uint32_t key = 0;
+    while (!dict_is_rehashing(dict)) {
+        if (add(dict, key++) < 0)
+            return -1;
+    }
+    uint32_t index = dict->rehash_index;
+    uint32_t rehash_used = dict->rehash_used;
+    if (check(dict) < 0)
+        return -1;
+    if (!dict_is_rehashing(dict) || dict->rehash_index != index || dict->rehash_used != rehash_used) {
+        printf("find moved entries, index: %u -> %u\n", index, dict->rehash_index);
+        return -1;
+    }
+    return 0;
+}
+
+// rehash期间交替添加和删除
+static int test_add_delete(dict_t *dict)
+{
+    int rehashing = 0;
+    for (uint32_t i = 0; i < KEY_MAX * 4; ++i) {
+        uint32_t key = random() % KEY_MAX;
+        if (exist[key]) {
+            if (dict_delete(dict, &key) != 1) {
+                printf("delete %u fail\n", key);
+                return -1;
+            }
+            exist[key] = 0;
+        } else if (add(dict, key) < 0) {
+            printf("add %u fail\n", key);
+            return -1;
+        }
+        rehashing += dict_is_rehashing(dict);
+    }
+    if (rehashing == 0) {
+        printf("no rehash happened\n");
+        return -1;
+    }
+    return check(dict);
+}
+
+// 遍历期间删除当前项、添加新项，遍历开始时存在的项恰好访问一次
+static int test_iterate(dict_t *dict)
+{
+    while (!dict_is_rehashing(dict)) {
+        uint32_t key = random() % KEY_MAX;
+        if (!exist[key] && add(dict, key) < 0)
+            return -1;
+    }
+
+    uint8_t before[KEY_MAX];
+    memcpy(before, exist, sizeof(exist));
+    memset(visit, 0, sizeof(visit));
+
+    dict_iterator *iter = dict_get_iterator(dict);
+    dict_entry *entry;
+    while ((entry = dict_next(iter)) != NULL) {
+        uint32_t key = *(uint32_t *)entry->key;
+        if (visit[key]++) {
+            printf("key %u visited twice\n", key);
+            return -1;
+        }
+        if (key % 3 == 0) {
+            dict_delete(dict, &key);
+            exist[key] = 0;
+        }
+        uint32_t new_key = random() % KEY_MAX;
+        if (!exist[new_key] && !before[new_key] && add(dict, new_key) < 0)
+            return -1;
+    }
+    dict_release_iterator(iter);
+
+    for (uint32_t key = 0; key < KEY_MAX; ++key) {
+        if (before[key] && !visit[key]) {
+            printf("key %u not visited\n", key);
+            return -1;
+        }
+    }
+    return check(dict);
+}
+
+int main(int argc, char *argv[])
+{
+    dict_t *dict = create();
+    if (test_find(dict) < 0)
+        return 1;
+    if (test_add_delete(dict) < 0)
+        return 1;
+    if (test_iterate(dict) < 0)
+        return 1;
+
+    // 删除全部后rehash可以完成
+    dict_clear(dict);
+    memset(exist, 0, sizeof(exist));
+    if (check(dict) < 0)
+        return 1;
+    dict_release(dict);
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Description: hashmap_t与dict_t的性能对比，以及遍历期间扩容的正确性
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/time.h>
+
+# include "ut_dict.h"
+# include "ut_hashmap.h"
+
+struct key {
+    uint32_t user_id;
+    uint32_t type;
+    char     asset[16];
+};
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static uint32_t key_hash(const void *key)
+{
+    return dict_generic_hash_function(key, sizeof(struct key));
+}
+
+static int key_compare(const void *key1, const void *key2)
+{
+    return memcmp(key1, key2, sizeof(struct key));
+}
+
+static void *key_dup(const void *key)
+{
+    struct key *obj = malloc(sizeof(struct key));
+    memcpy(obj, key, sizeof(struct key));
+    return obj;
+}
+
+static void key_free(void *key)
+{
+    free(key);
+}
+
+static const char *assets[] = { "BTC", "ETH", "BCH", "LTC" };
+
+static void make_key(struct key *key, uint32_t i)
+{
+    memset(key, 0, sizeof(struct key));
+    key->user_id = i / 8;
+    key->type = 1 + i % 2;
+    strcpy(key->asset, assets[(i / 2) % 4]);
+}
+
+static uint32_t id_hash(const void *key)
+{
+    return *(uint32_t *)key;
+}
+
+# define ITER_KEY_MAX 200000
+
+static uint8_t exist[ITER_KEY_MAX];
+static uint8_t visit[ITER_KEY_MAX];
+
+// 遍历期间添加大量新项触发多次扩容，遍历开始时存在的项恰好访问一次
+static int test_iterate(void)
+{
+    hashmap_types ht;
+    memset(&ht, 0, sizeof(ht));
+    ht.hash_function = id_hash;
+    hashmap_t *map = hashmap_create(&ht, sizeof(uint32_t), sizeof(uint32_t), 16);
+
+    uint32_t key = 0;
+    while (!hashmap_is_rehashing(map) || key < 1000) {
+        hashmap_add(map, &key, &key);
+        exist[key++] = 1;
+    }
+
+    uint8_t *before = malloc(ITER_KEY_MAX);
+    memcpy(before, exist, ITER_KEY_MAX);
+    uint32_t next_key = key;
+    hashmap_iterator *iter = hashmap_get_iterator(map);
+    uint32_t *val;
+    uint32_t *k;
+    while ((k = hashmap_next(iter, (void **)&val)) != NULL) {
+        uint32_t id = *k;
+        if (*val != id || visit[id]++) {
+            printf("key %u visited twice or value %u\n", id, *val);
+            return -1;
+        }
+        if (id % 3 == 0) {
+            hashmap_delete(map, &id);
+            exist[id] = 0;
+        }
+        for (int i = 0; i < 8 && next_key < ITER_KEY_MAX; ++i, ++next_key) {
+            if (hashmap_add(map, &next_key, &next_key) == NULL) {
+                printf("add %u fail while iterating\n", next_key);
+                return -1;
+            }
+            exist[next_key] = 1;
+        }
+    }
+    hashmap_release_iterator(iter);
+    if (map->old_num < 2) {
+        printf("no grow while iterating\n");
+        return -1;
+    }
+
+    uint32_t count = 0;
+    for (key = 0; key < ITER_KEY_MAX; ++key) {
+        if (before[key] && !visit[key]) {
+            printf("key %u not visited\n", key);
+            return -1;
+        }
+        val = hashmap_find(map, &key);
+        if ((val != NULL) != exist[key] || (val && *val != key)) {
+            printf("find %u fail\n", key);
+            return -1;
+        }
+        count += exist[key];
+    }
+    if (hashmap_size(map) != count) {
+        printf("size mismatch: %u %u\n", hashmap_size(map), count);
+        return -1;
+    }
+
+    // 遍历结束后旧表可以全部迁移
+    while (hashmap_rehash(map, 1024));
+    key = ITER_KEY_MAX;
+    hashmap_add(map, &key, &key);
+    while (hashmap_rehash(map, 1024));
+    if (hashmap_is_rehashing(map)) {
+        printf("rehash not finished, old tables: %u\n", map->old_num);
+        return -1;
+    }
+
+    free(before);
+    hashmap_release(map);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (test_iterate() < 0)
+        return 1;
+
+    uint32_t count = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t *order = malloc(sizeof(uint32_t) * count);
+    for (uint32_t i = 0; i < count; ++i)
+        order[i] = i;
+    for (uint32_t i = count - 1; i > 0; --i) {
+        uint32_t j = random() % (i + 1);
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    dict_types dt;
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = key_hash;
+    dt.key_compare = key_compare;
+    dt.key_dup = key_dup;
+    dt.key_destructor = key_free;
+    dict_t *dict = dict_create(&dt, 64);
+
+    hashmap_types ht;
+    memset(&ht, 0, sizeof(ht));
+    ht.hash_function = key_hash;
+    hashmap_t *map = hashmap_create(&ht, sizeof(struct key), sizeof(void *), 64);
+
+    struct key key;
+    double start = now();
+    for (uint32_t i = 0; i < count; ++i) {
+        make_key(&key, i);
+        dict_add(dict, &key, (void *)(uintptr_t)i);
+    }
+    printf("dict    add:    %.3fs\n", now() - start);
+
+    start = now();
+    for (uint32_t i = 0; i < count; ++i) {
+        make_key(&key, i);
+        void *val = (void *)(uintptr_t)i;
+        hashmap_add(map, &key, &val);
+    }
+    printf("hashmap add:    %.3fs\n", now() - start);
+
+    start = now();
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        make_key(&key, order[i]);
+        dict_entry *entry = dict_find(dict, &key);
+        sum += (uintptr_t)entry->val;
+    }
+    printf("dict    find:   %.3fs\n", now() - start);
+
+    start = now();
+    uint64_t sum2 = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        make_key(&key, order[i]);
+        void **val = hashmap_find(map, &key);
+        sum2 += (uintptr_t)*val;
+    }
+    printf("hashmap find:   %.3fs\n", now() - start);
+    if (sum != sum2) {
+        printf("mismatch: %lu %lu\n", sum, sum2);
+        return 1;
+    }
+
+    start = now();
+    for (uint32_t i = 0; i < count; i += 2) {
+        make_key(&key, order[i]);
+        dict_delete(dict, &key);
+    }
+    printf("dict    delete: %.3fs\n", now() - start);
+
+    start = now();
+    for (uint32_t i = 0; i < count; i += 2) {
+        make_key(&key, order[i]);
+        hashmap_delete(map, &key);
+    }
+    printf("hashmap delete: %.3fs\n", now() - start);
+    if (dict_size(dict) != hashmap_size(map)) {
+        printf("size mismatch: %u %u\n", dict_size(dict), hashmap_size(map));
+        return 1;
+    }
+
+    dict_release(dict);
+    hashmap_release(map);
+    free(order);
+
+    return 0;
+}
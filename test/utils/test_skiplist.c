@@ -56,7 +56,15 @@ int main(int argc, char *argv[])
         printf("\n");
     }
 
+    for (unsigned long i = 0; i < skiplist_len(list); i += 5) {
+        skiplist_node *node = skiplist_seek(list, i, NULL);
+        printf("rank %lu: %s\n", i, (char *)node->value);
+    }
+
     sds value = sdsnew("k");
+    skiplist_set_weight(list, value, 10);
+    printf("weight: %ld\n", skiplist_weight(list));
+
     skiplist_delete(list, skiplist_find(list, value));
     sdsfree(value);
 
@@ -196,6 +196,7 @@ int load_cfg_rpc_clt(json_t *root, const char *key, rpc_clt_cfg *cfg) {
                         false, 0));
   ERR_RET(read_cfg_real(node, "heartbeat_timeout", &cfg->heartbeat_timeout,
                         false, 0));
+  ERR_RET(read_cfg_bool(node, "binary_body", &cfg->binary_body, false, false));
 
   return 0;
 }
@@ -325,6 +326,14 @@ int load_cfg_ws_svr(json_t *root, const char *key, ws_svr_cfg *cfg) {
   ERR_RET(read_cfg_int(node, "keep_alive", &cfg->keep_alive, false, 3600));
   ERR_RET(read_cfg_str(node, "protocol", &cfg->protocol, "chat"));
   ERR_RET(read_cfg_str(node, "origin", &cfg->origin, ""));
+  ERR_RET(read_cfg_bool(node, "deflate", &cfg->deflate, false, false));
+  ERR_RET(read_cfg_int(node, "deflate_level", &cfg->deflate_level, false, 6));
+  ERR_RET(read_cfg_int(node, "deflate_window_bits", &cfg->deflate_window_bits,
+                       false, 15));
+  ERR_RET(read_cfg_bool(node, "deflate_no_context_takeover",
+                        &cfg->deflate_no_context_takeover, false, true));
+  ERR_RET(read_cfg_uint32(node, "deflate_min_size", &cfg->deflate_min_size,
+                          false, 128));
 
   return 0;
 }
@@ -75,8 +75,12 @@ static const unsigned int crc_c[256] = {
 };
 
 uint32_t generate_crc32c(const char *buffer, size_t length) {
+  return update_crc32c(0, buffer, length);
+}
+
+uint32_t update_crc32c(uint32_t crc, const char *buffer, size_t length) {
   size_t i;
-  uint32_t crc32 = ~0L;
+  uint32_t crc32 = ~crc;
 
   for (i = 0; i < length; i++){
       CRC32C(crc32, (unsigned char)buffer[i]);
@@ -10,5 +10,7 @@
 # include <stdint.h>
 
 uint32_t generate_crc32c(const char *string, size_t length);
+/* continue a crc over the next block, start with crc 0 */
+uint32_t update_crc32c(uint32_t crc, const char *string, size_t length);
 
 # endif
@@ -3,6 +3,8 @@
  *     History: yang@haipo.me, 2017/03/17, create
  */
 
+#include <string.h>
+
 #include "ut_decimal.h"
 
 mpd_context_t mpd_ctx; //精确计算的上下文配置
@@ -76,3 +78,158 @@ int json_array_append_new_mpd(json_t *obj, mpd_t *value) {
   free(str);
   return ret;
 }
+
+// 系数的十进制数字，返回位数
+static size_t mpd_coeff_digits(char *buf, const mpd_t *value) {
+  char *p = buf;
+  for (mpd_ssize_t i = value->len - 1; i >= 0; --i) {
+    char word[MPD_RDIGITS];
+    mpd_uint_t w = value->data[i];
+    int n = 0;
+    do {
+      word[n++] = '0' + w % 10;
+      w /= 10;
+    } while (w);
+    // 除最高位的字外，每个字补足MPD_RDIGITS位
+    if (i != value->len - 1) {
+      while (n < MPD_RDIGITS)
+        word[n++] = '0';
+    }
+    while (n > 0)
+      *p++ = word[--n];
+  }
+  return p - buf;
+}
+
+size_t mpd_format(char *buf, const mpd_t *value, bool strip) {
+  if (mpd_isspecial(value) || value->digits > MPD_FORMAT_MAX / 2) {
+    char *str = mpd_to_sci(value, 0);
+    if (strip)
+      rstripzero(str);
+    size_t len = strlen(str);
+    if (len >= MPD_FORMAT_MAX) {
+      // 不截断，由调用方放弃这次写入
+      buf[0] = '\0';
+      free(str);
+      return 0;
+    }
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    free(str);
+    return len;
+  }
+
+  char coeff[MPD_FORMAT_MAX];
+  size_t digits = mpd_coeff_digits(coeff, value);
+  mpd_ssize_t exp = value->exp;
+  mpd_ssize_t adjexp = exp + (mpd_ssize_t)digits - 1;
+  char *p = buf;
+  if (mpd_isnegative(value))
+    *p++ = '-';
+
+  if (exp <= 0 && adjexp >= -6) {
+    // 普通记法
+    mpd_ssize_t point = (mpd_ssize_t)digits + exp;
+    if (exp == 0) {
+      memcpy(p, coeff, digits);
+      p += digits;
+    } else if (point > 0) {
+      memcpy(p, coeff, point);
+      p += point;
+      *p++ = '.';
+      memcpy(p, coeff + point, digits - point);
+      p += digits - point;
+    } else {
+      *p++ = '0';
+      *p++ = '.';
+      for (mpd_ssize_t i = point; i < 0; ++i)
+        *p++ = '0';
+      memcpy(p, coeff, digits);
+      p += digits;
+    }
+    if (strip && exp < 0) {
+      while (p[-1] == '0')
+        --p;
+      if (p[-1] == '.')
+        --p;
+    }
+  } else {
+    // 科学记法，与rstripzero一致不做去零处理
+    *p++ = coeff[0];
+    if (digits > 1) {
+      *p++ = '.';
+      memcpy(p, coeff + 1, digits - 1);
+      p += digits - 1;
+    }
+    *p++ = 'e';
+    *p++ = adjexp < 0 ? '-' : '+';
+    uint64_t e = adjexp < 0 ? -adjexp : adjexp;
+    char tmp[24];
+    int n = 0;
+    do {
+      tmp[n++] = '0' + e % 10;
+      e /= 10;
+    } while (e);
+    while (n > 0)
+      *p++ = tmp[--n];
+  }
+
+  *p = '\0';
+  return p - buf;
+}
+
+fixed_t fixed_pow10(int n) {
+  fixed_t result = 1;
+  while (n-- > 0) {
+    result *= 10;
+  }
+  return result;
+}
+
+int mpd_get_fixed(const mpd_t *value, int prec, fixed_t *result) {
+  uint32_t status = 0;
+  mpd_uint_t data[MPD_MINALLOC_MAX];
+  mpd_t tmp = {MPD_STATIC | MPD_STATIC_DATA, 0, 0, 0, MPD_MINALLOC_MAX, data};
+
+  mpd_qrescale(&tmp, value, -prec, &mpd_ctx, &status);
+  if ((status & (MPD_Inexact | MPD_Invalid_operation)) ||
+      tmp.digits > FIXED_MAX_DIGITS) {
+    mpd_del(&tmp);
+    return -1;
+  }
+
+  // coefficient is stored as little endian words of base MPD_RADIX
+  unsigned __int128 coeff = 0;
+  for (mpd_ssize_t i = tmp.len - 1; i >= 0; --i) {
+    coeff = coeff * MPD_RADIX + tmp.data[i];
+  }
+  *result = mpd_isnegative(&tmp) ? -(fixed_t)coeff : (fixed_t)coeff;
+  mpd_del(&tmp);
+
+  return 0;
+}
+
+void mpd_set_fixed(mpd_t *result, fixed_t value, int prec) {
+  uint32_t status = 0;
+  unsigned __int128 coeff =
+      value < 0 ? -(unsigned __int128)value : (unsigned __int128)value;
+
+  // |fixed_t| has at most 39 digits, MPD_RDIGITS digits per word
+  mpd_uint_t words[(39 + MPD_RDIGITS - 1) / MPD_RDIGITS];
+  mpd_ssize_t len = 0;
+  do {
+    words[len++] = (mpd_uint_t)(coeff % MPD_RADIX);
+    coeff /= MPD_RADIX;
+  } while (coeff);
+
+  if (!mpd_qresize(result, len, &status)) {
+    mpd_set_string(result, "NaN", &mpd_ctx);
+    return;
+  }
+  memcpy(result->data, words, len * sizeof(mpd_uint_t));
+  mpd_clear_flags(result);
+  mpd_set_sign(result, value < 0 ? MPD_NEG : MPD_POS);
+  result->exp = -prec;
+  result->len = len;
+  mpd_setdigits(result);
+}
@@ -6,6 +6,7 @@
 # ifndef _UT_DECIMAL_H_
 # define _UT_DECIMAL_H_
 
+# include <stdbool.h>
 # include <mpdecimal.h>
 # include <jansson.h>
 
@@ -22,5 +23,20 @@ char *rstripzero(char *str);
 int json_object_set_new_mpd(json_t *obj, const char *key, mpd_t *value);
 int json_array_append_new_mpd(json_t *obj, mpd_t *value);
 
+/* scaled integer form of a decimal: value * 10^prec, exact within 34 digits */
+typedef __int128 fixed_t;
+
+# define FIXED_MAX_DIGITS 34
+
+/* mpd_to_sci(value, 0) written into buf without allocation, buf needs
+ * MPD_FORMAT_MAX bytes; strip has the same effect as rstripzero.
+ * returns 0 and leaves buf empty if the result does not fit */
+# define MPD_FORMAT_MAX 128
+size_t mpd_format(char *buf, const mpd_t *value, bool strip);
+
+fixed_t fixed_pow10(int n);
+int mpd_get_fixed(const mpd_t *value, int prec, fixed_t *result);
+void mpd_set_fixed(mpd_t *result, fixed_t value, int prec);
+
 # endif
 
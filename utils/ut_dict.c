@@ -88,43 +88,81 @@ dict_t *dict_create(dict_types *type, uint32_t init_size)
 
 int dict_expand(dict_t *dt, uint32_t size)
 {
-    dict_t new;
-    memcpy(&new, dt, sizeof(dict_t));
-    new.size = dict_next_power(size);
-    new.mask = new.size - 1;
-    new.table = calloc(new.size, sizeof(dict_entry *));
-    if (new.table == NULL)
+    /* finish the previous expanding first */
+    if (dt->rehash_table) {
+        if (dt->iterators > 0)
+            return -1;
+        while (dict_rehash(dt, 1024));
+    }
+
+    uint32_t realsize = dict_next_power(size);
+    dict_entry **table = calloc(realsize, sizeof(dict_entry *));
+    if (table == NULL)
         return -1;
 
-    for (uint32_t i = 0; i < dt->size && dt->used > 0; ++i) {
-        dict_entry *entry = dt->table[i];
-        dict_entry *next_entry = NULL;
+    dt->rehash_table = table;
+    dt->rehash_size = realsize;
+    dt->rehash_mask = realsize - 1;
+    dt->rehash_used = 0;
+    dt->rehash_index = 0;
+
+    return 0;
+}
+
+/* move at most n buckets to the new table, return 1 if there is more to do */
+int dict_rehash(dict_t *dt, uint32_t n)
+{
+    if (dt->rehash_table == NULL || dt->iterators > 0)
+        return 0;
+
+    uint32_t empty_visits = n * 10;
+    while (n > 0 && dt->used > dt->rehash_used) {
+        dict_entry *entry = dt->table[dt->rehash_index];
+        if (entry == NULL) {
+            dt->rehash_index++;
+            if (--empty_visits == 0)
+                return 1;
+            continue;
+        }
         while (entry) {
-            next_entry = entry->next;
-            uint32_t index = DICT_HASH_KEY(dt, entry->key) & new.mask;
-            entry->next = new.table[index];
-            new.table[index] = entry;
+            dict_entry *next_entry = entry->next;
+            uint32_t index = DICT_HASH_KEY(dt, entry->key) & dt->rehash_mask;
+            entry->next = dt->rehash_table[index];
+            dt->rehash_table[index] = entry;
+            dt->rehash_used++;
             entry = next_entry;
-            dt->used--;
         }
+        dt->table[dt->rehash_index++] = NULL;
+        n--;
     }
+    if (dt->used > dt->rehash_used)
+        return 1;
 
     free(dt->table);
-    memcpy(dt, &new, sizeof(dict_t));
+    dt->table = dt->rehash_table;
+    dt->size = dt->rehash_size;
+    dt->mask = dt->rehash_mask;
+    dt->rehash_table = NULL;
+    dt->rehash_size = 0;
+    dt->rehash_mask = 0;
+    dt->rehash_used = 0;
+    dt->rehash_index = 0;
 
     return 0;
 }
 
 static int dict_expand_if_needed(dict_t *dt)
 {
+    if (dt->rehash_table)
+        return 0;
     if (dt->used >= dt->size * 4)
         return dict_expand(dt, dt->size * 4);
     return 0;
 }
 
-static void check_clear(dict_t *dt, uint32_t index)
+static void check_clear(dict_t *dt, dict_entry **table, uint32_t index, int rehash)
 {
-    dict_entry *entry = dt->table[index];
+    dict_entry *entry = table[index];
     dict_entry *prev = NULL;
     dict_entry *next = NULL;
     
@@ -134,13 +172,15 @@ static void check_clear(dict_t *dt, uint32_t index)
             if (prev) {
                 prev->next = next;
             } else {
-                dt->table[index] = next;
+                table[index] = next;
             }
             DICT_FREE_HASH_KEY(dt, entry);
             DICT_FREE_HASH_VAL(dt, entry);
             free(entry);
             entry = NULL;
             dt->used--;
+            if (rehash)
+                dt->rehash_used--;
         }
         if (entry)
             prev = entry;
@@ -148,13 +188,12 @@ static void check_clear(dict_t *dt, uint32_t index)
     }
 }
 
-dict_entry *dict_find(dict_t *dt, const void *key)
+static dict_entry *find_entry(dict_t *dt, dict_entry **table, uint32_t index, int rehash, const void *key)
 {
-    uint32_t index = DICT_HASH_KEY(dt, key) & dt->mask;
     if (dt->id_clear > 0) {
-        check_clear(dt, index);
+        check_clear(dt, table, index, rehash);
     }
-    dict_entry *entry = dt->table[index];
+    dict_entry *entry = table[index];
     while (entry) {
         if (DICT_COMPARE_KEY(dt, key, entry->key) == 0)
             return entry;
@@ -163,8 +202,20 @@ dict_entry *dict_find(dict_t *dt, const void *key)
     return NULL;
 }
 
+/* lookups do not move entries, rehash is advanced by add and delete */
+dict_entry *dict_find(dict_t *dt, const void *key)
+{
+    uint32_t hash = DICT_HASH_KEY(dt, key);
+    dict_entry *entry = find_entry(dt, dt->table, hash & dt->mask, 0, key);
+    if (entry == NULL && dt->rehash_table) {
+        entry = find_entry(dt, dt->rehash_table, hash & dt->rehash_mask, 1, key);
+    }
+    return entry;
+}
+
 dict_entry *dict_add(dict_t *dt, void *key, void *val)
 {
+    dict_rehash(dt, 1);
     if (dict_find(dt, key) != NULL)
         return NULL;
     if (dict_expand_if_needed(dt) != 0)
@@ -173,10 +224,17 @@ dict_entry *dict_add(dict_t *dt, void *key, void *val)
     if (entry == NULL)
         return NULL;
 
-    uint32_t index = DICT_HASH_KEY(dt, key) & dt->mask;
+    uint32_t hash = DICT_HASH_KEY(dt, key);
+    dict_entry **table = dt->table;
+    uint32_t index = hash & dt->mask;
+    if (dt->rehash_table) {
+        table = dt->rehash_table;
+        index = hash & dt->rehash_mask;
+        dt->rehash_used++;
+    }
     entry->id = dt->id_start++;
-    entry->next = dt->table[index];
-    dt->table[index] = entry;
+    entry->next = table[index];
+    table[index] = entry;
     DICT_SET_HASH_KEY(dt, entry, key);
     DICT_SET_HASH_VAL(dt, entry, val);
     dt->used++;
@@ -200,10 +258,9 @@ int dict_replace(dict_t *dt, void *key, void *val)
     return 0;
 }
 
-int dict_delete(dict_t *dt, const void *key)
+static int delete_entry(dict_t *dt, dict_entry **table, uint32_t index, int rehash, const void *key)
 {
-    uint32_t index = DICT_HASH_KEY(dt, key) & dt->mask;
-    dict_entry *entry = dt->table[index];
+    dict_entry *entry = table[index];
     dict_entry *prev = NULL;
     
     while (entry) {
@@ -211,12 +268,14 @@ int dict_delete(dict_t *dt, const void *key)
             if (prev) {
                 prev->next = entry->next;
             } else {
-                dt->table[index] = entry->next;
+                table[index] = entry->next;
             }
             DICT_FREE_HASH_KEY(dt, entry);
             DICT_FREE_HASH_VAL(dt, entry);
             free(entry);
             dt->used--;
+            if (rehash)
+                dt->rehash_used--;
             return 1;
         }
         prev = entry;
@@ -226,6 +285,18 @@ int dict_delete(dict_t *dt, const void *key)
     return 0;
 }
 
+int dict_delete(dict_t *dt, const void *key)
+{
+    dict_rehash(dt, 1);
+    uint32_t hash = DICT_HASH_KEY(dt, key);
+    if (delete_entry(dt, dt->table, hash & dt->mask, 0, key))
+        return 1;
+    if (dt->rehash_table && delete_entry(dt, dt->rehash_table, hash & dt->rehash_mask, 1, key))
+        return 1;
+
+    return 0;
+}
+
 void dict_clear(dict_t *dt)
 {
     dict_iterator *iter = dict_get_iterator(dt);
@@ -243,10 +314,10 @@ void dict_mark_clear(dict_t *dt)
     dt->id_clear = dt->id_start++;
 }
 
-void dict_release(dict_t *dt)
+static void release_table(dict_t *dt, dict_entry **table, uint32_t size)
 {
-    for (uint32_t i = 0; i < dt->size && dt->used > 0; ++i) {
-        dict_entry *entry = dt->table[i];
+    for (uint32_t i = 0; i < size; ++i) {
+        dict_entry *entry = table[i];
         dict_entry *next_entry = NULL;
         while (entry) {
             next_entry = entry->next;
@@ -256,7 +327,14 @@ void dict_release(dict_t *dt)
             entry = next_entry;
         }
     }
-    free(dt->table);
+    free(table);
+}
+
+void dict_release(dict_t *dt)
+{
+    release_table(dt, dt->table, dt->size);
+    if (dt->rehash_table)
+        release_table(dt, dt->rehash_table, dt->rehash_size);
     free(dt);
 }
 
@@ -268,20 +346,33 @@ dict_iterator *dict_get_iterator(dict_t *dt)
     memset(iter, 0, sizeof(dict_iterator));
     iter->dt = dt;
     iter->index = -1;
+    iter->rehash = 0;
     iter->entry = NULL;
     iter->next_entry = NULL;
+    dt->iterators++;
 
     return iter;
 }
 
 dict_entry *dict_next(dict_iterator *iter)
 {
+    dict_t *dt = iter->dt;
     while (1) {
         if (iter->entry == NULL) {
             iter->index++;
-            if (iter->index >= iter->dt->size)
-                break;
-            iter->entry = iter->dt->table[iter->index];
+            if (!iter->rehash && iter->index >= dt->size) {
+                if (dt->rehash_table == NULL)
+                    break;
+                iter->rehash = 1;
+                iter->index = 0;
+            }
+            if (iter->rehash) {
+                if (iter->index >= dt->rehash_size)
+                    break;
+                iter->entry = dt->rehash_table[iter->index];
+            } else {
+                iter->entry = dt->table[iter->index];
+            }
         } else {
             iter->entry = iter->next_entry;
         }
@@ -295,6 +386,6 @@ dict_entry *dict_next(dict_iterator *iter)
 
 void dict_release_iterator(dict_iterator *iter)
 {
+    iter->dt->iterators--;
     free(iter);
 }
-
@@ -25,6 +25,8 @@ typedef struct dict_types {
     void (*val_destructor)(void *val);
 } dict_types;
 
+/* while expanding, entries are moved from table to rehash_table
+ * a few buckets per add or delete, new entries go to rehash_table */
 typedef struct dict_t {
     dict_entry **table;
     dict_types type;
@@ -33,17 +35,26 @@ typedef struct dict_t {
     uint32_t used;
     uint64_t id_start;
     uint64_t id_clear;
+    dict_entry **rehash_table;
+    uint32_t rehash_size;
+    uint32_t rehash_mask;
+    uint32_t rehash_used;
+    uint32_t rehash_index;
+    int iterators;
 } dict_t;
 
+/* rehash is paused while any iterator is alive */
 typedef struct dict_iterator {
     dict_t *dt;
     int64_t index;
+    int rehash;
     dict_entry *entry;
     dict_entry *next_entry;
 } dict_iterator;
 
 # define dict_size(dt) (dt)->used
 # define dict_slot(dt) (dt)->size
+# define dict_is_rehashing(dt) ((dt)->rehash_table != NULL)
 
 uint32_t dict_generic_hash_function(const void *data, size_t len);
 
@@ -51,6 +62,7 @@ dict_t *dict_create(dict_types *type, uint32_t init_size);
 dict_entry *dict_add(dict_t *dt, void *key, void *val);
 dict_entry *dict_find(dict_t *dt, const void *key);
 int dict_expand(dict_t *dt, uint32_t size);
+int dict_rehash(dict_t *dt, uint32_t n);
 int dict_replace(dict_t *dt, void *key, void *val);
 int dict_delete(dict_t *dt, const void *key);
 void dict_release(dict_t *dt);
@@ -0,0 +1,310 @@
+/*
+ * Description: 开放寻址哈希表，key和value定长内联存储，扩容时渐进式迁移
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include "ut_hashmap.h"
+
+/* one control byte per slot: empty, deleted, or the top 7 bits of the hash */
+# define CTRL_EMPTY     0x80
+# define CTRL_DELETED   0xfe
+# define CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+# define CTRL_TAG(hash) ((hash) >> 25)
+
+# define SLOT_KEY(map, t, i) ((t)->slots + (size_t)(i) * (map)->slot_size)
+# define SLOT_VAL(map, t, i) (SLOT_KEY(map, t, i) + (map)->val_offset)
+
+# define ALIGN8(n) (((n) + 7) & ~7u)
+
+/* user hash functions may return the raw id, mix it so both the
+ * index bits and the control bits are spread */
+static uint32_t hashmap_hash(hashmap_t *map, const void *key)
+{
+    uint32_t h = map->type.hash_function(key);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t hashmap_next_power(uint32_t size)
+{
+    uint32_t realsize = 16;
+    while (realsize < size)
+        realsize *= 2;
+    return realsize;
+}
+
+static int table_alloc(hashmap_t *map, hashmap_table *t, uint32_t size)
+{
+    uint8_t *ctrl = malloc(size);
+    if (ctrl == NULL)
+        return -1;
+    char *slots = malloc((size_t)size * map->slot_size);
+    if (slots == NULL) {
+        free(ctrl);
+        return -1;
+    }
+    memset(ctrl, CTRL_EMPTY, size);
+    t->ctrl = ctrl;
+    t->slots = slots;
+    t->size = size;
+    t->mask = size - 1;
+    t->used = 0;
+    t->deleted = 0;
+    return 0;
+}
+
+static void table_free(hashmap_table *t)
+{
+    free(t->ctrl);
+    free(t->slots);
+    memset(t, 0, sizeof(hashmap_table));
+}
+
+hashmap_t *hashmap_create(hashmap_types *type, uint32_t key_size, uint32_t val_size, uint32_t init_size)
+{
+    if (type->hash_function == NULL || key_size == 0)
+        return NULL;
+    hashmap_t *map = malloc(sizeof(hashmap_t));
+    if (map == NULL)
+        return NULL;
+    memset(map, 0, sizeof(hashmap_t));
+    memcpy(&map->type, type, sizeof(hashmap_types));
+    map->key_size = key_size;
+    map->val_offset = ALIGN8(key_size);
+    map->val_size = val_size;
+    map->slot_size = ALIGN8(map->val_offset + val_size);
+    if (table_alloc(map, &map->table, hashmap_next_power(init_size)) < 0) {
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+static int64_t table_lookup(hashmap_t *map, hashmap_table *t, const void *key, uint32_t hash)
+{
+    uint8_t tag = CTRL_TAG(hash);
+    uint32_t index = hash & t->mask;
+    while (1) {
+        uint8_t c = t->ctrl[index];
+        if (c == CTRL_EMPTY)
+            return -1;
+        if (c == tag && memcmp(SLOT_KEY(map, t, index), key, map->key_size) == 0)
+            return index;
+        index = (index + 1) & t->mask;
+    }
+}
+
+/* slot for a key known to be absent, reuse deleted slots */
+static uint32_t table_insert_slot(hashmap_table *t, uint32_t hash)
+{
+    uint32_t index = hash & t->mask;
+    while (CTRL_IS_FULL(t->ctrl[index]))
+        index = (index + 1) & t->mask;
+    if (t->ctrl[index] == CTRL_DELETED)
+        t->deleted--;
+    t->ctrl[index] = CTRL_TAG(hash);
+    t->used++;
+    return index;
+}
+
+static void table_delete_slot(hashmap_table *t, uint32_t index)
+{
+    /* no probe sequence passes an empty slot, so a slot followed by an
+     * empty one can become empty instead of a tombstone */
+    if (t->ctrl[(index + 1) & t->mask] == CTRL_EMPTY) {
+        t->ctrl[index] = CTRL_EMPTY;
+    } else {
+        t->ctrl[index] = CTRL_DELETED;
+        t->deleted++;
+    }
+    t->used--;
+}
+
+int hashmap_rehash(hashmap_t *map, uint32_t n)
+{
+    if (map->old_num == 0 || map->iterators > 0)
+        return 0;
+
+    hashmap_table *old = &map->old[0];
+    hashmap_table *t = &map->table;
+    uint32_t visits = n * 4;
+    while (n > 0 && visits > 0 && old->used > 0) {
+        /* tables kept while iterating may not fit, wait for the next grow */
+        if ((uint64_t)(t->used + t->deleted + 1) * 4 > (uint64_t)t->size * 3)
+            return 0;
+        uint32_t i = map->rehash_index++;
+        visits--;
+        if (!CTRL_IS_FULL(old->ctrl[i]))
+            continue;
+        char *key = SLOT_KEY(map, old, i);
+        uint32_t index = table_insert_slot(t, hashmap_hash(map, key));
+        memcpy(SLOT_KEY(map, t, index), key, map->slot_size);
+        old->ctrl[i] = CTRL_DELETED;
+        old->used--;
+        n--;
+    }
+    if (old->used > 0)
+        return 1;
+
+    table_free(old);
+    map->old_num--;
+    memmove(&map->old[0], &map->old[1], sizeof(hashmap_table) * map->old_num);
+    map->rehash_index = 0;
+    return map->old_num > 0;
+}
+
+/* allocate a larger table, entries are moved by hashmap_rehash. while
+ * iterating nothing is moved, the full table is appended to old */
+static int hashmap_grow(hashmap_t *map)
+{
+    hashmap_table t;
+    if (table_alloc(map, &t, hashmap_next_power((map->used + 1) * 2)) < 0)
+        return -1;
+    if (map->table.used > 0) {
+        hashmap_table *old = realloc(map->old, sizeof(hashmap_table) * (map->old_num + 1));
+        if (old == NULL) {
+            table_free(&t);
+            return -1;
+        }
+        map->old = old;
+        map->old[map->old_num++] = map->table;
+    } else {
+        table_free(&map->table);
+    }
+    map->table = t;
+
+    /* the new table holds all entries, keep only one old table */
+    while (map->old_num > 1 && hashmap_rehash(map, 1024));
+
+    return 0;
+}
+
+static void *hashmap_lookup(hashmap_t *map, const void *key, uint32_t hash, hashmap_table **table, int64_t *index)
+{
+    *table = &map->table;
+    *index = table_lookup(map, *table, key, hash);
+    for (uint32_t i = map->old_num; *index < 0 && i > 0; --i) {
+        *table = &map->old[i - 1];
+        *index = table_lookup(map, *table, key, hash);
+    }
+    if (*index < 0)
+        return NULL;
+    return SLOT_VAL(map, *table, *index);
+}
+
+void *hashmap_find(hashmap_t *map, const void *key)
+{
+    hashmap_rehash(map, 1);
+    hashmap_table *t;
+    int64_t index;
+    return hashmap_lookup(map, key, hashmap_hash(map, key), &t, &index);
+}
+
+void *hashmap_add(hashmap_t *map, const void *key, const void *val)
+{
+    hashmap_rehash(map, 1);
+    uint32_t hash = hashmap_hash(map, key);
+    hashmap_table *t;
+    int64_t index;
+    if (hashmap_lookup(map, key, hash, &t, &index) != NULL)
+        return NULL;
+
+    /* keep the load factor, counting tombstones, under 3/4 */
+    t = &map->table;
+    if ((uint64_t)(t->used + t->deleted + 1) * 4 > (uint64_t)t->size * 3) {
+        if (hashmap_grow(map) < 0)
+            return NULL;
+    }
+
+    index = table_insert_slot(t, hash);
+    memcpy(SLOT_KEY(map, t, index), key, map->key_size);
+    memcpy(SLOT_VAL(map, t, index), val, map->val_size);
+    map->used++;
+
+    return SLOT_VAL(map, t, index);
+}
+
+int hashmap_delete(hashmap_t *map, const void *key)
+{
+    hashmap_rehash(map, 1);
+    hashmap_table *t;
+    int64_t index;
+    void *val = hashmap_lookup(map, key, hashmap_hash(map, key), &t, &index);
+    if (val == NULL)
+        return 0;
+
+    if (map->type.val_destructor)
+        map->type.val_destructor(val);
+    table_delete_slot(t, index);
+    map->used--;
+
+    return 1;
+}
+
+static void table_release(hashmap_t *map, hashmap_table *t)
+{
+    if (map->type.val_destructor) {
+        for (uint32_t i = 0; i < t->size; ++i) {
+            if (CTRL_IS_FULL(t->ctrl[i]))
+                map->type.val_destructor(SLOT_VAL(map, t, i));
+        }
+    }
+    table_free(t);
+}
+
+void hashmap_release(hashmap_t *map)
+{
+    table_release(map, &map->table);
+    for (uint32_t i = 0; i < map->old_num; ++i)
+        table_release(map, &map->old[i]);
+    free(map->old);
+    free(map);
+}
+
+hashmap_iterator *hashmap_get_iterator(hashmap_t *map)
+{
+    hashmap_iterator *iter = malloc(sizeof(hashmap_iterator));
+    if (iter == NULL)
+        return NULL;
+    iter->map = map;
+    iter->index = -1;
+    iter->table = 0;
+    map->iterators++;
+
+    return iter;
+}
+
+void *hashmap_next(hashmap_iterator *iter, void **val)
+{
+    hashmap_t *map = iter->map;
+    /* old tables are only appended while iterating, so iter->table
+     * keeps pointing at the same table */
+    while (1) {
+        hashmap_table *t = iter->table < map->old_num ? &map->old[iter->table] : &map->table;
+        while (++iter->index < t->size) {
+            if (CTRL_IS_FULL(t->ctrl[iter->index])) {
+                if (val)
+                    *val = SLOT_VAL(map, t, iter->index);
+                return SLOT_KEY(map, t, iter->index);
+            }
+        }
+        if (iter->table >= map->old_num)
+            break;
+        iter->table++;
+        iter->index = -1;
+    }
+    return NULL;
+}
+
+void hashmap_release_iterator(hashmap_iterator *iter)
+{
+    iter->map->iterators--;
+    free(iter);
+}
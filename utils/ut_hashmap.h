@@ -0,0 +1,75 @@
+/*
+ * Description: 开放寻址哈希表，key和value定长内联存储，适用于小的定长key
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+# ifndef _UT_HASHMAP_H_
+# define _UT_HASHMAP_H_
+
+# include <stdint.h>
+# include <stddef.h>
+
+/* keys are compared with memcmp, so padding bytes must be zeroed */
+typedef struct hashmap_types {
+    uint32_t (*hash_function)(const void *key);
+    /* optional, called with a pointer to the stored value */
+    void (*val_destructor)(void *val);
+} hashmap_types;
+
+typedef struct hashmap_table {
+    uint8_t *ctrl;
+    char *slots;
+    uint32_t size;
+    uint32_t mask;
+    uint32_t used;
+    uint32_t deleted;
+} hashmap_table;
+
+/* when growing, entries are moved from old to table a few slots
+ * per operation, so values may move on any add, find or delete.
+ * a grow while iterating keeps the full table in old without moving
+ * anything, so there may be several old tables, oldest first */
+typedef struct hashmap_t {
+    hashmap_types type;
+    hashmap_table table;
+    hashmap_table *old;
+    uint32_t old_num;
+    uint32_t used;
+    uint32_t rehash_index;
+    uint32_t key_size;
+    uint32_t val_offset;
+    uint32_t val_size;
+    uint32_t slot_size;
+    int iterators;
+} hashmap_t;
+
+/* entries are not moved while any iterator is alive, so every entry
+ * present when iteration starts is returned exactly once, entries added
+ * while iterating may or may not be returned. deleting the current entry
+ * while iterating is safe */
+typedef struct hashmap_iterator {
+    hashmap_t *map;
+    int64_t index;
+    uint32_t table;
+} hashmap_iterator;
+
+# define hashmap_size(map) (map)->used
+# define hashmap_slot(map) (map)->table.size
+# define hashmap_is_rehashing(map) ((map)->old_num > 0)
+
+hashmap_t *hashmap_create(hashmap_types *type, uint32_t key_size, uint32_t val_size, uint32_t init_size);
+/* return pointer to the stored value, or NULL */
+void *hashmap_find(hashmap_t *map, const void *key);
+/* copy key and value in, return pointer to the stored value, NULL if key exist */
+void *hashmap_add(hashmap_t *map, const void *key, const void *val);
+int hashmap_delete(hashmap_t *map, const void *key);
+/* move at most n slots to the new table, return 1 if there is more to do */
+int hashmap_rehash(hashmap_t *map, uint32_t n);
+void hashmap_release(hashmap_t *map);
+
+hashmap_iterator *hashmap_get_iterator(hashmap_t *map);
+/* return pointer to the stored key, and set *val to the stored value */
+void *hashmap_next(hashmap_iterator *iter, void **val);
+void hashmap_release_iterator(hashmap_iterator *iter);
+
+# endif
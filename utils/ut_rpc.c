@@ -9,6 +9,7 @@
 # include "ut_rpc.h"
 # include "ut_crc32.h"
 # include "ut_misc.h"
+# include "ut_pack.h"
 
 int rpc_decode(nw_ses *ses, void *data, size_t max)
 {
@@ -94,3 +95,267 @@ int rpc_send(nw_ses *ses, rpc_pkg *pkg)
     return nw_ses_send(ses, data, size);
 }
 
+
+/*
+ * 二进制包体：每个值为1字节标签加内容
+ * 整数为zigzag后的varint，浮点数为8字节，字符串、数组、对象先写varint长度，
+ * 对象的键包含结尾的'\0'，解析时直接引用接收缓冲区
+ */
+
+# define BODY_TAG_NULL      0
+# define BODY_TAG_TRUE      1
+# define BODY_TAG_FALSE     2
+# define BODY_TAG_INTEGER   3
+# define BODY_TAG_REAL      4
+# define BODY_TAG_STRING    5
+# define BODY_TAG_ARRAY     6
+# define BODY_TAG_OBJECT    7
+
+# define BODY_MAX_DEPTH     64
+
+static const uint8_t body_types[] = { RPC_BODY_JSON, RPC_BODY_BINARY };
+
+struct body_buf {
+    char   *data;
+    size_t  size;
+    void   *p;
+    size_t  left;
+};
+
+static int body_reserve(struct body_buf *buf, size_t len)
+{
+    if (buf->left >= len)
+        return 0;
+    size_t used = buf->size - buf->left;
+    size_t size = buf->size ? buf->size * 2 : 256;
+    while (size - used < len)
+        size *= 2;
+    char *data = realloc(buf->data, size);
+    if (data == NULL)
+        return -1;
+    buf->data = data;
+    buf->size = size;
+    buf->p    = data + used;
+    buf->left = size - used;
+    return 0;
+}
+
+static int body_pack_tag(struct body_buf *buf, uint8_t tag, uint64_t num)
+{
+    if (body_reserve(buf, 10) < 0)
+        return -1;
+    pack_char(&buf->p, &buf->left, tag);
+    return pack_varint_le(&buf->p, &buf->left, num);
+}
+
+static int body_pack_str(struct body_buf *buf, uint8_t tag, const char *str, size_t len)
+{
+    if (body_pack_tag(buf, tag, len) < 0)
+        return -1;
+    if (body_reserve(buf, len) < 0)
+        return -1;
+    return pack_buf(&buf->p, &buf->left, str, len);
+}
+
+static int body_pack(struct body_buf *buf, const json_t *json, int depth)
+{
+    if (depth > BODY_MAX_DEPTH)
+        return -1;
+
+    switch (json_typeof(json)) {
+    case JSON_NULL:
+        return body_pack_tag(buf, BODY_TAG_NULL, 0);
+    case JSON_TRUE:
+        return body_pack_tag(buf, BODY_TAG_TRUE, 0);
+    case JSON_FALSE:
+        return body_pack_tag(buf, BODY_TAG_FALSE, 0);
+    case JSON_INTEGER: {
+        int64_t num = json_integer_value(json);
+        return body_pack_tag(buf, BODY_TAG_INTEGER, ((uint64_t)num << 1) ^ (uint64_t)(num >> 63));
+    }
+    case JSON_REAL: {
+        double real = json_real_value(json);
+        uint64_t num;
+        memcpy(&num, &real, sizeof(num));
+        if (body_reserve(buf, 1 + sizeof(num)) < 0)
+            return -1;
+        pack_char(&buf->p, &buf->left, BODY_TAG_REAL);
+        return pack_uint64_le(&buf->p, &buf->left, num);
+    }
+    case JSON_STRING:
+        return body_pack_str(buf, BODY_TAG_STRING, json_string_value(json), json_string_length(json));
+    case JSON_ARRAY: {
+        size_t size = json_array_size(json);
+        if (body_pack_tag(buf, BODY_TAG_ARRAY, size) < 0)
+            return -1;
+        for (size_t i = 0; i < size; ++i) {
+            if (body_pack(buf, json_array_get(json, i), depth + 1) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    case JSON_OBJECT: {
+        if (body_pack_tag(buf, BODY_TAG_OBJECT, json_object_size(json)) < 0)
+            return -1;
+        const char *key;
+        json_t *value;
+        json_object_foreach((json_t *)json, key, value) {
+            if (body_reserve(buf, 9) < 0)
+                return -1;
+            size_t len = strlen(key) + 1;
+            pack_varint_le(&buf->p, &buf->left, len);
+            if (body_reserve(buf, len) < 0)
+                return -1;
+            pack_buf(&buf->p, &buf->left, key, len);
+            if (body_pack(buf, value, depth + 1) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+
+    return -1;
+}
+
+static json_t *body_unpack(void **p, size_t *left, int depth)
+{
+    if (depth > BODY_MAX_DEPTH)
+        return NULL;
+
+    uint8_t tag;
+    if (unpack_char(p, left, &tag) < 0)
+        return NULL;
+    if (tag == BODY_TAG_REAL) {
+        uint64_t num;
+        if (unpack_uint64_le(p, left, &num) < 0)
+            return NULL;
+        double real;
+        memcpy(&real, &num, sizeof(real));
+        return json_real(real);
+    }
+
+    uint64_t num;
+    if (unpack_varint_le(p, left, &num) < 0)
+        return NULL;
+
+    switch (tag) {
+    case BODY_TAG_NULL:
+        return json_null();
+    case BODY_TAG_TRUE:
+        return json_true();
+    case BODY_TAG_FALSE:
+        return json_false();
+    case BODY_TAG_INTEGER:
+        return json_integer((int64_t)(num >> 1) ^ -(int64_t)(num & 1));
+    case BODY_TAG_STRING: {
+        if (*left < num)
+            return NULL;
+        json_t *str = json_stringn(*p, num);
+        *p    += num;
+        *left -= num;
+        return str;
+    }
+    case BODY_TAG_ARRAY: {
+        // 每个元素至少2字节，先检查长度避免恶意的超大数组
+        if (*left / 2 < num)
+            return NULL;
+        json_t *array = json_array();
+        for (uint64_t i = 0; i < num; ++i) {
+            json_t *item = body_unpack(p, left, depth + 1);
+            if (item == NULL || json_array_append_new(array, item) < 0) {
+                json_decref(array);
+                return NULL;
+            }
+        }
+        return array;
+    }
+    case BODY_TAG_OBJECT: {
+        if (*left / 3 < num)
+            return NULL;
+        json_t *object = json_object();
+        for (uint64_t i = 0; i < num; ++i) {
+            uint64_t len;
+            if (unpack_varint_le(p, left, &len) < 0 || len == 0 || *left < len ||
+                    ((char *)*p)[len - 1] != '\0') {
+                json_decref(object);
+                return NULL;
+            }
+            const char *key = *p;
+            *p    += len;
+            *left -= len;
+            json_t *value = body_unpack(p, left, depth + 1);
+            if (value == NULL || json_object_set_new(object, key, value) < 0) {
+                json_decref(object);
+                return NULL;
+            }
+        }
+        return object;
+    }
+    }
+
+    return NULL;
+}
+
+int rpc_body_type(rpc_pkg *pkg)
+{
+    if (pkg->ext_size >= 1 && *(uint8_t *)pkg->ext == RPC_BODY_BINARY)
+        return RPC_BODY_BINARY;
+    return RPC_BODY_JSON;
+}
+
+void rpc_body_set_type(rpc_pkg *pkg, int type)
+{
+    // json不带ext，与不支持二进制编码的对端保持兼容
+    if (type == RPC_BODY_BINARY) {
+        pkg->ext = (void *)&body_types[RPC_BODY_BINARY];
+        pkg->ext_size = 1;
+    } else {
+        pkg->ext = NULL;
+        pkg->ext_size = 0;
+    }
+}
+
+json_t *rpc_body_load(rpc_pkg *pkg)
+{
+    if (rpc_body_type(pkg) == RPC_BODY_JSON)
+        return json_loadb(pkg->body, pkg->body_size, 0, NULL);
+
+    void *p = pkg->body;
+    size_t left = pkg->body_size;
+    json_t *json = body_unpack(&p, &left, 0);
+    if (json && left != 0) {
+        json_decref(json);
+        return NULL;
+    }
+    return json;
+}
+
+int rpc_body_dump(rpc_pkg *pkg, const json_t *json, int type)
+{
+    if (type == RPC_BODY_JSON) {
+        char *data = json_dumps(json, 0);
+        if (data == NULL)
+            return -1;
+        pkg->body = data;
+        pkg->body_size = strlen(data);
+    } else {
+        struct body_buf buf;
+        memset(&buf, 0, sizeof(buf));
+        if (body_pack(&buf, json, 0) < 0) {
+            free(buf.data);
+            return -1;
+        }
+        pkg->body = buf.data;
+        pkg->body_size = buf.size - buf.left;
+    }
+    rpc_body_set_type(pkg, type);
+
+    return 0;
+}
+
+sds rpc_body_str(rpc_pkg *pkg)
+{
+    if (rpc_body_type(pkg) == RPC_BODY_JSON)
+        return sdsnewlen(pkg->body, pkg->body_size);
+    return sdscatprintf(sdsempty(), "<binary %u bytes>", pkg->body_size);
+}
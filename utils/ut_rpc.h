@@ -11,6 +11,8 @@
 #define _UT_RPC_H_
 
 #include "nw_ses.h"
+#include "ut_sds.h"
+#include <jansson.h>
 #include <stdint.h>
 
 #define RPC_PKG_MAGIC 0x70656562
@@ -42,6 +44,20 @@ int rpc_decode(nw_ses *ses, void *data, size_t max);
 int rpc_pack(rpc_pkg *pkg, void **data, uint32_t *size);
 int rpc_send(nw_ses *ses, rpc_pkg *pkg);
 
+// 包体编码，由ext的第一个字节标识，ext为空时为json
+// 二进制编码在心跳中协商，客户端收到服务端确认后才使用
+#define RPC_BODY_JSON 0
+#define RPC_BODY_BINARY 1
+
+int rpc_body_type(rpc_pkg *pkg);
+void rpc_body_set_type(rpc_pkg *pkg, int type);
+// 按包体类型解析，失败返回NULL
+json_t *rpc_body_load(rpc_pkg *pkg);
+// 按指定类型编码并设置body和ext，body需调用方free
+int rpc_body_dump(rpc_pkg *pkg, const json_t *json, int type);
+// 用于日志的包体文本，二进制包体只记录长度
+sds rpc_body_str(rpc_pkg *pkg);
+
 #define RPC_CMD_HEARTBEAT 0
 
 #define RPC_HEARTBEAT_INTERVAL 1.0
@@ -50,5 +66,6 @@ int rpc_send(nw_ses *ses, rpc_pkg *pkg);
 #define RPC_HEARTBEAT_TIMEOUT_MAX 600
 
 #define RPC_HEARTBEAT_TYPE_TIMEOUT 1
+#define RPC_HEARTBEAT_TYPE_BODY 2
 
 #endif
@@ -17,6 +17,29 @@
 
 /* 1.rpc client 事件*/
 
+static int send_heartbeat(rpc_clt *clt);
+
+static void on_heartbeat_reply(rpc_clt *clt, rpc_pkg *pkg) {
+  void *p = pkg->body;
+  size_t left = pkg->body_size;
+  while (left > 0) {
+    uint16_t type;
+    uint16_t len;
+    if (unpack_uint16_le(&p, &left, &type) < 0 ||
+        unpack_uint16_le(&p, &left, &len) < 0 || left < len)
+      return;
+    if (type == RPC_HEARTBEAT_TYPE_BODY && len == sizeof(uint8_t) &&
+        *(uint8_t *)p == RPC_BODY_BINARY && clt->binary_body &&
+        clt->body_type != RPC_BODY_BINARY) {
+      log_info("peer: %s use binary body",
+               nw_sock_human_addr(&clt->raw_clt->ses.peer_addr));
+      clt->body_type = RPC_BODY_BINARY;
+    }
+    p += len;
+    left -= len;
+  }
+}
+
 static void on_recv_pkg(nw_ses *ses, void *data, size_t size) {
   struct rpc_pkg pkg;
 
@@ -28,8 +51,9 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size) {
   rpc_clt *clt = ses->privdata;
 
   if (pkg.command == RPC_CMD_HEARTBEAT) {
-    //如果是心跳，就直接退出，不处理
+    //如果是心跳，只检查服务端确认的包体类型
     clt->last_heartbeat = current_timestamp();
+    on_heartbeat_reply(clt, &pkg);
     return;
   }
   // 否则就处理rpc_clt实例绑定的事件
@@ -44,8 +68,13 @@ static void on_error_msg(nw_ses *ses, const char *msg) {
 // rpc client连接事件
 static void on_connect(nw_ses *ses, bool result) {
   rpc_clt *clt = ses->privdata;
+  // 新连接的对端可能不支持二进制包体，重新协商
+  clt->body_type = RPC_BODY_JSON;
   if (result) {
     clt->last_heartbeat = current_timestamp();
+    if (clt->binary_body && ses->sock_type != SOCK_DGRAM) {
+      send_heartbeat(clt);
+    }
   }
 
   //如果客户端额外定义了连接事件，继续执行
@@ -80,6 +109,11 @@ static int send_heartbeat(rpc_clt *clt) {
   pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_TIMEOUT);
   pack_uint16_le(&p, &left, sizeof(timeout));
   pack_uint32_le(&p, &left, timeout);
+  if (clt->binary_body) {
+    pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_BODY);
+    pack_uint16_le(&p, &left, sizeof(uint8_t));
+    pack_char(&p, &left, RPC_BODY_BINARY);
+  }
 
   rpc_pkg pkg;
   memset(&pkg, 0, sizeof(pkg));
@@ -167,6 +201,8 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type) {
   } else {
     clt->heartbeat_timeout = RPC_HEARTBEAT_TIMEOUT_DEFAULT;
   }
+  clt->binary_body = cfg->binary_body;
+  clt->body_type = RPC_BODY_JSON;
   clt->on_recv_pkg = type->on_recv_pkg;
   clt->on_connect = type->on_connect;
   nw_timer_set(&clt->timer, RPC_HEARTBEAT_INTERVAL, true, on_timer, clt);
@@ -215,3 +251,34 @@ void rpc_clt_release(rpc_clt *clt) {
 /* 5.rpc client 连接状态*/
 
 bool rpc_clt_connected(rpc_clt *clt) { return nw_clt_connected(clt->raw_clt); }
+
+/* 6.rpc client 批量请求*/
+
+int rpc_clt_send_json(rpc_clt *clt, rpc_pkg *pkg, const json_t *params) {
+  int ret = rpc_body_dump(pkg, params, clt->body_type);
+  if (ret < 0)
+    return ret;
+  ret = rpc_clt_send(clt, pkg);
+  free(pkg->body);
+  pkg->body = NULL;
+  pkg->body_size = 0;
+  return ret;
+}
+
+json_t *rpc_batch_create(const char *market) {
+  json_t *batch = json_array();
+  json_array_append_new(batch, json_string(market));
+  json_array_append_new(batch, json_array());
+  return batch;
+}
+
+int rpc_batch_add(json_t *batch, uint32_t command, json_t *params) {
+  json_t *request = json_array();
+  json_array_append_new(request, json_integer(command));
+  json_array_append_new(request, params);
+  return json_array_append_new(json_array_get(batch, 1), request);
+}
+
+size_t rpc_batch_size(json_t *batch) {
+  return json_array_size(json_array_get(batch, 1));
+}
@@ -25,6 +25,7 @@ typedef struct rpc_clt_cfg {
   uint32_t write_mem;
   double reconnect_timeout;
   double heartbeat_timeout;
+  bool binary_body; // 请求使用二进制包体，需服务端在心跳中确认
 } rpc_clt_cfg;
 
 typedef struct rpc_clt_type {
@@ -42,6 +43,8 @@ typedef struct rpc_clt {
   nw_timer timer;
   double last_heartbeat;
   double heartbeat_timeout;
+  bool binary_body;
+  int body_type; // 当前连接协商的包体类型，RPC_BODY_JSON或RPC_BODY_BINARY
   void (*on_recv_pkg)(nw_ses *ses, rpc_pkg *pkg);
   void (*on_connect)(nw_ses *ses, bool result);
 } rpc_clt;
@@ -52,6 +55,14 @@ int rpc_clt_close(rpc_clt *clt);
 int rpc_clt_send(rpc_clt *clt, rpc_pkg *pkg);
 void rpc_clt_release(rpc_clt *clt);
 bool rpc_clt_connected(rpc_clt *clt);
+// 按连接协商的包体类型编码params并发送，pkg中其他字段由调用方设置
+int rpc_clt_send_json(rpc_clt *clt, rpc_pkg *pkg, const json_t *params);
+
+// 批量请求：[market, [[command, params], ...]]，用CMD_ORDER_BATCH发送，
+// 服务端按顺序执行，在一个回复中按顺序返回各子请求的结果
+json_t *rpc_batch_create(const char *market);
+int rpc_batch_add(json_t *batch, uint32_t command, json_t *params); // 接管params的引用
+size_t rpc_batch_size(json_t *batch);
 
 #define rpc_clt_peer_addr(clt) (&(clt)->raw_clt->ses.peer_addr)
 
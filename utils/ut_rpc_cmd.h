@@ -26,6 +26,10 @@
 # define CMD_ORDER_HISTORY 208
 # define CMD_ORDER_DEALS 209
 # define CMD_ORDER_DETAIL_FINISHED 210
+# define CMD_ORDER_BOOK_SNAPSHOT 211
+# define CMD_ORDER_BATCH 212
+# define CMD_ORDER_CANCEL_ALL 213
+# define CMD_ORDER_CANCEL_MARKET 214
 
 // market
 # define CMD_MARKET_STATUS 301
@@ -36,5 +40,11 @@
 # define CMD_MARKET_USER_DEALS 306
 # define CMD_MARKET_LIST 307
 # define CMD_MARKET_SUMMARY 308
+// 订阅marketprice的推送，推送包的command为被订阅的命令
+# define CMD_MARKET_SUBSCRIBE 309
+# define CMD_MARKET_UNSUBSCRIBE 310
+
+// worker
+# define CMD_WORKER_LOAD 401
 
 # endif
@@ -25,6 +25,7 @@ static void on_error_msg(nw_ses *ses, const char *msg) {
 static int on_heartbeat(nw_ses *ses, rpc_pkg *pkg) {
   struct clt_info *info = ses->privdata;
   info->last_heartbeat = current_timestamp();
+  bool binary_body = false;
 
   void *p = pkg->body;
   size_t left = pkg->body_size;
@@ -55,13 +56,33 @@ static int on_heartbeat(nw_ses *ses, rpc_pkg *pkg) {
         info->heartbeat_timeout = timeout;
       }
     } break;
+    case RPC_HEARTBEAT_TYPE_BODY: {
+      if (len != sizeof(uint8_t)) {
+        return -__LINE__;
+      }
+      rpc_svr *svr = rpc_svr_from_ses(ses);
+      if (svr->binary_body && *(uint8_t *)p == RPC_BODY_BINARY) {
+        binary_body = true;
+      }
+    } break;
     }
     p += len;
     left -= len;
   }
 
+  // 确认客户端请求的包体类型，不支持时不回复该项，客户端继续使用json
+  char buf[16];
+  void *reply = buf;
+  size_t reply_left = sizeof(buf);
+  if (binary_body) {
+    pack_uint16_le(&reply, &reply_left, RPC_HEARTBEAT_TYPE_BODY);
+    pack_uint16_le(&reply, &reply_left, sizeof(uint8_t));
+    pack_char(&reply, &reply_left, RPC_BODY_BINARY);
+  }
+
   pkg->pkg_type = RPC_PKG_TYPE_REPLY;
-  pkg->body_size = 0;
+  pkg->body = buf;
+  pkg->body_size = sizeof(buf) - reply_left;
   rpc_send(ses, pkg);
 
   return 0;
@@ -203,6 +224,7 @@ rpc_svr *rpc_svr_create(rpc_svr_cfg *cfg, rpc_svr_type *type) {
   // 绑定事件，这是上层rpc层的事物，由外部参数定义
   svr->on_recv_pkg = type->on_recv_pkg;
   svr->on_new_connection = type->on_new_connection;
+  svr->binary_body = type->binary_body;
 
   return svr;
 }
@@ -33,6 +33,7 @@ typedef struct rpc_svr_type {
   void (*on_recv_fd)(nw_ses *ses, int fd);
   void (*on_new_connection)(nw_ses *ses);   //新连接的回调
   void (*on_connection_close)(nw_ses *ses); //连接关闭的回调
+  bool binary_body; // 支持二进制包体，在心跳中向客户端确认
 } rpc_svr_type;
 
 // rpc服务的定义
@@ -42,6 +43,7 @@ typedef struct rpc_svr {
   nw_timer timer;  //计时器
   nw_cache *privdata_cache;
   bool heartbeat_check;
+  bool binary_body;
   void (*on_recv_pkg)(nw_ses *ses, rpc_pkg *pkg);
   void (*on_new_connection)(nw_ses *ses);
 } rpc_svr;
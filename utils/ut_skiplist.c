@@ -13,12 +13,14 @@
 
 static skiplist_node *skiplist_create_node(skiplist_t *list, int level, void *value)
 {
-    size_t size = sizeof(skiplist_node) + level * sizeof(skiplist_node *);
+    size_t size = sizeof(skiplist_node) + level * (sizeof(skiplist_node *) + sizeof(unsigned long));
     skiplist_node *node = malloc(size);
     if (node == NULL) {
         return NULL;
     }
     memset(node, 0, size);
+    node->weight = 1;
+    node->span = (unsigned long *)&node->forward[level];
     if (value && list->type.dup) {
         node->value = list->type.dup(value);
     } else {
@@ -59,10 +61,13 @@ static int skiplist_random_level(void)
 skiplist_t *skiplist_insert(skiplist_t *list, void *value)
 {
     skiplist_node *update[SKIPLIST_MAX_LEVEL];
+    unsigned long rank[SKIPLIST_MAX_LEVEL];
     skiplist_node *node = list->header;
 
     for (int i = list->level - 1; i >= 0; i--) {
+        rank[i] = i == list->level - 1 ? 0 : rank[i + 1];
         while (node->forward[i] && list->type.compare(node->forward[i]->value, value) <= 0) {
+            rank[i] += node->span[i];
             node = node->forward[i];
         }
         update[i] = node;
@@ -74,7 +79,9 @@ skiplist_t *skiplist_insert(skiplist_t *list, void *value)
     int level = skiplist_random_level();
     if (level > list->level) {
         for (int i = list->level; i < level; ++i) {
+            rank[i] = 0;
             update[i] = list->header;
+            update[i]->span[i] = list->weight;
         }
         list->level = level;
     }
@@ -86,8 +93,14 @@ skiplist_t *skiplist_insert(skiplist_t *list, void *value)
     for (int i = 0; i < level; ++i) {
         node->forward[i] = update[i]->forward[i];
         update[i]->forward[i] = node;
+        node->span[i] = update[i]->span[i] - (rank[0] - rank[i]);
+        update[i]->span[i] = (rank[0] - rank[i]) + node->weight;
+    }
+    for (int i = level; i < list->level; ++i) {
+        update[i]->span[i] += node->weight;
     }
     list->len += 1;
+    list->weight += node->weight;
     return list;
 }
 
@@ -119,12 +132,16 @@ void skiplist_delete(skiplist_t *list, skiplist_node *x)
 
     for (int i = 0; i < list->level; ++i) {
         if (update[i]->forward[i] == x) {
+            update[i]->span[i] += x->span[i] - x->weight;
             update[i]->forward[i] = x->forward[i];
+        } else {
+            update[i]->span[i] -= x->weight;
         }
     }
     while (list->level > 1 && list->header->forward[list->level - 1] == NULL) {
         list->level -= 1;
     }
+    list->weight -= x->weight;
 
     if (list->type.free) {
         list->type.free(x->value);
@@ -133,6 +150,48 @@ void skiplist_delete(skiplist_t *list, skiplist_node *x)
     list->len -= 1;
 }
 
+int skiplist_set_weight(skiplist_t *list, void *value, unsigned long weight)
+{
+    skiplist_node *update[SKIPLIST_MAX_LEVEL];
+    skiplist_node *node = list->header;
+
+    for (int i = list->level - 1; i >= 0; i--) {
+        while (node->forward[i] && list->type.compare(node->forward[i]->value, value) < 0) {
+            node = node->forward[i];
+        }
+        update[i] = node;
+    }
+    node = node->forward[0];
+    if (node == NULL || list->type.compare(node->value, value) != 0) {
+        return -1;
+    }
+
+    /* every link on the path either ends at the node or passes over it */
+    for (int i = 0; i < list->level; ++i) {
+        update[i]->span[i] = update[i]->span[i] - node->weight + weight;
+    }
+    list->weight = list->weight - node->weight + weight;
+    node->weight = weight;
+    return 0;
+}
+
+skiplist_node *skiplist_seek(skiplist_t *list, unsigned long rank, unsigned long *before)
+{
+    skiplist_node *node = list->header;
+    unsigned long traversed = 0;
+
+    for (int i = list->level - 1; i >= 0; i--) {
+        while (node->forward[i] && traversed + node->span[i] <= rank) {
+            traversed += node->span[i];
+            node = node->forward[i];
+        }
+    }
+    if (before) {
+        *before = traversed;
+    }
+    return node->forward[0];
+}
+
 void skiplist_release(skiplist_t *list)
 {
     unsigned long len = list->len;
@@ -6,8 +6,13 @@
 # ifndef _UT_SKIPLIST_H_
 # define _UT_SKIPLIST_H_
 
+/* every node has a weight, 1 unless set by skiplist_set_weight,
+ * span[i] is the total weight of the nodes after this one up to and
+ * including forward[i], or up to the end of the list if it is NULL */
 typedef struct skiplist_node {
     void *value;
+    unsigned long weight;
+    unsigned long *span;
     struct skiplist_node *forward[];
 } skiplist_node;
 
@@ -26,15 +31,22 @@ typedef struct skiplist_t {
     skiplist_type type;
     skiplist_node *header;
     unsigned long len;
+    unsigned long weight;
 } skiplist_t;
 
 # define skiplist_len(l)        ((l)->len)
+# define skiplist_weight(l)     ((l)->weight)
 # define skiplist_node_value(n) ((n)->value)
 
 skiplist_t *skiplist_create(skiplist_type *type);
 skiplist_t *skiplist_insert(skiplist_t *list, void *value);
 skiplist_node *skiplist_find(skiplist_t *list, void *value);
 void skiplist_delete(skiplist_t *list, skiplist_node *node);
+/* change the weight of the node holding value, return -1 if not found */
+int skiplist_set_weight(skiplist_t *list, void *value, unsigned long weight);
+/* return the node covering the 0-based weighted position rank, and set
+ * *before to the total weight of the nodes before it, O(log n) */
+skiplist_node *skiplist_seek(skiplist_t *list, unsigned long rank, unsigned long *before);
 void skiplist_release(skiplist_t *list);
 
 skiplist_iter *skiplist_get_iterator(skiplist_t *list);
@@ -0,0 +1,224 @@
+/*
+ * Description: 按连接数和事件循环延迟挑选worker，worker端定时上报负载
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+#include "nw_log.h"
+#include "ut_misc.h"
+#include "ut_rpc_cmd.h"
+#include "ut_worker.h"
+
+/* 1. listener: 按负载排列的worker */
+
+static uint64_t get_score(worker_load *w) {
+  return (uint64_t)w->connections + w->pending +
+         (uint64_t)(w->lag * 1000) * WORKER_LAG_WEIGHT;
+}
+
+static void heap_swap(worker_pool *pool, uint32_t a, uint32_t b) {
+  worker_load *tmp = pool->heap[a];
+  pool->heap[a] = pool->heap[b];
+  pool->heap[b] = tmp;
+  pool->heap[a]->index = a;
+  pool->heap[b]->index = b;
+}
+
+static void heap_up(worker_pool *pool, uint32_t i) {
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (pool->heap[parent]->score <= pool->heap[i]->score)
+      break;
+    heap_swap(pool, parent, i);
+    i = parent;
+  }
+}
+
+static void heap_down(worker_pool *pool, uint32_t i) {
+  for (;;) {
+    uint32_t min = i;
+    uint32_t left = 2 * i + 1;
+    uint32_t right = left + 1;
+    if (left < pool->count && pool->heap[left]->score < pool->heap[min]->score)
+      min = left;
+    if (right < pool->count &&
+        pool->heap[right]->score < pool->heap[min]->score)
+      min = right;
+    if (min == i)
+      break;
+    heap_swap(pool, min, i);
+    i = min;
+  }
+}
+
+// score变化后恢复堆序
+static void update_score(worker_pool *pool, worker_load *w) {
+  uint64_t score = get_score(w);
+  if (score < w->score) {
+    w->score = score;
+    heap_up(pool, w->index);
+  } else {
+    w->score = score;
+    heap_down(pool, w->index);
+  }
+}
+
+static worker_load *get_worker(worker_pool *pool, nw_ses *ses) {
+  for (uint32_t i = 0; i < pool->count; ++i) {
+    if (pool->heap[i]->ses == ses)
+      return pool->heap[i];
+  }
+  return NULL;
+}
+
+worker_pool *worker_pool_create(void) {
+  worker_pool *pool = malloc(sizeof(worker_pool));
+  if (pool == NULL)
+    return NULL;
+  memset(pool, 0, sizeof(worker_pool));
+  return pool;
+}
+
+void worker_pool_release(worker_pool *pool) {
+  for (uint32_t i = 0; i < pool->count; ++i) {
+    free(pool->heap[i]);
+  }
+  free(pool->heap);
+  free(pool);
+}
+
+worker_load *worker_pool_add(worker_pool *pool, nw_ses *ses) {
+  if (pool->count == pool->size) {
+    uint32_t size = pool->size ? pool->size * 2 : 16;
+    worker_load **heap = realloc(pool->heap, sizeof(worker_load *) * size);
+    if (heap == NULL)
+      return NULL;
+    pool->heap = heap;
+    pool->size = size;
+  }
+
+  worker_load *w = malloc(sizeof(worker_load));
+  if (w == NULL)
+    return NULL;
+  memset(w, 0, sizeof(worker_load));
+  w->ses = ses;
+  w->update_time = current_timestamp();
+  w->index = pool->count;
+  pool->heap[pool->count++] = w;
+  heap_up(pool, w->index);
+
+  return w;
+}
+
+void worker_pool_del(worker_pool *pool, nw_ses *ses) {
+  worker_load *w = get_worker(pool, ses);
+  if (w == NULL)
+    return;
+
+  uint32_t i = w->index;
+  pool->count -= 1;
+  if (i != pool->count) {
+    heap_swap(pool, i, pool->count);
+    heap_up(pool, i);
+    heap_down(pool, i);
+  }
+  free(w);
+}
+
+int worker_pool_report(worker_pool *pool, nw_ses *ses, rpc_pkg *pkg) {
+  worker_load *w = get_worker(pool, ses);
+  if (w == NULL)
+    return -__LINE__;
+  json_t *params = rpc_body_load(pkg);
+  if (params == NULL)
+    return -__LINE__;
+  json_t *connections = json_object_get(params, "connections");
+  json_t *lag = json_object_get(params, "lag");
+  if (!json_is_integer(connections) || !json_is_number(lag)) {
+    json_decref(params);
+    return -__LINE__;
+  }
+
+  w->connections = json_integer_value(connections);
+  w->lag = json_number_value(lag);
+  w->pending = 0;
+  w->update_time = current_timestamp();
+  update_score(pool, w);
+  json_decref(params);
+
+  return 0;
+}
+
+nw_ses *worker_pool_pick(worker_pool *pool) {
+  if (pool->count == 0)
+    return NULL;
+  worker_load *w = pool->heap[0];
+  w->pending += 1;
+  update_score(pool, w);
+  return w->ses;
+}
+
+sds worker_pool_status(worker_pool *pool, sds reply) {
+  double now = current_timestamp();
+  reply = sdscatprintf(reply, "worker count: %u\n", pool->count);
+  for (uint32_t i = 0; i < pool->count; ++i) {
+    worker_load *w = pool->heap[i];
+    reply = sdscatprintf(reply,
+                         "worker: %s, connections: %u, pending: %u, "
+                         "lag: %.3fms, score: %" PRIu64 ", update: %.1fs ago\n",
+                         nw_sock_human_addr(&w->ses->peer_addr), w->connections,
+                         w->pending, w->lag * 1000, w->score,
+                         now - w->update_time);
+  }
+  return reply;
+}
+
+/* 2. worker: 统计事件循环延迟并上报 */
+
+static rpc_clt *report_clt;
+static nw_svr *report_svr;
+static nw_timer lag_timer;
+static nw_timer report_timer;
+static double lag_last;
+static double lag_max;
+
+static void on_lag_timer(nw_timer *timer, void *privdata) {
+  double now = current_timestamp();
+  double lag = now - lag_last - WORKER_LAG_INTERVAL;
+  if (lag > lag_max)
+    lag_max = lag;
+  lag_last = now;
+}
+
+static void on_report_timer(nw_timer *timer, void *privdata) {
+  if (!rpc_clt_connected(report_clt))
+    return;
+
+  json_t *params = json_object();
+  json_object_set_new(params, "connections",
+                      json_integer(report_svr->ses_count));
+  json_object_set_new(params, "lag", json_real(lag_max));
+
+  rpc_pkg pkg;
+  memset(&pkg, 0, sizeof(pkg));
+  pkg.pkg_type = RPC_PKG_TYPE_PUSH;
+  pkg.command = CMD_WORKER_LOAD;
+  if (rpc_clt_send_json(report_clt, &pkg, params) < 0) {
+    log_error("send worker load fail");
+  }
+  json_decref(params);
+  lag_max = 0;
+}
+
+int worker_report_start(rpc_clt *clt, nw_svr *svr) {
+  report_clt = clt;
+  report_svr = svr;
+
+  lag_last = current_timestamp();
+  nw_timer_set(&lag_timer, WORKER_LAG_INTERVAL, true, on_lag_timer, NULL);
+  nw_timer_start(&lag_timer);
+  nw_timer_set(&report_timer, WORKER_REPORT_INTERVAL, true, on_report_timer,
+                NULL);
+  nw_timer_start(&report_timer);
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Description: listener与worker之间的负载上报，worker定期上报连接数和
+ *              事件循环延迟，listener把新连接交给负载最小的worker
+ *     History: yang@haipo.me, 2026/10/17, create
+ */
+
+#ifndef _UT_WORKER_H_
+#define _UT_WORKER_H_
+
+#include "nw_svr.h"
+#include "ut_rpc_clt.h"
+#include "ut_sds.h"
+
+#define WORKER_REPORT_INTERVAL 1.0
+#define WORKER_LAG_INTERVAL 0.1
+// 每毫秒事件循环延迟折算成的连接数
+#define WORKER_LAG_WEIGHT 10
+
+// listener中的worker负载
+typedef struct worker_load {
+  nw_ses *ses;
+  uint32_t connections; // worker上报的连接数
+  uint32_t pending;     // 上报之后新分配的连接数
+  double lag;           // 上报周期内事件循环的最大延迟，秒
+  double update_time;
+  uint64_t score;
+  uint32_t index; // 在堆中的位置
+} worker_load;
+
+// 按score排列的最小堆，堆顶即负载最小的worker
+typedef struct worker_pool {
+  worker_load **heap;
+  uint32_t count;
+  uint32_t size;
+} worker_pool;
+
+worker_pool *worker_pool_create(void);
+void worker_pool_release(worker_pool *pool);
+worker_load *worker_pool_add(worker_pool *pool, nw_ses *ses);
+void worker_pool_del(worker_pool *pool, nw_ses *ses);
+// 处理worker的CMD_WORKER_LOAD上报
+int worker_pool_report(worker_pool *pool, nw_ses *ses, rpc_pkg *pkg);
+// 取负载最小的worker并计入一个待上报的连接，没有worker时返回NULL
+nw_ses *worker_pool_pick(worker_pool *pool);
+sds worker_pool_status(worker_pool *pool, sds reply);
+
+// worker端：开始统计事件循环延迟，并通过clt定期上报svr的连接数
+int worker_report_start(rpc_clt *clt, nw_svr *svr);
+
+#endif
@@ -5,14 +5,21 @@
 
 #include <openssl/sha.h>
 #include <stdbool.h>
+#include <zlib.h>
 
 #include "nw_log.h"
 #include "ut_base64.h"
 #include "ut_misc.h"
 #include "ut_ws_svr.h"
 
-struct ws_frame {
+#define WS_FRAME_RSV1 0x40
+#define WS_FRAME_RSV_MASK 0x70
+
+static const uint8_t deflate_tail[] = {0x00, 0x00, 0xff, 0xff};
+
+struct ws_frame_in {
   uint8_t fin;
+  uint8_t rsv;
   uint8_t opcode;
   uint64_t payload_len;
   void *payload;
@@ -32,7 +39,13 @@ struct clt_info {
   sds url;
   sds message;
   http_request_t *request;
-  struct ws_frame frame;
+  struct ws_frame_in frame;
+  bool deflate;
+  bool deflate_no_context_takeover;
+  int deflate_window_bits;
+  bool compressed;
+  z_stream *deflater;
+  z_stream *inflater;
 };
 
 static int on_http_message_begin(http_parser *parser) {
@@ -47,7 +60,8 @@ static int on_http_message_begin(http_parser *parser) {
   return 0;
 }
 
-static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key) {
+static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key,
+                                 char *extensions) {
   unsigned char hash[20];
   sds data = sdsnew(key);
   data = sdscat(data, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
@@ -64,6 +78,9 @@ static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key) {
   if (protocol) {
     http_response_set_header(response, "Sec-WebSocket-Protocol", protocol);
   }
+  if (extensions) {
+    http_response_set_header(response, "Sec-WebSocket-Extensions", extensions);
+  }
   response->status = 101;
 
   sds message = http_response_encode(response);
@@ -89,6 +106,85 @@ static bool is_good_protocol(const char *protocol_list, const char *protocol) {
   return false;
 }
 
+static bool negotiate_deflate_offer(ws_svr *svr, struct clt_info *info,
+                                    sds *params, int count) {
+  bool no_context_takeover = svr->deflate_no_context_takeover;
+  int window_bits = svr->deflate_window_bits;
+  for (int i = 1; i < count; i++) {
+    sds param = params[i];
+    sdstrim(param, " \t");
+    char *value = strchr(param, '=');
+    if (value) {
+      *value++ = '\0';
+      sdsupdatelen(param);
+      sdstrim(param, " \t");
+      value += strspn(value, " \t\"");
+      value[strcspn(value, " \t\"")] = '\0';
+    }
+    if (strcmp(param, "server_no_context_takeover") == 0) {
+      if (value)
+        return false;
+      no_context_takeover = true;
+    } else if (strcmp(param, "client_no_context_takeover") == 0) {
+      if (value)
+        return false;
+    } else if (strcmp(param, "server_max_window_bits") == 0) {
+      int bits = value ? atoi(value) : 0;
+      // zlib raw deflate can not use a window of 8 bits
+      if (bits < 9 || bits > 15)
+        return false;
+      if (bits < window_bits)
+        window_bits = bits;
+    } else if (strcmp(param, "client_max_window_bits") == 0) {
+      // the inflater always uses the largest window
+      if (value && (atoi(value) < 8 || atoi(value) > 15))
+        return false;
+    } else {
+      return false;
+    }
+  }
+
+  info->deflate = true;
+  info->deflate_no_context_takeover = no_context_takeover;
+  info->deflate_window_bits = window_bits;
+  return true;
+}
+
+static sds negotiate_deflate(ws_svr *svr, struct clt_info *info,
+                             const char *extensions) {
+  if (strlen(extensions) > UT_WS_SVR_MAX_HEADER_SIZE)
+    return NULL;
+
+  int offer_count;
+  sds *offers =
+      sdssplitlen(extensions, strlen(extensions), ",", 1, &offer_count);
+  if (offers == NULL)
+    return NULL;
+  for (int i = 0; i < offer_count && !info->deflate; i++) {
+    int count;
+    sds *params = sdssplitlen(offers[i], sdslen(offers[i]), ";", 1, &count);
+    if (params == NULL)
+      continue;
+    if (count > 0) {
+      sdstrim(params[0], " \t");
+      if (strcmp(params[0], "permessage-deflate") == 0)
+        negotiate_deflate_offer(svr, info, params, count);
+    }
+    sdsfreesplitres(params, count);
+  }
+  sdsfreesplitres(offers, offer_count);
+  if (!info->deflate)
+    return NULL;
+
+  sds reply = sdsnew("permessage-deflate");
+  if (info->deflate_no_context_takeover)
+    reply = sdscat(reply, "; server_no_context_takeover");
+  if (info->deflate_window_bits < 15)
+    reply = sdscatprintf(reply, "; server_max_window_bits=%d",
+                         info->deflate_window_bits);
+  return reply;
+}
+
 static bool is_good_origin(const char *origin, const char *require) {
   size_t origin_len = strlen(origin);
   size_t require_len = strlen(require);
@@ -174,11 +270,16 @@ static int on_http_message_complete(http_parser *parser) {
   if (svr->type.on_upgrade) {
     svr->type.on_upgrade(info->ses, info->remote);
   }
-  if (protocol_list) {
-    send_hand_shake_reply(info->ses, svr->protocol, ws_key);
-  } else {
-    send_hand_shake_reply(info->ses, NULL, ws_key);
+  sds extensions = NULL;
+  const char *extension_list =
+      http_request_get_header(info->request, "Sec-WebSocket-Extensions");
+  if (svr->deflate && extension_list) {
+    extensions = negotiate_deflate(svr, info, extension_list);
   }
+  send_hand_shake_reply(info->ses, protocol_list ? svr->protocol : NULL, ws_key,
+                        extensions);
+  if (extensions)
+    sdsfree(extensions);
 
   return 0;
 
@@ -257,9 +358,17 @@ static int decode_pkg(nw_ses *ses, void *data, size_t max) {
   size_t pkg_size = 0;
   memset(&info->frame, 0, sizeof(info->frame));
   info->frame.fin = p[0] & 0x80;
+  info->frame.rsv = p[0] & WS_FRAME_RSV_MASK;
   info->frame.opcode = p[0] & 0x0f;
   if (!is_good_opcode(info->frame.opcode))
     return -1;
+  if (info->frame.rsv) {
+    // only the first frame of a compressed data message may set RSV1
+    if (info->frame.rsv != WS_FRAME_RSV1 || !info->deflate)
+      return -1;
+    if (info->frame.opcode == 0x0 || info->frame.opcode >= 0x8)
+      return -1;
+  }
   uint8_t mask = p[1] & 0x80;
   if (mask == 0)
     return -1;
@@ -349,10 +458,41 @@ static void on_privdata_free(void *svr, void *privdata) {
   if (info->request) {
     http_request_release(info->request);
   }
+  if (info->deflater) {
+    deflateEnd(info->deflater);
+    free(info->deflater);
+  }
+  if (info->inflater) {
+    inflateEnd(info->inflater);
+    free(info->inflater);
+  }
   ws_svr *w_svr = ((nw_svr *)svr)->privdata;
   nw_cache_free(w_svr->privdata_cache, privdata);
 }
 
+static size_t pack_frame_header(uint8_t *p, uint8_t opcode,
+                                size_t payload_len) {
+  p[0] = 0;
+  p[0] |= 0x1 << 7;
+  p[0] |= opcode;
+  p[1] = 0;
+  if (payload_len < 126) {
+    uint8_t len = payload_len;
+    p[1] |= len;
+    return 2;
+  } else if (payload_len <= 0xffff) {
+    p[1] |= 126;
+    uint16_t len = htobe16((uint16_t)payload_len);
+    memcpy(p + 2, &len, sizeof(len));
+    return 2 + sizeof(len);
+  } else {
+    p[1] |= 127;
+    uint64_t len = htobe64(payload_len);
+    memcpy(p + 2, &len, sizeof(len));
+    return 2 + sizeof(len);
+  }
+}
+
 static int send_reply(nw_ses *ses, uint8_t opcode, void *payload,
                       size_t payload_len) {
   if (payload == NULL)
@@ -374,36 +514,146 @@ static int send_reply(nw_ses *ses, uint8_t opcode, void *payload,
     buf_size = require_len;
   }
 
-  size_t pkg_len = 0;
-  uint8_t *p = buf;
-  p[0] = 0;
-  p[0] |= 0x1 << 7;
-  p[0] |= opcode;
-  p[1] = 0;
-  if (payload_len < 126) {
-    uint8_t len = payload_len;
-    p[1] |= len;
-    pkg_len = 2;
-  } else if (payload_len <= 0xffff) {
-    p[1] |= 126;
-    uint16_t len = htobe16((uint16_t)payload_len);
-    memcpy(p + 2, &len, sizeof(len));
-    pkg_len = 2 + sizeof(len);
-  } else {
-    p[1] |= 127;
-    uint64_t len = htobe64(payload_len);
-    memcpy(p + 2, &len, sizeof(len));
-    pkg_len = 2 + sizeof(len);
-  }
-
+  size_t pkg_len = pack_frame_header(buf, opcode, payload_len);
   if (payload) {
-    memcpy(p + pkg_len, payload, payload_len);
+    memcpy((uint8_t *)buf + pkg_len, payload, payload_len);
     pkg_len += payload_len;
   }
 
   return nw_ses_send(ses, buf, pkg_len);
 }
 
+static z_stream *create_deflater(int level, int window_bits) {
+  z_stream *zs = malloc(sizeof(z_stream));
+  if (zs == NULL)
+    return NULL;
+  memset(zs, 0, sizeof(z_stream));
+  if (deflateInit2(zs, level, Z_DEFLATED, -window_bits, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    free(zs);
+    return NULL;
+  }
+  return zs;
+}
+
+// compress one message, the output is valid until the next call
+static int deflate_payload(z_stream *zs, bool reset, const void *payload,
+                           size_t payload_len, void **out, size_t *out_len) {
+  static void *buf;
+  static size_t buf_size;
+  size_t require_len = payload_len + payload_len / 100 + 64;
+  if (buf_size < require_len) {
+    void *new = realloc(buf, require_len);
+    if (new == NULL)
+      return -1;
+    buf = new;
+    buf_size = require_len;
+  }
+
+  int ret;
+  size_t len = 0;
+  zs->next_in = (Bytef *)payload;
+  zs->avail_in = payload_len;
+  for (;;) {
+    zs->next_out = (Bytef *)buf + len;
+    zs->avail_out = buf_size - len;
+    ret = deflate(zs, Z_SYNC_FLUSH);
+    len = buf_size - zs->avail_out;
+    if (ret != Z_OK && ret != Z_BUF_ERROR)
+      break;
+    if (zs->avail_out != 0)
+      break;
+    void *new = realloc(buf, buf_size * 2);
+    if (new == NULL) {
+      ret = Z_MEM_ERROR;
+      break;
+    }
+    buf = new;
+    buf_size *= 2;
+  }
+  if ((ret != Z_OK && ret != Z_BUF_ERROR) || zs->avail_in != 0 || len < sizeof(deflate_tail) ||
+      memcmp((uint8_t *)buf + len - sizeof(deflate_tail), deflate_tail,
+             sizeof(deflate_tail)) != 0) {
+    deflateReset(zs);
+    return -1;
+  }
+  if (reset)
+    deflateReset(zs);
+
+  *out = buf;
+  *out_len = len - sizeof(deflate_tail);
+  return 0;
+}
+
+static sds inflate_message(struct clt_info *info, sds message, size_t limit) {
+  if (info->inflater == NULL) {
+    z_stream *zs = malloc(sizeof(z_stream));
+    if (zs == NULL)
+      return NULL;
+    memset(zs, 0, sizeof(z_stream));
+    if (inflateInit2(zs, -15) != Z_OK) {
+      free(zs);
+      return NULL;
+    }
+    info->inflater = zs;
+  }
+
+  message = sdscatlen(message, deflate_tail, sizeof(deflate_tail));
+  info->message = message;
+  z_stream *zs = info->inflater;
+  zs->next_in = (Bytef *)message;
+  zs->avail_in = sdslen(message);
+  sds output = sdsempty();
+  for (;;) {
+    output = sdsMakeRoomFor(output, sdslen(message) * 2 + 1024);
+    size_t avail = sdsavail(output);
+    zs->next_out = (Bytef *)output + sdslen(output);
+    zs->avail_out = avail;
+    int ret = inflate(zs, Z_SYNC_FLUSH);
+    sdsIncrLen(output, avail - zs->avail_out);
+    if (ret == Z_STREAM_END) {
+      inflateReset(zs);
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      break;
+    }
+    if (limit && sdslen(output) > limit)
+      break;
+    if (zs->avail_in == 0 && zs->avail_out != 0)
+      return output;
+    if (ret == Z_BUF_ERROR && zs->avail_out != 0)
+      break;
+  }
+
+  sdsfree(output);
+  return NULL;
+}
+
+// data message, compressed when the session negotiated permessage-deflate
+static int send_message(nw_ses *ses, uint8_t opcode, void *payload,
+                        size_t payload_len) {
+  struct clt_info *info = ses->privdata;
+  ws_svr *svr = ws_svr_from_ses(ses);
+  if (!info->deflate || payload == NULL ||
+      payload_len < svr->deflate_min_size)
+    return send_reply(ses, opcode, payload, payload_len);
+
+  if (info->deflater == NULL) {
+    info->deflater =
+        create_deflater(svr->deflate_level, info->deflate_window_bits);
+    if (info->deflater == NULL)
+      return send_reply(ses, opcode, payload, payload_len);
+  }
+  void *data;
+  size_t data_len;
+  if (deflate_payload(info->deflater, info->deflate_no_context_takeover,
+                      payload, payload_len, &data, &data_len) < 0) {
+    log_error("peer: %s deflate fail", nw_sock_human_addr(&ses->peer_addr));
+    return send_reply(ses, opcode, payload, payload_len);
+  }
+
+  return send_reply(ses, opcode | WS_FRAME_RSV1, data, data_len);
+}
+
 static int send_pong_message(nw_ses *ses) {
   return send_reply(ses, 0xa, NULL, 0);
 }
@@ -436,11 +686,23 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size) {
     return;
   }
 
+  if (info->frame.opcode != 0x0)
+    info->compressed = info->frame.rsv & WS_FRAME_RSV1;
   if (info->message == NULL)
     info->message = sdsempty();
   info->message =
       sdscatlen(info->message, info->frame.payload, info->frame.payload_len);
   if (info->frame.fin) {
+    if (info->compressed) {
+      sds message = inflate_message(info, info->message, svr->max_pkg_size);
+      if (message == NULL) {
+        log_error("peer: %s inflate fail", nw_sock_human_addr(&ses->peer_addr));
+        nw_svr_close_ses(svr->raw_svr, ses);
+        return;
+      }
+      sdsfree(info->message);
+      info->message = message;
+    }
     int ret = svr->type.on_message(ses, info->remote, info->url, info->message,
                                    sdslen(info->message));
     if (ses->id != 0) {
@@ -518,6 +780,14 @@ ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type) {
   svr->keep_alive = cfg->keep_alive;
   svr->protocol = strdup(cfg->protocol);
   svr->origin = strdup(cfg->origin);
+  svr->max_pkg_size = cfg->max_pkg_size;
+  svr->deflate = cfg->deflate;
+  svr->deflate_level = cfg->deflate_level;
+  svr->deflate_window_bits = cfg->deflate_window_bits;
+  if (svr->deflate_window_bits < 9 || svr->deflate_window_bits > 15)
+    svr->deflate_window_bits = 15;
+  svr->deflate_no_context_takeover = cfg->deflate_no_context_takeover;
+  svr->deflate_min_size = cfg->deflate_min_size;
   svr->privdata_cache = nw_cache_create(sizeof(struct clt_info));
   memcpy(&svr->type, type, sizeof(ws_svr_type));
 
@@ -553,28 +823,135 @@ void *ws_ses_privdata(nw_ses *ses) {
 }
 
 int ws_send_text(nw_ses *ses, char *message) {
-  return send_reply(ses, 0x1, message, strlen(message));
+  return send_message(ses, 0x1, message, strlen(message));
 }
 
 int ws_send_binary(nw_ses *ses, void *data, size_t size) {
-  return send_reply(ses, 0x2, data, size);
+  return send_message(ses, 0x2, data, size);
+}
+
+ws_frame *ws_frame_create(uint8_t opcode, const void *payload,
+                          size_t payload_len) {
+  if (payload == NULL)
+    payload_len = 0;
+
+  ws_frame *frame = malloc(sizeof(ws_frame));
+  if (frame == NULL)
+    return NULL;
+  memset(frame, 0, sizeof(ws_frame));
+  uint8_t header[10];
+  frame->opcode = opcode;
+  frame->header_len = pack_frame_header(header, opcode, payload_len);
+  frame->plain = nw_buf_ref_create(NULL, frame->header_len + payload_len);
+  if (frame->plain == NULL) {
+    free(frame);
+    return NULL;
+  }
+  memcpy(frame->plain->data, header, frame->header_len);
+  if (payload_len)
+    memcpy(frame->plain->data + frame->header_len, payload, payload_len);
+
+  return frame;
+}
+
+ws_frame *ws_frame_text(const char *message) {
+  return ws_frame_create(0x1, message, strlen(message));
+}
+
+void ws_frame_release(ws_frame *frame) {
+  nw_buf_ref_release(frame->plain);
+  if (frame->deflate)
+    nw_buf_ref_release(frame->deflate);
+  free(frame);
+}
+
+static nw_buf_ref *frame_deflate(ws_svr *svr, ws_frame *frame) {
+  if (frame->deflate || frame->deflate_fail)
+    return frame->deflate;
+
+  frame->deflate_fail = true;
+  if (svr->deflater == NULL) {
+    svr->deflater =
+        create_deflater(svr->deflate_level, svr->deflate_window_bits);
+    if (svr->deflater == NULL)
+      return NULL;
+  }
+  void *data;
+  size_t data_len;
+  if (deflate_payload(svr->deflater, true,
+                      frame->plain->data + frame->header_len,
+                      frame->plain->size - frame->header_len, &data,
+                      &data_len) < 0)
+    return NULL;
+
+  uint8_t header[10];
+  size_t header_len =
+      pack_frame_header(header, frame->opcode | WS_FRAME_RSV1, data_len);
+  frame->deflate = nw_buf_ref_create(NULL, header_len + data_len);
+  if (frame->deflate == NULL)
+    return NULL;
+  memcpy(frame->deflate->data, header, header_len);
+  memcpy(frame->deflate->data + header_len, data, data_len);
+  frame->deflate_window_bits = svr->deflate_window_bits;
+  frame->deflate_fail = false;
+
+  return frame->deflate;
+}
+
+int ws_send_frame(nw_ses *ses, ws_frame *frame) {
+  struct clt_info *info = ses->privdata;
+  ws_svr *svr = ws_svr_from_ses(ses);
+  size_t payload_len = frame->plain->size - frame->header_len;
+  if (!info->deflate || payload_len == 0 ||
+      payload_len < svr->deflate_min_size)
+    return nw_ses_send_ref(ses, frame->plain);
+
+  // without context takeover every session can share one compressed copy
+  if (info->deflate_no_context_takeover &&
+      info->deflate_window_bits >= svr->deflate_window_bits) {
+    nw_buf_ref *ref = frame_deflate(svr, frame);
+    if (ref && info->deflate_window_bits >= frame->deflate_window_bits)
+      return nw_ses_send_ref(ses, ref);
+  }
+
+  return send_message(ses, frame->opcode,
+                      frame->plain->data + frame->header_len, payload_len);
+}
+
+int ws_send_frame_dict(dict_t *sessions, ws_frame *frame) {
+  int count = 0;
+  dict_iterator *iter = dict_get_iterator(sessions);
+  dict_entry *entry;
+  while ((entry = dict_next(iter)) != NULL) {
+    if (ws_send_frame(entry->key, frame) == 0)
+      count += 1;
+  }
+  dict_release_iterator(iter);
+
+  return count;
 }
 
 static int broadcast_message(ws_svr *svr, uint8_t opcode, void *data,
                              size_t size) {
+  ws_frame *frame = ws_frame_create(opcode, data, size);
+  if (frame == NULL)
+    return -1;
+
+  int ret = 0;
   nw_ses *curr = svr->raw_svr->ses_list_head;
   while (curr) {
     nw_ses *next = curr->next;
     struct clt_info *info = curr->privdata;
     if (info->upgrade) {
-      int ret = send_reply(curr, opcode, data, size);
+      ret = ws_send_frame(curr, frame);
       if (ret < 0)
-        return ret;
+        break;
     }
     curr = next;
   }
+  ws_frame_release(frame);
 
-  return 0;
+  return ret;
 }
 
 int ws_svr_broadcast_text(ws_svr *svr, char *message) {
@@ -593,6 +970,10 @@ void ws_svr_release(ws_svr *svr) {
   nw_svr_release(svr->raw_svr);
   nw_timer_stop(&svr->timer);
   nw_cache_release(svr->privdata_cache);
+  if (svr->deflater) {
+    deflateEnd(svr->deflater);
+    free(svr->deflater);
+  }
   free(svr->protocol);
   free(svr);
 }
@@ -10,6 +10,7 @@
 #include "nw_buf.h"
 #include "nw_svr.h"
 #include "nw_timer.h"
+#include "ut_dict.h"
 #include "ut_http.h"
 
 #define UT_WS_SVR_MAX_HEADER_SIZE 1024
@@ -25,6 +26,12 @@ typedef struct ws_svr_cfg {
   int keep_alive;
   char *protocol;
   char *origin;
+  /* RFC 7692 permessage-deflate */
+  bool deflate;
+  int deflate_level;
+  int deflate_window_bits;         /* 9-15, server_max_window_bits */
+  bool deflate_no_context_takeover; /* compress broadcast frames only once */
+  uint32_t deflate_min_size;        /* smaller messages are sent uncompressed */
 } ws_svr_cfg;
 
 typedef struct ws_svr_type {
@@ -44,6 +51,13 @@ typedef struct ws_svr {
   int keep_alive;
   char *protocol;
   char *origin;
+  uint32_t max_pkg_size;
+  bool deflate;
+  int deflate_level;
+  int deflate_window_bits;
+  bool deflate_no_context_takeover;
+  uint32_t deflate_min_size;
+  void *deflater; /* shared by frames, reset after every message */
   http_parser_settings settings;
   ws_svr_type type;
 } ws_svr;
@@ -57,6 +71,28 @@ int ws_send_text(nw_ses *ses, char *message);
 int ws_send_binary(nw_ses *ses, void *data, size_t size);
 int ws_svr_broadcast_text(ws_svr *svr, char *message);
 int ws_svr_broadcast_binary(ws_svr *svr, void *data, size_t size);
+
+/* a frame is a complete websocket message (header and payload) built once and
+ * shared by every session it is sent to. sessions negotiated permessage-deflate
+ * without context takeover share one compressed copy, the others are compressed
+ * per session */
+typedef struct ws_frame {
+  uint8_t opcode;
+  size_t header_len;
+  nw_buf_ref *plain;
+  nw_buf_ref *deflate;
+  int deflate_window_bits;
+  bool deflate_fail;
+} ws_frame;
+
+ws_frame *ws_frame_create(uint8_t opcode, const void *payload,
+                          size_t payload_len);
+ws_frame *ws_frame_text(const char *message);
+void ws_frame_release(ws_frame *frame);
+int ws_send_frame(nw_ses *ses, ws_frame *frame);
+/* send frame to every session key of the dict, return the number of sessions
+ * it was queued to */
+int ws_send_frame_dict(dict_t *sessions, ws_frame *frame);
 void ws_svr_release(ws_svr *svr);
 void ws_svr_close_clt(ws_svr *svr, nw_ses *ses);
 